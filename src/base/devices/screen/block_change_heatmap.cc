@@ -0,0 +1,101 @@
+#include "base/devices/screen/block_change_heatmap.h"
+
+#include <algorithm>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// Heat added to a block in a frame where it is updated.
+constexpr int k_updated_heat = 40;
+
+// Each frame takes 1 / (1 << k_decay_shift) of the heat away, rounding up, so
+// a block which stops changing cools down to zero.
+constexpr int k_decay_shift = 3;
+
+// Blocks below this heat are still, i.e. a single change cools down below it
+// after about a dozen frames.
+constexpr int k_ui_heat = 8;
+
+// Blocks at or above this heat change in about half of the frames or more.
+constexpr int k_video_heat = 128;
+
+} // namespace
+
+block_change_heatmap::block_change_heatmap() = default;
+
+block_change_heatmap::~block_change_heatmap() = default;
+
+void block_change_heatmap::reset(const desktop_size &size, int block_size) {
+  size_ = size;
+  block_size_ = block_size;
+  width_in_blocks_ = (std::max(size.width(), 0) + block_size_ - 1) / block_size_;
+  height_in_blocks_ = (std::max(size.height(), 0) + block_size_ - 1) / block_size_;
+  heat_.assign(width_in_blocks_ * height_in_blocks_, 0);
+  updated_.assign(heat_.size(), 0);
+}
+
+void block_change_heatmap::update(const desktop_region &updated_region) {
+  const desktop_rect frame_rect = desktop_rect::make_size(size_);
+  for (desktop_region::iterator it(updated_region); !it.is_at_end(); it.advance()) {
+    desktop_rect rect = it.rect();
+    rect.intersect_with(frame_rect);
+    if (rect.is_empty()) {
+      continue;
+    }
+    const int left = rect.left() / block_size_;
+    const int right = (rect.right() - 1) / block_size_;
+    const int top = rect.top() / block_size_;
+    const int bottom = (rect.bottom() - 1) / block_size_;
+    for (int y = top; y <= bottom; y++) {
+      std::fill(updated_.begin() + y * width_in_blocks_ + left,
+                updated_.begin() + y * width_in_blocks_ + right + 1, 1);
+    }
+  }
+
+  for (size_t i = 0; i < heat_.size(); i++) {
+    int heat = heat_[i];
+    heat -= (heat + (1 << k_decay_shift) - 1) >> k_decay_shift;
+    if (updated_[i]) {
+      heat = std::min(heat + k_updated_heat, k_max_heat);
+      updated_[i] = 0;
+    }
+    heat_[i] = static_cast<uint8_t>(heat);
+  }
+}
+
+block_change_heatmap::change_class block_change_heatmap::classify_block(int x, int y) const {
+  const int heat = heat_at(x, y);
+  if (heat >= k_video_heat) {
+    return change_class::video;
+  }
+  if (heat >= k_ui_heat) {
+    return change_class::ui;
+  }
+  return change_class::still;
+}
+
+desktop_region block_change_heatmap::region_of(change_class cls) const {
+  desktop_region result;
+  for (int y = 0; y < height_in_blocks_; y++) {
+    const int top = y * block_size_;
+    const int bottom = std::min(top + block_size_, size_.height());
+    // The first block-column in a continuous area of `cls` in current row.
+    int first_x = -1;
+    for (int x = 0; x <= width_in_blocks_; x++) {
+      const bool matches = x < width_in_blocks_ && classify_block(x, y) == cls;
+      if (matches && first_x == -1) {
+        first_x = x;
+      } else if (!matches && first_x != -1) {
+        result.add_rect(desktop_rect::make_ltrb(first_x * block_size_, top,
+                                                std::min(x * block_size_, size_.width()), bottom));
+        first_x = -1;
+      }
+    }
+  }
+  return result;
+}
+
+} // namespace base
+} // namespace traa
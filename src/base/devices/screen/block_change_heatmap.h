@@ -0,0 +1,76 @@
+#ifndef TRAA_BASE_DEVICES_SCREEN_BLOCK_CHANGE_HEATMAP_H_
+#define TRAA_BASE_DEVICES_SCREEN_BLOCK_CHANGE_HEATMAP_H_
+
+#include "base/devices/screen/desktop_geometry.h"
+#include "base/devices/screen/desktop_region.h"
+#include "base/devices/screen/differ_block.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace traa {
+namespace base {
+
+// Tracks how frequently each block of a frame changes. Every block holds a
+// counter which is bumped in frames where the block is updated, and decays
+// exponentially in all frames, so the heat of a block reflects its recent
+// change rate. It lets consumers tell still areas, UI areas which change
+// now and then (typing, scrolling) and areas playing video apart.
+class block_change_heatmap final {
+public:
+  // The heat of a block which changes in every frame saturates at this value.
+  static constexpr int k_max_heat = 255;
+
+  enum class change_class {
+    // The block has not changed in a while.
+    still,
+    // The block changes occasionally.
+    ui,
+    // The block changes in about half of the frames or more.
+    video,
+  };
+
+  block_change_heatmap();
+  ~block_change_heatmap();
+
+  // Clears the history and sets the size of the tracked frames, and the width
+  // and height of their blocks. The blocks should match the ones the updated
+  // regions are built from, otherwise a change marks several blocks.
+  void reset(const desktop_size &size, int block_size = k_differ_block_size);
+
+  // Decays the heat of all blocks, and bumps the blocks which intersect
+  // `updated_region`. Each block is bumped at most once per frame.
+  void update(const desktop_region &updated_region);
+
+  // The size of the tracked frames.
+  const desktop_size &size() const { return size_; }
+  int block_size() const { return block_size_; }
+
+  int width_in_blocks() const { return width_in_blocks_; }
+  int height_in_blocks() const { return height_in_blocks_; }
+
+  // Returns the heat of the block at (`x`, `y`), in blocks, within
+  // [0, k_max_heat].
+  int heat_at(int x, int y) const { return heat_[y * width_in_blocks_ + x]; }
+
+  // Returns the class of the block at (`x`, `y`), in blocks.
+  change_class classify_block(int x, int y) const;
+
+  // Returns the area of the frame covered by blocks of class `cls`.
+  desktop_region region_of(change_class cls) const;
+
+private:
+  desktop_size size_;
+  int block_size_ = k_differ_block_size;
+  int width_in_blocks_ = 0;
+  int height_in_blocks_ = 0;
+  std::vector<uint8_t> heat_;
+  // Scratch buffer marking the blocks updated in current frame.
+  std::vector<uint8_t> updated_;
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_BLOCK_CHANGE_HEATMAP_H_
@@ -0,0 +1,102 @@
+#include "base/devices/screen/block_change_heatmap.h"
+
+#include "base/devices/screen/differ_block.h"
+
+#include <gtest/gtest.h>
+
+namespace traa {
+namespace base {
+
+TEST(block_change_heatmap_test, size_in_blocks) {
+  block_change_heatmap heatmap;
+  heatmap.reset(desktop_size(k_differ_block_size * 3 + 1, k_differ_block_size * 2));
+  EXPECT_EQ(heatmap.width_in_blocks(), 4);
+  EXPECT_EQ(heatmap.height_in_blocks(), 2);
+  for (int y = 0; y < heatmap.height_in_blocks(); y++) {
+    for (int x = 0; x < heatmap.width_in_blocks(); x++) {
+      EXPECT_EQ(heatmap.heat_at(x, y), 0);
+    }
+  }
+}
+
+TEST(block_change_heatmap_test, larger_blocks) {
+  block_change_heatmap heatmap;
+  const int block_size = k_differ_block_size * 2;
+  heatmap.reset(desktop_size(block_size * 2, block_size), block_size);
+  EXPECT_EQ(heatmap.block_size(), block_size);
+  EXPECT_EQ(heatmap.width_in_blocks(), 2);
+  EXPECT_EQ(heatmap.height_in_blocks(), 1);
+
+  // A change of a whole block bumps only that block.
+  heatmap.update(desktop_region(desktop_rect::make_xywh(0, 0, block_size, block_size)));
+  EXPECT_GT(heatmap.heat_at(0, 0), 0);
+  EXPECT_EQ(heatmap.heat_at(1, 0), 0);
+  EXPECT_TRUE(heatmap.region_of(block_change_heatmap::change_class::still)
+                  .equals(desktop_region(
+                      desktop_rect::make_xywh(block_size, 0, block_size, block_size))));
+}
+
+TEST(block_change_heatmap_test, heat_rises_and_decays) {
+  block_change_heatmap heatmap;
+  heatmap.reset(desktop_size(k_differ_block_size * 4, k_differ_block_size * 4));
+
+  // A block updated in every frame ends up as video.
+  const desktop_region region(desktop_rect::make_xywh(0, 0, 1, 1));
+  for (int i = 0; i < 30; i++) {
+    heatmap.update(region);
+  }
+  EXPECT_EQ(heatmap.heat_at(0, 0), block_change_heatmap::k_max_heat);
+  EXPECT_EQ(heatmap.classify_block(0, 0), block_change_heatmap::change_class::video);
+  EXPECT_EQ(heatmap.classify_block(1, 0), block_change_heatmap::change_class::still);
+
+  // Then cools down to UI, and eventually to still, once it stops changing.
+  for (int i = 0; i < 10; i++) {
+    heatmap.update(desktop_region());
+  }
+  EXPECT_EQ(heatmap.classify_block(0, 0), block_change_heatmap::change_class::ui);
+  for (int i = 0; i < 30; i++) {
+    heatmap.update(desktop_region());
+  }
+  EXPECT_EQ(heatmap.heat_at(0, 0), 0);
+}
+
+TEST(block_change_heatmap_test, block_is_bumped_once_per_frame) {
+  block_change_heatmap heatmap;
+  heatmap.reset(desktop_size(k_differ_block_size * 2, k_differ_block_size));
+
+  desktop_region region;
+  region.add_rect(desktop_rect::make_xywh(0, 0, 1, 1));
+  region.add_rect(desktop_rect::make_xywh(2, 2, 1, 1));
+  heatmap.update(region);
+  const int heat = heatmap.heat_at(0, 0);
+  EXPECT_GT(heat, 0);
+
+  heatmap.reset(heatmap.size());
+  heatmap.update(desktop_region(desktop_rect::make_xywh(0, 0, 1, 1)));
+  EXPECT_EQ(heatmap.heat_at(0, 0), heat);
+  EXPECT_EQ(heatmap.heat_at(1, 0), 0);
+}
+
+TEST(block_change_heatmap_test, region_of_class) {
+  block_change_heatmap heatmap;
+  const desktop_size size(k_differ_block_size * 3 + 10, k_differ_block_size * 2);
+  heatmap.reset(size);
+
+  // The right-most blocks of the first row, including the partial one.
+  const desktop_rect video_rect =
+      desktop_rect::make_ltrb(k_differ_block_size * 2, 0, size.width(), k_differ_block_size);
+  for (int i = 0; i < 30; i++) {
+    heatmap.update(desktop_region(video_rect));
+  }
+
+  EXPECT_TRUE(heatmap.region_of(block_change_heatmap::change_class::video)
+                  .equals(desktop_region(video_rect)));
+  EXPECT_TRUE(heatmap.region_of(block_change_heatmap::change_class::ui).is_empty());
+
+  desktop_region still(desktop_rect::make_size(size));
+  still.subtract(video_rect);
+  EXPECT_TRUE(heatmap.region_of(block_change_heatmap::change_class::still).equals(still));
+}
+
+} // namespace base
+} // namespace traa
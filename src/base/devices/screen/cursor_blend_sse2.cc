@@ -0,0 +1,51 @@
+#include "base/devices/screen/cursor_blend_sse2.h"
+
+#if defined(TRAA_ARCH_X86_FAMILY)
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// Returns `dest` * (255 - alpha of `src`) / 255 of 2 pixels, as 16-bit values.
+__m128i scale_by_inverse_alpha(__m128i dest, __m128i src) {
+  // Broadcast the alpha of each pixel to its 4 channels.
+  __m128i alpha = _mm_shufflelo_epi16(src, _MM_SHUFFLE(3, 3, 3, 3));
+  alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+  const __m128i inverse_alpha = _mm_sub_epi16(_mm_set1_epi16(255), alpha);
+  const __m128i product = _mm_mullo_epi16(dest, inverse_alpha);
+  // product / 255 == (product + 1 + (product >> 8)) >> 8, for products of two
+  // bytes.
+  const __m128i biased =
+      _mm_add_epi16(_mm_add_epi16(product, _mm_set1_epi16(1)), _mm_srli_epi16(product, 8));
+  return _mm_srli_epi16(biased, 8);
+}
+
+} // namespace
+
+extern int blend_cursor_row_sse2(uint8_t *dest, const uint8_t *src, int width) {
+  const __m128i zero = _mm_setzero_si128();
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    __m128i *d = reinterpret_cast<__m128i *>(dest + x * 4);
+    const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+    const __m128i dv = _mm_loadu_si128(d);
+    const __m128i low = scale_by_inverse_alpha(_mm_unpacklo_epi8(dv, zero),
+                                               _mm_unpacklo_epi8(s, zero));
+    const __m128i high = scale_by_inverse_alpha(_mm_unpackhi_epi8(dv, zero),
+                                                _mm_unpackhi_epi8(s, zero));
+    _mm_storeu_si128(d, _mm_adds_epu8(_mm_packus_epi16(low, high), s));
+  }
+  return x;
+}
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_ARCH_X86_FAMILY
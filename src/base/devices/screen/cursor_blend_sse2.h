@@ -0,0 +1,25 @@
+// This header file is used only by desktop_and_cursor_composer.cc. It defines
+// the SSE2 routine for alpha blending rows of cursor pixels.
+
+#ifndef TRAA_BASE_DEVICES_SCREEN_CURSOR_BLEND_SSE2_H_
+#define TRAA_BASE_DEVICES_SCREEN_CURSOR_BLEND_SSE2_H_
+
+#include "base/arch.h"
+
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+#include <stdint.h>
+
+namespace traa {
+namespace base {
+
+// Blends premultiplied `src` pixels over `dest` pixels, for as many of the
+// `width` pixels as fit into whole SSE2 registers, and returns their number.
+// The caller blends the rest.
+extern int blend_cursor_row_sse2(uint8_t *dest, const uint8_t *src, int width);
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+
+#endif // TRAA_BASE_DEVICES_SCREEN_CURSOR_BLEND_SSE2_H_
@@ -0,0 +1,219 @@
+/*
+ *  Copyright (c) 2013 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "base/devices/screen/desktop_and_cursor_composer.h"
+
+#include "base/arch.h"
+#include "base/checks.h"
+#include "base/devices/screen/desktop_region.h"
+#include "base/system/cpu_features_wrapper.h"
+
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+#include "base/devices/screen/cursor_blend_sse2.h"
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// Blends premultiplied `src` pixels in [`first`, `width`) over `dest` pixels.
+void blend_cursor_row_c(uint8_t *dest, const uint8_t *src, int first, int width) {
+  for (int x = first; x < width; x++) {
+    uint8_t *d = dest + x * desktop_frame::k_bytes_per_pixel;
+    const uint8_t *s = src + x * desktop_frame::k_bytes_per_pixel;
+    const int inverse_alpha = 255 - s[3];
+    for (int c = 0; c < desktop_frame::k_bytes_per_pixel; c++) {
+      d[c] = static_cast<uint8_t>(std::min(255, s[c] + d[c] * inverse_alpha / 255));
+    }
+  }
+}
+
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+bool have_sse2() {
+  static const bool have = get_cpu_info(CPU_FEATURE_X86_SSE2) != 0;
+  return have;
+}
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+
+void blend_cursor_row(uint8_t *dest, const uint8_t *src, int width) {
+  int first = 0;
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+  if (have_sse2()) {
+    first = blend_cursor_row_sse2(dest, src, width);
+  }
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+  blend_cursor_row_c(dest, src, first, width);
+}
+
+// desktop_frame wrapper that draws mouse on a frame and restores the original
+// content before releasing the underlying frame.
+class desktop_frame_with_cursor : public desktop_frame {
+public:
+  // Takes ownership of `frame`. `cursor_rect` is the part of the frame covered
+  // by `cursor`, and `cursor_origin` is the position of the top-left corner of
+  // the cursor image, both in frame coordinates.
+  desktop_frame_with_cursor(std::unique_ptr<desktop_frame> frame, const mouse_cursor &cursor,
+                            const desktop_vector &cursor_origin, const desktop_rect &cursor_rect);
+  ~desktop_frame_with_cursor() override;
+
+  desktop_frame_with_cursor(const desktop_frame_with_cursor &) = delete;
+  desktop_frame_with_cursor &operator=(const desktop_frame_with_cursor &) = delete;
+
+private:
+  const std::unique_ptr<desktop_frame> original_frame_;
+
+  desktop_rect cursor_rect_;
+  // The pixels of `original_frame_` under `cursor_rect_`.
+  std::unique_ptr<desktop_frame> background_;
+};
+
+desktop_frame_with_cursor::desktop_frame_with_cursor(std::unique_ptr<desktop_frame> frame,
+                                                     const mouse_cursor &cursor,
+                                                     const desktop_vector &cursor_origin,
+                                                     const desktop_rect &cursor_rect)
+    : desktop_frame(frame->size(), frame->stride(), frame->data(), frame->get_shared_memory()),
+      original_frame_(std::move(frame)), cursor_rect_(cursor_rect) {
+  move_frame_info_from(original_frame_.get());
+
+  if (cursor_rect_.is_empty()) {
+    return;
+  }
+
+  background_.reset(new basic_desktop_frame(cursor_rect_.size()));
+  background_->copy_pixels_from(*this, cursor_rect_.top_left(),
+                                desktop_rect::make_size(cursor_rect_.size()));
+
+  const desktop_frame &image = *cursor.image();
+  const uint8_t *src =
+      image.get_frame_data_at_pos(cursor_rect_.top_left().subtract(cursor_origin));
+  uint8_t *dest = get_frame_data_at_pos(cursor_rect_.top_left());
+  for (int y = 0; y < cursor_rect_.height(); y++) {
+    blend_cursor_row(dest, src, cursor_rect_.width());
+    src += image.stride();
+    dest += stride();
+  }
+}
+
+desktop_frame_with_cursor::~desktop_frame_with_cursor() {
+  // Restore original content of the frame.
+  if (background_) {
+    copy_pixels_from(*background_, desktop_vector(), cursor_rect_);
+  }
+}
+
+} // namespace
+
+desktop_and_cursor_composer::desktop_and_cursor_composer(
+    std::unique_ptr<desktop_capturer> desktop_capturer,
+    std::unique_ptr<mouse_cursor_monitor> mouse_monitor)
+    : desktop_capturer_(std::move(desktop_capturer)), mouse_monitor_(std::move(mouse_monitor)) {
+  TRAA_DCHECK(desktop_capturer_);
+}
+
+desktop_and_cursor_composer::~desktop_and_cursor_composer() = default;
+
+void desktop_and_cursor_composer::start(desktop_capturer::capture_callback *callback) {
+  callback_ = callback;
+  if (mouse_monitor_) {
+    mouse_monitor_->init(this, mouse_cursor_monitor::mode::shape_and_position);
+  }
+  desktop_capturer_->start(this);
+}
+
+void desktop_and_cursor_composer::set_shared_memory_factory(
+    std::unique_ptr<shared_memory_factory> shared_memory_factory) {
+  desktop_capturer_->set_shared_memory_factory(std::move(shared_memory_factory));
+}
+
+void desktop_and_cursor_composer::capture_frame() {
+  if (mouse_monitor_) {
+    mouse_monitor_->capture();
+  }
+  desktop_capturer_->capture_frame();
+}
+
+void desktop_and_cursor_composer::set_excluded_window(win_id_t window) {
+  desktop_capturer_->set_excluded_window(window);
+}
+
+bool desktop_and_cursor_composer::get_source_list(source_list_t *sources) {
+  return desktop_capturer_->get_source_list(sources);
+}
+
+bool desktop_and_cursor_composer::select_source(source_id_t id) {
+  return desktop_capturer_->select_source(id);
+}
+
+bool desktop_and_cursor_composer::focus_on_selected_source() {
+  return desktop_capturer_->focus_on_selected_source();
+}
+
+bool desktop_and_cursor_composer::is_occluded(const desktop_vector &pos) {
+  return desktop_capturer_->is_occluded(pos);
+}
+
+void desktop_and_cursor_composer::on_capture_start() { callback_->on_capture_start(); }
+
+void desktop_and_cursor_composer::on_capture_result(desktop_capturer::capture_result result,
+                                                    std::unique_ptr<desktop_frame> frame) {
+  if (!frame || !mouse_monitor_ || frame->may_contain_cursor()) {
+    callback_->on_capture_result(result, std::move(frame));
+    return;
+  }
+
+  const desktop_rect frame_rect = desktop_rect::make_size(frame->size());
+  desktop_vector cursor_origin;
+  desktop_rect cursor_rect;
+  if (cursor_ && cursor_->image()) {
+    cursor_origin = cursor_position_.subtract(frame->top_left()).subtract(cursor_->hotspot());
+    cursor_rect = desktop_rect::make_origin_size(cursor_origin, cursor_->image()->size());
+    cursor_rect.intersect_with(frame_rect);
+  }
+
+  // The consumer still shows the cursor drawn into the previous frame, and the
+  // wrapped capturer does not know about it, so both the old and the new
+  // cursor areas need to be repainted.
+  if (!cursor_rect.equals(previous_cursor_rect_) || cursor_changed_) {
+    desktop_rect previous_rect = previous_cursor_rect_;
+    previous_rect.intersect_with(frame_rect);
+    frame->mutable_updated_region()->add_rect(previous_rect);
+    frame->mutable_updated_region()->add_rect(cursor_rect);
+  }
+  previous_cursor_rect_ = cursor_rect;
+  cursor_changed_ = false;
+
+  std::unique_ptr<desktop_frame> composed_frame;
+  if (cursor_rect.is_empty()) {
+    composed_frame = std::move(frame);
+  } else {
+    composed_frame.reset(
+        new desktop_frame_with_cursor(std::move(frame), *cursor_, cursor_origin, cursor_rect));
+  }
+  composed_frame->set_may_contain_cursor(true);
+  callback_->on_capture_result(result, std::move(composed_frame));
+}
+
+void desktop_and_cursor_composer::on_mouse_cursor(mouse_cursor *cursor) {
+  cursor_.reset(cursor);
+  cursor_changed_ = true;
+}
+
+void desktop_and_cursor_composer::on_mouse_cursor_position(const desktop_vector &position) {
+  cursor_position_ = position;
+}
+
+} // namespace base
+} // namespace traa
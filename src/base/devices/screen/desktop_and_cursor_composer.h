@@ -0,0 +1,92 @@
+/*
+ *  Copyright (c) 2013 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef TRAA_BASE_DEVICES_SCREEN_DESKTOP_AND_CURSOR_COMPOSER_H_
+#define TRAA_BASE_DEVICES_SCREEN_DESKTOP_AND_CURSOR_COMPOSER_H_
+
+#include "base/devices/screen/desktop_capture_types.h"
+#include "base/devices/screen/desktop_capturer.h"
+#include "base/devices/screen/desktop_frame.h"
+#include "base/devices/screen/desktop_geometry.h"
+#include "base/devices/screen/mouse_cursor.h"
+#include "base/devices/screen/mouse_cursor_monitor.h"
+#include "base/devices/screen/shared_memory.h"
+
+#include <memory>
+
+namespace traa {
+namespace base {
+
+// A wrapper for desktop_capturer that also captures mouse using specified
+// mouse_cursor_monitor and renders it on the generated streams.
+//
+// The cursor is alpha blended into the frame returned by the wrapped
+// capturer, and the pixels under it are saved in a small background tile.
+// They are written back when the returned frame is destroyed, so the buffer
+// of the wrapped capturer stays free of the cursor without copying the
+// frame. Consumers must release each frame before capturing the next one.
+//
+// Only the cursor rects of the previous and current frames are added to the
+// updated_region(), so moving the cursor over a still desktop updates a few
+// KB of pixels.
+class desktop_and_cursor_composer final : public desktop_capturer,
+                                          public desktop_capturer::capture_callback,
+                                          public mouse_cursor_monitor::callback {
+public:
+  // Creates a new composer that captures mouse cursor using `mouse_monitor`
+  // and renders it into the frames generated by `desktop_capturer`. Frames
+  // pass through unchanged if `mouse_monitor` is nullptr.
+  desktop_and_cursor_composer(std::unique_ptr<desktop_capturer> desktop_capturer,
+                              std::unique_ptr<mouse_cursor_monitor> mouse_monitor);
+  ~desktop_and_cursor_composer() override;
+
+  desktop_and_cursor_composer(const desktop_and_cursor_composer &) = delete;
+  desktop_and_cursor_composer &operator=(const desktop_and_cursor_composer &) = delete;
+
+  // desktop_capturer interface.
+  void start(desktop_capturer::capture_callback *callback) override;
+  void
+  set_shared_memory_factory(std::unique_ptr<shared_memory_factory> shared_memory_factory) override;
+  void capture_frame() override;
+  void set_excluded_window(win_id_t window) override;
+  bool get_source_list(source_list_t *sources) override;
+  bool select_source(source_id_t id) override;
+  bool focus_on_selected_source() override;
+  bool is_occluded(const desktop_vector &pos) override;
+
+private:
+  // desktop_capturer::capture_callback interface.
+  void on_capture_start() override;
+  void on_capture_result(desktop_capturer::capture_result result,
+                         std::unique_ptr<desktop_frame> frame) override;
+
+  // mouse_cursor_monitor::callback interface.
+  void on_mouse_cursor(mouse_cursor *cursor) override;
+  void on_mouse_cursor_position(const desktop_vector &position) override;
+
+  const std::unique_ptr<desktop_capturer> desktop_capturer_;
+  const std::unique_ptr<mouse_cursor_monitor> mouse_monitor_;
+
+  desktop_capturer::capture_callback *callback_ = nullptr;
+
+  std::unique_ptr<mouse_cursor> cursor_;
+  // The cursor position relative to the top-left corner of the whole desktop.
+  desktop_vector cursor_position_;
+  // Whether the cursor shape changed since the previous frame.
+  bool cursor_changed_ = false;
+  // The rect the cursor was drawn at in the previous frame, in frame
+  // coordinates, or an empty rect.
+  desktop_rect previous_cursor_rect_;
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_DESKTOP_AND_CURSOR_COMPOSER_H_
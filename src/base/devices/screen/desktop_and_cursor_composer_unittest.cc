@@ -0,0 +1,341 @@
+#include "base/devices/screen/desktop_and_cursor_composer.h"
+
+#include "base/devices/screen/desktop_capturer.h"
+#include "base/devices/screen/desktop_frame.h"
+#include "base/devices/screen/desktop_geometry.h"
+#include "base/devices/screen/desktop_region.h"
+#include "base/devices/screen/mouse_cursor.h"
+#include "base/devices/screen/mouse_cursor_monitor.h"
+#include "base/devices/screen/shared_desktop_frame.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+constexpr int k_screen_width = 100;
+constexpr int k_screen_height = 80;
+
+void fill_random(desktop_frame *frame) {
+  for (int y = 0; y < frame->size().height(); y++) {
+    uint8_t *row = frame->get_frame_data_at_pos(desktop_vector(0, y));
+    for (int i = 0; i < frame->size().width() * desktop_frame::k_bytes_per_pixel; i++) {
+      row[i] = static_cast<uint8_t>(rand());
+    }
+  }
+}
+
+// Returns a cursor image of random premultiplied pixels, including fully
+// transparent and fully opaque ones.
+desktop_frame *create_cursor_image(const desktop_size &size) {
+  desktop_frame *image = new basic_desktop_frame(size);
+  for (int y = 0; y < size.height(); y++) {
+    for (int x = 0; x < size.width(); x++) {
+      uint8_t *pixel = image->get_frame_data_at_pos(desktop_vector(x, y));
+      const int selector = rand() % 4;
+      const uint8_t alpha = selector == 0 ? 0 : selector == 1 ? 255 : rand() % 256;
+      for (int c = 0; c < 3; c++) {
+        pixel[c] = static_cast<uint8_t>(alpha == 0 ? 0 : rand() % (alpha + 1));
+      }
+      pixel[3] = alpha;
+    }
+  }
+  return image;
+}
+
+// Returns the pixel of `background` at `pos` with the pixel of `cursor` at
+// `cursor_pos` blended over it.
+uint32_t blend_pixel(const desktop_frame &background, const desktop_vector &pos,
+                     const desktop_frame &cursor, const desktop_vector &cursor_pos) {
+  const uint8_t *d = background.get_frame_data_at_pos(pos);
+  const uint8_t *s = cursor.get_frame_data_at_pos(cursor_pos);
+  uint8_t result[4];
+  for (int c = 0; c < 4; c++) {
+    result[c] = static_cast<uint8_t>(std::min(255, s[c] + d[c] * (255 - s[3]) / 255));
+  }
+  uint32_t pixel;
+  memcpy(&pixel, result, sizeof(pixel));
+  return pixel;
+}
+
+uint32_t pixel_at(const desktop_frame &frame, const desktop_vector &pos) {
+  uint32_t pixel;
+  memcpy(&pixel, frame.get_frame_data_at_pos(pos), sizeof(pixel));
+  return pixel;
+}
+
+bool frames_equal(const desktop_frame &a, const desktop_frame &b) {
+  if (!a.size().equals(b.size())) {
+    return false;
+  }
+  for (int y = 0; y < a.size().height(); y++) {
+    if (memcmp(a.get_frame_data_at_pos(desktop_vector(0, y)),
+               b.get_frame_data_at_pos(desktop_vector(0, y)),
+               a.size().width() * desktop_frame::k_bytes_per_pixel) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A capturer which returns the same buffer on every capture, like the screen
+// capturers do, with a configurable updated region.
+class fake_screen_capturer : public desktop_capturer {
+public:
+  fake_screen_capturer() {
+    std::unique_ptr<desktop_frame> frame(
+        new basic_desktop_frame(desktop_size(k_screen_width, k_screen_height)));
+    fill_random(frame.get());
+    frame_ = shared_desktop_frame::wrap(std::move(frame));
+  }
+
+  void start(capture_callback *callback) override { callback_ = callback; }
+
+  void capture_frame() override {
+    std::unique_ptr<desktop_frame> frame = frame_->share();
+    frame->set_top_left(top_left_);
+    *frame->mutable_updated_region() = next_updated_region_;
+    next_updated_region_.clear();
+    callback_->on_capture_result(capture_result::success, std::move(frame));
+  }
+
+  bool get_source_list(source_list_t *sources) override { return true; }
+  bool select_source(source_id_t id) override { return true; }
+
+  desktop_frame *frame() { return frame_.get(); }
+  void set_top_left(const desktop_vector &top_left) { top_left_ = top_left; }
+  void set_next_updated_region(const desktop_region &region) { next_updated_region_ = region; }
+
+private:
+  capture_callback *callback_ = nullptr;
+  std::unique_ptr<shared_desktop_frame> frame_;
+  desktop_vector top_left_;
+  desktop_region next_updated_region_;
+};
+
+class fake_mouse_monitor : public mouse_cursor_monitor {
+public:
+  void init(callback *callback, mode mode) override { callback_ = callback; }
+
+  void capture() override {
+    if (changed_) {
+      callback_->on_mouse_cursor(new mouse_cursor(create_cursor_image(size_), hotspot_));
+      changed_ = false;
+    }
+    callback_->on_mouse_cursor_position(position_);
+  }
+
+  void set_cursor(const desktop_size &size, const desktop_vector &hotspot) {
+    size_ = size;
+    hotspot_ = hotspot;
+    changed_ = true;
+  }
+  void set_position(const desktop_vector &position) { position_ = position; }
+
+private:
+  callback *callback_ = nullptr;
+  desktop_size size_;
+  desktop_vector hotspot_;
+  desktop_vector position_;
+  bool changed_ = false;
+};
+
+// Keeps the cursor reported to the composer, to verify the blended pixels.
+class recording_mouse_monitor : public mouse_cursor_monitor,
+                                public mouse_cursor_monitor::callback {
+public:
+  explicit recording_mouse_monitor(fake_mouse_monitor *monitor) : monitor_(monitor) {}
+
+  void init(mouse_cursor_monitor::callback *callback, mode mode) override {
+    callback_ = callback;
+    monitor_->init(this, mode);
+  }
+  void capture() override { monitor_->capture(); }
+
+  void on_mouse_cursor(mouse_cursor *cursor) override {
+    cursor_.reset(mouse_cursor::copy_of(*cursor));
+    callback_->on_mouse_cursor(cursor);
+  }
+  void on_mouse_cursor_position(const desktop_vector &position) override {
+    callback_->on_mouse_cursor_position(position);
+  }
+
+  const mouse_cursor *cursor() const { return cursor_.get(); }
+
+private:
+  fake_mouse_monitor *monitor_;
+  mouse_cursor_monitor::callback *callback_ = nullptr;
+  std::unique_ptr<mouse_cursor> cursor_;
+};
+
+class desktop_and_cursor_composer_test : public ::testing::Test,
+                                         public desktop_capturer::capture_callback {
+public:
+  desktop_and_cursor_composer_test()
+      : capturer_(new fake_screen_capturer()), monitor_(new fake_mouse_monitor()),
+        recorder_(new recording_mouse_monitor(monitor_.get())),
+        composer_(std::unique_ptr<desktop_capturer>(capturer_),
+                  std::unique_ptr<mouse_cursor_monitor>(recorder_)) {
+    composer_.start(this);
+  }
+
+  void on_capture_result(desktop_capturer::capture_result result,
+                         std::unique_ptr<desktop_frame> frame) override {
+    frame_ = std::move(frame);
+  }
+
+  // Verifies that `frame_` is the original screen with the recorded cursor
+  // blended at `position` minus the hotspot.
+  void verify_composed(const desktop_frame &original, const desktop_vector &position) {
+    ASSERT_TRUE(frame_);
+    const mouse_cursor &cursor = *recorder_->cursor();
+    const desktop_vector origin = position.subtract(cursor.hotspot());
+    for (int y = 0; y < k_screen_height; y++) {
+      for (int x = 0; x < k_screen_width; x++) {
+        const desktop_vector pos(x, y);
+        const desktop_vector cursor_pos = pos.subtract(origin);
+        const bool in_cursor =
+            desktop_rect::make_size(cursor.image()->size()).contains(cursor_pos);
+        const uint32_t expected =
+            in_cursor ? blend_pixel(original, pos, *cursor.image(), cursor_pos)
+                      : pixel_at(original, pos);
+        ASSERT_EQ(expected, pixel_at(*frame_, pos)) << "at " << x << "," << y;
+      }
+    }
+  }
+
+protected:
+  fake_screen_capturer *capturer_;
+  std::unique_ptr<fake_mouse_monitor> monitor_;
+  recording_mouse_monitor *recorder_;
+  desktop_and_cursor_composer composer_;
+  std::unique_ptr<desktop_frame> frame_;
+};
+
+} // namespace
+
+TEST_F(desktop_and_cursor_composer_test, blends_cursor_and_restores_background) {
+  basic_desktop_frame original(desktop_size(k_screen_width, k_screen_height));
+  original.copy_pixels_from(*capturer_->frame(), desktop_vector(),
+                            desktop_rect::make_size(original.size()));
+
+  // Odd widths exercise the scalar tail of the SIMD rows.
+  const desktop_size sizes[] = {desktop_size(32, 32), desktop_size(13, 7), desktop_size(1, 5)};
+  for (const desktop_size &size : sizes) {
+    monitor_->set_cursor(size, desktop_vector(size.width() / 2, size.height() / 2));
+    monitor_->set_position(desktop_vector(41, 23));
+    composer_.capture_frame();
+    verify_composed(original, desktop_vector(41, 23));
+    EXPECT_TRUE(frame_->may_contain_cursor());
+
+    frame_.reset();
+    EXPECT_TRUE(frames_equal(original, *capturer_->frame()));
+  }
+}
+
+TEST_F(desktop_and_cursor_composer_test, clips_cursor_to_frame) {
+  basic_desktop_frame original(desktop_size(k_screen_width, k_screen_height));
+  original.copy_pixels_from(*capturer_->frame(), desktop_vector(),
+                            desktop_rect::make_size(original.size()));
+
+  monitor_->set_cursor(desktop_size(17, 17), desktop_vector(3, 5));
+  const desktop_vector positions[] = {desktop_vector(0, 0), desktop_vector(k_screen_width - 2, 40),
+                                      desktop_vector(50, k_screen_height + 4)};
+  for (const desktop_vector &position : positions) {
+    monitor_->set_position(position);
+    composer_.capture_frame();
+    verify_composed(original, position);
+    frame_.reset();
+    EXPECT_TRUE(frames_equal(original, *capturer_->frame()));
+  }
+}
+
+TEST_F(desktop_and_cursor_composer_test, uses_frame_top_left) {
+  basic_desktop_frame original(desktop_size(k_screen_width, k_screen_height));
+  original.copy_pixels_from(*capturer_->frame(), desktop_vector(),
+                            desktop_rect::make_size(original.size()));
+
+  capturer_->set_top_left(desktop_vector(200, 100));
+  monitor_->set_cursor(desktop_size(16, 16), desktop_vector());
+  monitor_->set_position(desktop_vector(210, 120));
+  composer_.capture_frame();
+  verify_composed(original, desktop_vector(10, 20));
+}
+
+TEST_F(desktop_and_cursor_composer_test, updates_only_cursor_rects) {
+  monitor_->set_cursor(desktop_size(16, 16), desktop_vector(2, 2));
+  monitor_->set_position(desktop_vector(10, 10));
+  capturer_->set_next_updated_region(
+      desktop_region(desktop_rect::make_size(desktop_size(k_screen_width, k_screen_height))));
+  composer_.capture_frame();
+  ASSERT_TRUE(frame_);
+  frame_.reset();
+
+  // The cursor did not change and the screen is still.
+  composer_.capture_frame();
+  ASSERT_TRUE(frame_);
+  EXPECT_TRUE(frame_->updated_region().is_empty());
+  frame_.reset();
+
+  // The cursor moved, so only its previous and new rects are repainted.
+  monitor_->set_position(desktop_vector(50, 30));
+  composer_.capture_frame();
+  ASSERT_TRUE(frame_);
+  desktop_region expected;
+  expected.add_rect(desktop_rect::make_xywh(8, 8, 16, 16));
+  expected.add_rect(desktop_rect::make_xywh(48, 28, 16, 16));
+  EXPECT_TRUE(frame_->updated_region().equals(expected));
+  frame_.reset();
+
+  // The cursor changed its shape at the same position.
+  monitor_->set_cursor(desktop_size(16, 16), desktop_vector(2, 2));
+  composer_.capture_frame();
+  ASSERT_TRUE(frame_);
+  EXPECT_TRUE(
+      frame_->updated_region().equals(desktop_region(desktop_rect::make_xywh(48, 28, 16, 16))));
+  frame_.reset();
+
+  // The cursor left the frame, and the area it covered is repainted.
+  monitor_->set_position(desktop_vector(500, 500));
+  composer_.capture_frame();
+  ASSERT_TRUE(frame_);
+  EXPECT_TRUE(
+      frame_->updated_region().equals(desktop_region(desktop_rect::make_xywh(48, 28, 16, 16))));
+  frame_.reset();
+
+  composer_.capture_frame();
+  ASSERT_TRUE(frame_);
+  EXPECT_TRUE(frame_->updated_region().is_empty());
+}
+
+TEST(desktop_and_cursor_composer_no_monitor_test, passes_frames_through) {
+  class result_callback : public desktop_capturer::capture_callback {
+  public:
+    void on_capture_result(desktop_capturer::capture_result result,
+                           std::unique_ptr<desktop_frame> frame) override {
+      frame_ = std::move(frame);
+    }
+    std::unique_ptr<desktop_frame> frame_;
+  };
+
+  fake_screen_capturer *capturer = new fake_screen_capturer();
+  desktop_and_cursor_composer composer(std::unique_ptr<desktop_capturer>(capturer), nullptr);
+  result_callback callback;
+  composer.start(&callback);
+  composer.capture_frame();
+  ASSERT_TRUE(callback.frame_);
+  EXPECT_EQ(capturer->frame()->data(), callback.frame_->data());
+  EXPECT_FALSE(callback.frame_->may_contain_cursor());
+}
+
+} // namespace base
+} // namespace traa
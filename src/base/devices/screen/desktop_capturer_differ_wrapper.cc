@@ -13,6 +13,8 @@
 #include "base/devices/screen/desktop_geometry.h"
 #include "base/devices/screen/desktop_region.h"
 #include "base/devices/screen/differ_block.h"
+#include "base/logger.h"
+#include "base/system/metrics.h"
 #include "base/utils/time_utils.h"
 
 #include <stdint.h>
@@ -40,18 +42,34 @@ bool partial_block_difference(const uint8_t *old_buffer, const uint8_t *new_buff
   return false;
 }
 
+// Returns true if (0, 0) - (`width`, `height`) area in `old_buffer` and
+// `new_buffer` differ. `width` can be larger than k_differ_block_size, the area
+// is then compared in columns of k_differ_block_size.
+bool wide_block_difference(const uint8_t *old_buffer, const uint8_t *new_buffer, int width,
+                           int height, int stride) {
+  const int block_x_offset = k_differ_block_size * desktop_frame::k_bytes_per_pixel;
+  for (; width >= k_differ_block_size; width -= k_differ_block_size) {
+    if (block_difference(old_buffer, new_buffer, height, stride)) {
+      return true;
+    }
+    old_buffer += block_x_offset;
+    new_buffer += block_x_offset;
+  }
+  return width > 0 && partial_block_difference(old_buffer, new_buffer, width, height, stride);
+}
+
 // Compares columns in the range of [`left`, `right`), in a row in the
 // range of [`top`, `top` + `height`), starts from `old_buffer` and
 // `new_buffer`, and outputs updated regions into `output`. `stride` is the
-// desktop_frame::stride().
+// desktop_frame::stride(). Blocks are `block_size` pixels wide.
 void compare_row(const uint8_t *old_buffer, const uint8_t *new_buffer, const int left,
                  const int right, const int top, const int bottom, const int stride,
-                 desktop_region *const output) {
-  const int block_x_offset = k_differ_block_size * desktop_frame::k_bytes_per_pixel;
+                 const int block_size, desktop_region *const output) {
+  const int block_x_offset = block_size * desktop_frame::k_bytes_per_pixel;
   const int width = right - left;
   const int height = bottom - top;
-  const int block_count = (width - 1) / k_differ_block_size;
-  const int last_block_width = width - block_count * k_differ_block_size;
+  const int block_count = (width - 1) / block_size;
+  const int last_block_width = width - block_count * block_size;
 
   // The first block-column in a continuous dirty area in current block-row.
   int first_dirty_x_block = -1;
@@ -59,7 +77,7 @@ void compare_row(const uint8_t *old_buffer, const uint8_t *new_buffer, const int
   // We always need to add dirty area into `output` in the last block, so handle
   // it separatedly.
   for (int x = 0; x < block_count; x++) {
-    if (block_difference(old_buffer, new_buffer, height, stride)) {
+    if (wide_block_difference(old_buffer, new_buffer, block_size, height, stride)) {
       if (first_dirty_x_block == -1) {
         // This is the first dirty block in a continuous dirty area.
         first_dirty_x_block = x;
@@ -67,58 +85,58 @@ void compare_row(const uint8_t *old_buffer, const uint8_t *new_buffer, const int
     } else if (first_dirty_x_block != -1) {
       // The block on the left is the last dirty block in a continuous
       // dirty area.
-      output->add_rect(desktop_rect::make_ltrb(first_dirty_x_block * k_differ_block_size + left,
-                                               top, x * k_differ_block_size + left, bottom));
+      output->add_rect(desktop_rect::make_ltrb(first_dirty_x_block * block_size + left, top,
+                                               x * block_size + left, bottom));
       first_dirty_x_block = -1;
     }
     old_buffer += block_x_offset;
     new_buffer += block_x_offset;
   }
 
-  bool last_block_diff;
-  if (last_block_width < k_differ_block_size) {
-    // The last one is a partial vector.
-    last_block_diff =
-        partial_block_difference(old_buffer, new_buffer, last_block_width, height, stride);
-  } else {
-    last_block_diff = block_difference(old_buffer, new_buffer, height, stride);
-  }
-  if (last_block_diff) {
+  // The last one may be a partial block.
+  if (wide_block_difference(old_buffer, new_buffer, last_block_width, height, stride)) {
     if (first_dirty_x_block == -1) {
       first_dirty_x_block = block_count;
     }
-    output->add_rect(desktop_rect::make_ltrb(first_dirty_x_block * k_differ_block_size + left, top,
-                                             right, bottom));
+    output->add_rect(
+        desktop_rect::make_ltrb(first_dirty_x_block * block_size + left, top, right, bottom));
   } else if (first_dirty_x_block != -1) {
-    output->add_rect(desktop_rect::make_ltrb(first_dirty_x_block * k_differ_block_size + left, top,
-                                             block_count * k_differ_block_size + left, bottom));
+    output->add_rect(desktop_rect::make_ltrb(first_dirty_x_block * block_size + left, top,
+                                             block_count * block_size + left, bottom));
   }
 }
 
 // Compares `rect` area in `old_frame` and `new_frame`, and outputs dirty
-// regions into `output`.
-void compare_frames(const desktop_frame &old_frame, const desktop_frame &new_frame,
-                    desktop_rect rect, desktop_region *const output) {
+// regions into `output`. If `deadline_nanos` is not zero and has passed before
+// the comparison finishes, the rest of `rect` is added to `output` without
+// being compared, and false is returned.
+bool compare_frames(const desktop_frame &old_frame, const desktop_frame &new_frame,
+                    desktop_rect rect, const int block_size, const int64_t deadline_nanos,
+                    desktop_region *const output) {
   rect.intersect_with(desktop_rect::make_size(old_frame.size()));
 
-  const int y_block_count = (rect.height() - 1) / k_differ_block_size;
-  const int last_y_block_height = rect.height() - y_block_count * k_differ_block_size;
+  const int y_block_count = (rect.height() - 1) / block_size;
+  const int last_y_block_height = rect.height() - y_block_count * block_size;
   // Offset from the start of one block-row to the next.
-  const int block_y_stride = old_frame.stride() * k_differ_block_size;
+  const int block_y_stride = old_frame.stride() * block_size;
   const uint8_t *prev_block_row_start = old_frame.get_frame_data_at_pos(rect.top_left());
   const uint8_t *curr_block_row_start = new_frame.get_frame_data_at_pos(rect.top_left());
 
   int top = rect.top();
   // The last row may have a different height, so we handle it separately.
-  for (int y = 0; y < y_block_count; y++) {
+  for (int y = 0; y <= y_block_count; y++) {
+    if (deadline_nanos != 0 && time_nanos() > deadline_nanos) {
+      output->add_rect(desktop_rect::make_ltrb(rect.left(), top, rect.right(), rect.bottom()));
+      return false;
+    }
+    const int height = y < y_block_count ? block_size : last_y_block_height;
     compare_row(prev_block_row_start, curr_block_row_start, rect.left(), rect.right(), top,
-                top + k_differ_block_size, old_frame.stride(), output);
-    top += k_differ_block_size;
+                top + height, old_frame.stride(), block_size, output);
+    top += block_size;
     prev_block_row_start += block_y_stride;
     curr_block_row_start += block_y_stride;
   }
-  compare_row(prev_block_row_start, curr_block_row_start, rect.left(), rect.right(), top,
-              top + last_y_block_height, old_frame.stride(), output);
+  return true;
 }
 
 } // namespace
@@ -129,6 +147,24 @@ desktop_capturer_differ_wrapper::desktop_capturer_differ_wrapper(
 
 desktop_capturer_differ_wrapper::~desktop_capturer_differ_wrapper() {}
 
+void desktop_capturer_differ_wrapper::set_time_budget_us(int64_t budget_us) {
+  time_budget_us_ = budget_us;
+  block_size_ = k_differ_block_size;
+  over_budget_frames_ = 0;
+  in_budget_frames_ = 0;
+}
+
+void desktop_capturer_differ_wrapper::set_updated_region_limit(int max_rects,
+                                                               double max_waste_ratio) {
+  max_updated_rects_ = max_rects;
+  max_updated_waste_ratio_ = max_waste_ratio;
+}
+
+void desktop_capturer_differ_wrapper::set_change_heatmap_enabled(bool enabled) {
+  change_heatmap_enabled_ = enabled;
+  change_heatmap_.reset(desktop_size());
+}
+
 void desktop_capturer_differ_wrapper::start(desktop_capturer::capture_callback *callback) {
   callback_ = callback;
   base_capturer_->start(this);
@@ -167,6 +203,36 @@ desktop_capture_metadata desktop_capturer_differ_wrapper::get_metadata() {
 }
 #endif // defined(TRAA_ENABLE_WAYLAND)
 
+void desktop_capturer_differ_wrapper::update_block_size(bool in_budget, int64_t elapsed_nanos) {
+  TRAA_HISTOGRAM_BOOLEAN("WebRTC.DesktopCapture.DifferTimeBudgetExceeded", !in_budget);
+
+  if (!in_budget) {
+    in_budget_frames_ = 0;
+    if (++over_budget_frames_ >= k_max_over_budget_frames &&
+        block_size_ < k_max_block_size_multiplier * k_differ_block_size) {
+      block_size_ *= 2;
+      over_budget_frames_ = 0;
+      LOG_INFO("differ is over its time budget, comparing {}x{} blocks", block_size_, block_size_);
+    }
+    return;
+  }
+
+  over_budget_frames_ = 0;
+  // Only go back to finer blocks when there is plenty of room in the budget, so
+  // the block size does not flip every other frame.
+  if (block_size_ > k_differ_block_size &&
+      elapsed_nanos * 2 < time_budget_us_ * k_num_nanosecs_per_microsec) {
+    if (++in_budget_frames_ >= k_min_in_budget_frames) {
+      block_size_ /= 2;
+      in_budget_frames_ = 0;
+      LOG_INFO("differ is back in its time budget, comparing {}x{} blocks", block_size_,
+               block_size_);
+    }
+  } else {
+    in_budget_frames_ = 0;
+  }
+}
+
 void desktop_capturer_differ_wrapper::on_capture_result(
     capture_result result, std::unique_ptr<desktop_frame> input_frame) {
   int64_t start_time_nanos = time_nanos();
@@ -175,6 +241,8 @@ void desktop_capturer_differ_wrapper::on_capture_result(
     return;
   }
 
+  // The wrapper does not carry the mark of the input frame.
+  const bool updated_region_precomputed = input_frame->is_updated_region_precomputed();
   std::unique_ptr<shared_desktop_frame> frame = shared_desktop_frame::wrap(std::move(input_frame));
   if (last_frame_ && (last_frame_->size().width() != frame->size().width() ||
                       last_frame_->size().height() != frame->size().height() ||
@@ -182,15 +250,57 @@ void desktop_capturer_differ_wrapper::on_capture_result(
     last_frame_.reset();
   }
 
-  if (last_frame_) {
+  // The blocks the updated region is built from. The capturers which compare
+  // the pixels themselves use k_differ_block_size blocks.
+  int updated_block_size = k_differ_block_size;
+  if (last_frame_ && updated_region_precomputed) {
+    // The capturer has compared the pixels while copying them into the frame,
+    // so updated_region() is already accurate.
+  } else if (last_frame_) {
+    const int64_t deadline_nanos =
+        time_budget_us_ > 0 ? start_time_nanos + time_budget_us_ * k_num_nanosecs_per_microsec
+                            : 0;
+    updated_block_size = block_size_;
+    bool in_budget = true;
     desktop_region hints;
     hints.swap(frame->mutable_updated_region());
     for (desktop_region::iterator it(hints); !it.is_at_end(); it.advance()) {
-      compare_frames(*last_frame_, *frame, it.rect(), frame->mutable_updated_region());
+      if (!in_budget) {
+        desktop_rect rect = it.rect();
+        rect.intersect_with(desktop_rect::make_size(frame->size()));
+        frame->mutable_updated_region()->add_rect(rect);
+        continue;
+      }
+      in_budget = compare_frames(*last_frame_, *frame, it.rect(), block_size_, deadline_nanos,
+                                 frame->mutable_updated_region());
+    }
+    if (time_budget_us_ > 0) {
+      // The deadline is only checked before each block row, so the last row
+      // compared may have overrun it.
+      const int64_t elapsed_nanos = time_nanos() - start_time_nanos;
+      in_budget = in_budget && elapsed_nanos <= time_budget_us_ * k_num_nanosecs_per_microsec;
+      update_block_size(in_budget, elapsed_nanos);
     }
   } else {
     frame->mutable_updated_region()->set_rect(desktop_rect::make_size(frame->size()));
   }
+
+  if (change_heatmap_enabled_) {
+    // A full frame update carries no information about which areas change.
+    // Blocks of another size do not continue the history either.
+    if (last_frame_ && change_heatmap_.size().equals(frame->size()) &&
+        change_heatmap_.block_size() == updated_block_size) {
+      change_heatmap_.update(frame->updated_region());
+    } else {
+      change_heatmap_.reset(frame->size(), updated_block_size);
+    }
+  }
+
+  // The heatmap is built from the exact updated region, consumers get the
+  // simplified one.
+  if (max_updated_rects_ > 0) {
+    frame->mutable_updated_region()->simplify(max_updated_rects_, max_updated_waste_ratio_);
+  }
   last_frame_ = frame->share();
 
   frame->set_capture_time_ms(frame->capture_time_ms() +
@@ -12,6 +12,7 @@
 #define TRAA_BASE_DEVICES_SCREEN_DESKTOP_CAPTURER_DIFFER_WRAPPER_H_
 
 #include <memory>
+#include "base/devices/screen/block_change_heatmap.h"
 #if defined(TRAA_ENABLE_WAYLAND)
 #include "base/devices/screen/desktop_capture_metadata.h"
 #endif // defined(TRAA_ENABLE_WAYLAND)
@@ -19,6 +20,7 @@
 #include "base/devices/screen/desktop_capturer.h"
 #include "base/devices/screen/desktop_frame.h"
 #include "base/devices/screen/desktop_geometry.h"
+#include "base/devices/screen/differ_block.h"
 #include "base/devices/screen/shared_desktop_frame.h"
 #include "base/devices/screen/shared_memory.h"
 
@@ -33,6 +35,15 @@ namespace base {
 //
 // This class marks entire frame as updated if the frame size or frame stride
 // has been changed.
+//
+// Frames with desktop_frame::is_updated_region_precomputed() are not compared
+// again, their updated_region() is forwarded as is.
+//
+// The time spent in comparing a frame can be bounded with
+// set_time_budget_us(), at the cost of less accurate updated regions.
+//
+// The number of rectangles in updated_region() can be bounded with
+// set_updated_region_limit(), at the cost of larger updated regions.
 class desktop_capturer_differ_wrapper : public desktop_capturer,
                                         public desktop_capturer::capture_callback {
 public:
@@ -42,6 +53,34 @@ public:
 
   ~desktop_capturer_differ_wrapper() override;
 
+  // Sets the time budget of comparing one frame in microseconds, 0 (default)
+  // means unlimited. Once the budget of a frame is exhausted, the rest of its
+  // updated region hints are reported as updated without being compared. If
+  // several frames in a row exceed the budget, larger blocks are compared to
+  // cut the cost of building the updated region; the block size goes back
+  // once frames are compared well within the budget again.
+  void set_time_budget_us(int64_t budget_us);
+
+  // Simplifies the updated region of each frame to at most `max_rects`
+  // rectangles, covering at most (1 + `max_waste_ratio`) times the area which
+  // has actually been updated. See desktop_region::simplify(). 0 `max_rects`
+  // (default) disables the simplification.
+  void set_updated_region_limit(int max_rects, double max_waste_ratio);
+
+  // Width and height of the blocks currently compared, k_differ_block_size
+  // unless the time budget has been exceeded repeatedly.
+  int block_size() const { return block_size_; }
+
+  // Enables or disables change_heatmap(), disabled by default. The heatmap
+  // costs a pass over the blocks of every frame, and is empty while disabled.
+  void set_change_heatmap_enabled(bool enabled);
+
+  // How frequently each block of the frames changes, built from the updated
+  // regions of the compared frames. Its blocks are as large as the compared
+  // ones. It is cleared whenever the entire frame is marked as updated, e.g.
+  // when the frame size changes, and when the block size changes.
+  const block_change_heatmap &change_heatmap() const { return change_heatmap_; }
+
   // desktop_capturer interface.
   void start(desktop_capturer::capture_callback *callback) override;
   void
@@ -56,12 +95,35 @@ public:
   desktop_capture_metadata get_metadata() override;
 #endif // defined(TRAA_ENABLE_WAYLAND)
 private:
+  // Consecutive frames over the time budget before the block size is doubled.
+  static constexpr int k_max_over_budget_frames = 3;
+  // Consecutive frames within half of the time budget before the block size is
+  // halved.
+  static constexpr int k_min_in_budget_frames = 30;
+  // The largest block size is k_differ_block_size times this value.
+  static constexpr int k_max_block_size_multiplier = 4;
+
   // desktop_capturer::capture_callback interface.
   void on_capture_result(capture_result result, std::unique_ptr<desktop_frame> frame) override;
 
+  // Records whether the frame has been compared within the time budget, and
+  // adjusts `block_size_` accordingly.
+  void update_block_size(bool in_budget, int64_t elapsed_nanos);
+
   const std::unique_ptr<desktop_capturer> base_capturer_;
   desktop_capturer::capture_callback *callback_;
   std::unique_ptr<shared_desktop_frame> last_frame_;
+
+  int64_t time_budget_us_ = 0;
+  int block_size_ = k_differ_block_size;
+  int over_budget_frames_ = 0;
+  int in_budget_frames_ = 0;
+
+  int max_updated_rects_ = 0;
+  double max_updated_waste_ratio_ = 0;
+
+  bool change_heatmap_enabled_ = false;
+  block_change_heatmap change_heatmap_;
 };
 
 } // namespace base
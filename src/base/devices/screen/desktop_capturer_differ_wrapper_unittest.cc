@@ -16,12 +16,14 @@
 #include "base/devices/screen/test/fake_desktop_capturer.h"
 #include "base/devices/screen/test/mock_desktop_capturer_callback.h"
 #include "base/random.h"
+#include "base/system/metrics.h"
 #include "base/utils/time_utils.h"
 
 #include <gtest/gtest.h>
 
 #include <initializer_list>
 #include <memory>
+#include <string.h>
 #include <utility>
 #include <vector>
 
@@ -212,8 +214,221 @@ void execute_differ_wrapper_test(bool with_hints, bool enlarge_updated_region,
   }
 }
 
+// An implementation of desktop_frame_painter to paint the entire frame white,
+// and to report updated_region() as precomputed by the capturer.
+class precomputed_region_painter final : public desktop_frame_painter {
+public:
+  // The updated region which will be reported in next paint() call.
+  desktop_region *updated_region() { return &updated_region_; }
+
+  // desktop_frame_painter interface.
+  bool paint(desktop_frame *frame, desktop_region *updated_region) override {
+    memset(frame->data(), 0xff, frame->stride() * frame->size().height());
+    frame->set_updated_region_precomputed(true);
+    updated_region->swap(&updated_region_);
+    updated_region_.clear();
+    return true;
+  }
+
+private:
+  desktop_region updated_region_;
+};
+
+// A clock which advances by `step_nanos` on every read, so every check of the
+// time budget sees time passing. It replaces the global clock while alive.
+class stepping_clock : public clock_interface {
+public:
+  explicit stepping_clock(int64_t step_nanos) : step_nanos_(step_nanos) {
+    set_clock_for_testing(this);
+  }
+  ~stepping_clock() override { set_clock_for_testing(nullptr); }
+
+  int64_t time_nanos() const override { return now_nanos_ += step_nanos_; }
+
+private:
+  const int64_t step_nanos_;
+  mutable int64_t now_nanos_ = k_num_nanosecs_per_sec;
+};
+
 } // namespace
 
+TEST(desktop_capturer_differ_wrapper_test, capture_with_precomputed_region) {
+  precomputed_region_painter frame_painter;
+  painter_desktop_frame_generator frame_generator;
+  frame_generator.set_desktop_frame_painter(&frame_painter);
+  frame_generator.set_provide_updated_region_hints(true);
+  std::unique_ptr<fake_desktop_capturer> fake(new fake_desktop_capturer());
+  fake->set_frame_generator(&frame_generator);
+  desktop_capturer_differ_wrapper capturer(std::move(fake));
+  mock_desktop_capturer_callback callback;
+  capturer.start(&callback);
+
+  // The first frame is always entirely updated.
+  EXPECT_CALL(callback,
+              on_capture_result_ptr(desktop_capturer::capture_result::success, ::testing::_))
+      .WillOnce(::testing::Invoke(
+          [](desktop_capturer::capture_result result, std::unique_ptr<desktop_frame> *frame) {
+            assert_updated_region_is(**frame, {desktop_rect::make_size((*frame)->size())});
+          }));
+  capturer.capture_frame();
+
+  // The content does not change, but the precomputed region is forwarded
+  // without comparing the frames.
+  const desktop_rect rect = desktop_rect::make_ltrb(100, 100, 200, 200);
+  frame_painter.updated_region()->add_rect(rect);
+  EXPECT_CALL(callback,
+              on_capture_result_ptr(desktop_capturer::capture_result::success, ::testing::_))
+      .WillOnce(::testing::Invoke(
+          [&rect](desktop_capturer::capture_result result, std::unique_ptr<desktop_frame> *frame) {
+            assert_updated_region_is(**frame, {rect});
+          }));
+  capturer.capture_frame();
+}
+
+TEST(desktop_capturer_differ_wrapper_test, capture_with_updated_region_limit) {
+  precomputed_region_painter frame_painter;
+  painter_desktop_frame_generator frame_generator;
+  frame_generator.set_desktop_frame_painter(&frame_painter);
+  frame_generator.set_provide_updated_region_hints(true);
+  std::unique_ptr<fake_desktop_capturer> fake(new fake_desktop_capturer());
+  fake->set_frame_generator(&frame_generator);
+  desktop_capturer_differ_wrapper capturer(std::move(fake));
+  mock_desktop_capturer_callback callback;
+  capturer.set_updated_region_limit(4, 1);
+  capturer.start(&callback);
+  execute_capturer(&capturer, &callback);
+
+  // 20 rectangles in a row, 10 pixels apart.
+  desktop_region updated_region;
+  for (int i = 0; i < 20; i++) {
+    updated_region.add_rect(desktop_rect::make_xywh(i * 20, 0, 10, 10));
+  }
+  *frame_painter.updated_region() = updated_region;
+  EXPECT_CALL(callback,
+              on_capture_result_ptr(desktop_capturer::capture_result::success, ::testing::_))
+      .WillOnce(::testing::Invoke([&updated_region](desktop_capturer::capture_result result,
+                                                    std::unique_ptr<desktop_frame> *frame) {
+        int count = 0;
+        for (desktop_region::iterator it((*frame)->updated_region()); !it.is_at_end();
+             it.advance()) {
+          count++;
+        }
+        EXPECT_LE(count, 4);
+        desktop_region uncovered(updated_region);
+        uncovered.subtract((*frame)->updated_region());
+        EXPECT_TRUE(uncovered.is_empty());
+      }));
+  capturer.capture_frame();
+}
+
+TEST(desktop_capturer_differ_wrapper_test, capture_over_time_budget) {
+  black_white_desktop_frame_painter frame_painter;
+  painter_desktop_frame_generator frame_generator;
+  frame_generator.set_desktop_frame_painter(&frame_painter);
+  std::unique_ptr<fake_desktop_capturer> fake(new fake_desktop_capturer());
+  fake->set_frame_generator(&frame_generator);
+  desktop_capturer_differ_wrapper capturer(std::move(fake));
+  mock_desktop_capturer_callback callback;
+  // Every read of the clock takes 1 microsecond, so no frame is compared
+  // entirely within 1 microsecond.
+  stepping_clock clock(k_num_nanosecs_per_microsec);
+  capturer.set_time_budget_us(1);
+  capturer.set_change_heatmap_enabled(true);
+  capturer.start(&callback);
+  ASSERT_EQ(capturer.block_size(), k_differ_block_size);
+
+  const int over_budget_events =
+      metrics::num_events("WebRTC.DesktopCapture.DifferTimeBudgetExceeded", 1);
+  execute_capturer(&capturer, &callback);
+  const desktop_rect rect = desktop_rect::make_ltrb(100, 100, 200, 200);
+  for (int i = 0; i < 6; i++) {
+    // The updated region still covers the changes, since the area which has not
+    // been compared is reported as updated.
+    EXPECT_CALL(callback,
+                on_capture_result_ptr(desktop_capturer::capture_result::success, ::testing::_))
+        .WillOnce(::testing::Invoke([&rect](desktop_capturer::capture_result result,
+                                            std::unique_ptr<desktop_frame> *frame) {
+          desktop_region covered((*frame)->updated_region());
+          covered.intersect_with(rect);
+          ASSERT_TRUE(covered.equals(desktop_region(rect)));
+        }));
+    frame_painter.updated_region()->add_rect(rect);
+    capturer.capture_frame();
+  }
+  EXPECT_EQ(capturer.block_size(), k_differ_block_size * 4);
+  EXPECT_METRIC_EQ(metrics::num_events("WebRTC.DesktopCapture.DifferTimeBudgetExceeded", 1),
+                   over_budget_events + 6);
+
+  // The heatmap follows the blocks of the differ.
+  EXPECT_CALL(callback,
+              on_capture_result_ptr(desktop_capturer::capture_result::success, ::testing::_))
+      .Times(1);
+  frame_painter.updated_region()->add_rect(rect);
+  capturer.capture_frame();
+  EXPECT_EQ(capturer.change_heatmap().block_size(), k_differ_block_size * 4);
+}
+
+TEST(desktop_capturer_differ_wrapper_test, capture_over_time_budget_in_last_row) {
+  black_white_desktop_frame_painter frame_painter;
+  painter_desktop_frame_generator frame_generator;
+  frame_generator.set_desktop_frame_painter(&frame_painter);
+  frame_generator.set_provide_updated_region_hints(true);
+  std::unique_ptr<fake_desktop_capturer> fake(new fake_desktop_capturer());
+  fake->set_frame_generator(&frame_generator);
+  desktop_capturer_differ_wrapper capturer(std::move(fake));
+  mock_desktop_capturer_callback callback;
+  // The only block row starts within the budget, and ends after it.
+  stepping_clock clock(k_num_nanosecs_per_microsec);
+  capturer.set_time_budget_us(1);
+  capturer.start(&callback);
+
+  const int over_budget_events =
+      metrics::num_events("WebRTC.DesktopCapture.DifferTimeBudgetExceeded", 1);
+  execute_capturer(&capturer, &callback);
+  const desktop_rect rect = desktop_rect::make_xywh(100, 100, 16, 16);
+  EXPECT_CALL(callback,
+              on_capture_result_ptr(desktop_capturer::capture_result::success, ::testing::_))
+      .Times(3);
+  for (int i = 0; i < 3; i++) {
+    frame_painter.updated_region()->add_rect(rect);
+    capturer.capture_frame();
+  }
+  EXPECT_EQ(capturer.block_size(), k_differ_block_size * 2);
+  EXPECT_METRIC_EQ(metrics::num_events("WebRTC.DesktopCapture.DifferTimeBudgetExceeded", 1),
+                   over_budget_events + 3);
+}
+
+TEST(desktop_capturer_differ_wrapper_test, change_heatmap) {
+  black_white_desktop_frame_painter frame_painter;
+  painter_desktop_frame_generator frame_generator;
+  frame_generator.set_desktop_frame_painter(&frame_painter);
+  std::unique_ptr<fake_desktop_capturer> fake(new fake_desktop_capturer());
+  fake->set_frame_generator(&frame_generator);
+  desktop_capturer_differ_wrapper capturer(std::move(fake));
+  mock_desktop_capturer_callback callback;
+  capturer.start(&callback);
+
+  // The heatmap is not built until it is enabled.
+  execute_capturer(&capturer, &callback);
+  EXPECT_TRUE(capturer.change_heatmap().size().is_empty());
+
+  capturer.set_change_heatmap_enabled(true);
+  execute_capturer(&capturer, &callback);
+  EXPECT_TRUE(capturer.change_heatmap().size().equals(*frame_generator.size()));
+
+  // Painting the two rectangles alternately changes both of them in every
+  // frame.
+  for (int i = 0; i < 30; i++) {
+    frame_painter.updated_region()->add_rect(
+        i % 2 ? desktop_rect::make_xywh(0, 0, 10, 10) : desktop_rect::make_xywh(10, 0, 10, 10));
+    execute_capturer(&capturer, &callback);
+  }
+  EXPECT_EQ(capturer.change_heatmap().classify_block(0, 0),
+            block_change_heatmap::change_class::video);
+  EXPECT_EQ(capturer.change_heatmap().classify_block(1, 1),
+            block_change_heatmap::change_class::still);
+}
+
 TEST(desktop_capturer_differ_wrapper_test, capture_without_hints) {
   execute_differ_wrapper_test(false, false, false, true);
 }
@@ -10,9 +10,11 @@
 
 #include "desktop_frame.h"
 #include "desktop_capture_types.h"
+#include "differ_block.h"
 
 #include <libyuv.h>
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 
@@ -38,6 +40,52 @@ void desktop_frame::copy_pixels_from(const desktop_frame &src_frame, const deskt
   copy_pixels_from(src_frame.get_frame_data_at_pos(src_pos), src_frame.stride(), dest_rect);
 }
 
+void desktop_frame::copy_and_diff_pixels_from(const uint8_t *src_buffer, int src_stride,
+                                              const desktop_rect &dest_rect,
+                                              desktop_region *dirty_region) {
+  // Blocks are aligned to the frame, not to `dest_rect`, so the same block of
+  // the frame is always compared as a whole.
+  const int first_block_top = dest_rect.top() - dest_rect.top() % k_differ_block_size;
+  const int first_block_left = dest_rect.left() - dest_rect.left() % k_differ_block_size;
+
+  for (int block_top = first_block_top; block_top < dest_rect.bottom();
+       block_top += k_differ_block_size) {
+    const int top = std::max(block_top, dest_rect.top());
+    const int bottom = std::min(block_top + k_differ_block_size, dest_rect.bottom());
+
+    // The left edge of a continuous dirty area in current block-row.
+    int dirty_left = -1;
+    for (int block_left = first_block_left; block_left < dest_rect.right();
+         block_left += k_differ_block_size) {
+      const int left = std::max(block_left, dest_rect.left());
+      const int right = std::min(block_left + k_differ_block_size, dest_rect.right());
+      const uint8_t *src = src_buffer + (top - dest_rect.top()) * src_stride +
+                           (left - dest_rect.left()) * k_bytes_per_pixel;
+      if (copy_and_block_difference(src, src_stride,
+                                    get_frame_data_at_pos(desktop_vector(left, top)), stride(),
+                                    right - left, bottom - top)) {
+        if (dirty_left == -1) {
+          dirty_left = left;
+        }
+      } else if (dirty_left != -1) {
+        dirty_region->add_rect(desktop_rect::make_ltrb(dirty_left, top, left, bottom));
+        dirty_left = -1;
+      }
+    }
+    if (dirty_left != -1) {
+      dirty_region->add_rect(desktop_rect::make_ltrb(dirty_left, top, dest_rect.right(), bottom));
+    }
+  }
+}
+
+void desktop_frame::copy_and_diff_pixels_from(const desktop_frame &src_frame,
+                                              const desktop_vector &src_pos,
+                                              const desktop_rect &dest_rect,
+                                              desktop_region *dirty_region) {
+  copy_and_diff_pixels_from(src_frame.get_frame_data_at_pos(src_pos), src_frame.stride(),
+                            dest_rect, dirty_region);
+}
+
 bool desktop_frame::copy_intersecting_pixels_from(const desktop_frame &src_frame,
                                                   double horizontal_scale, double vertical_scale) {
   const desktop_vector &origin = top_left();
@@ -83,12 +83,33 @@ public:
   int64_t capture_time_ms() const { return capture_time_ms_; }
   void set_capture_time_ms(int64_t time_ms) { capture_time_ms_ = time_ms; }
 
+  // Indicates that updated_region() has already been computed by comparing the
+  // pixels with the previous frame, e.g. with copy_and_diff_pixels_from(), so
+  // desktop_capturer_differ_wrapper does not need to compare the frame again.
+  // The capturer is responsible for comparing against the content of the
+  // frame it delivered previously. The mark is not copied by
+  // copy_frame_info_from() or move_frame_info_from(), frames wrapping this one
+  // may edit updated_region().
+  bool is_updated_region_precomputed() const { return updated_region_precomputed_; }
+  void set_updated_region_precomputed(bool precomputed) {
+    updated_region_precomputed_ = precomputed;
+  }
+
   // Copies pixels from a buffer or another frame. `dest_rect` rect must lay
   // within bounds of this frame.
   void copy_pixels_from(const uint8_t *src_buffer, int src_stride, const desktop_rect &dest_rect);
   void copy_pixels_from(const desktop_frame &src_frame, const desktop_vector &src_pos,
                         const desktop_rect &dest_rect);
 
+  // Same as copy_pixels_from(), but also compares the copied pixels with the
+  // previous content of this frame in the same pass over memory, and adds the
+  // changed blocks to `dirty_region`. Blocks are k_differ_block_size squares
+  // aligned to the origin of this frame, clipped to `dest_rect`.
+  void copy_and_diff_pixels_from(const uint8_t *src_buffer, int src_stride,
+                                 const desktop_rect &dest_rect, desktop_region *dirty_region);
+  void copy_and_diff_pixels_from(const desktop_frame &src_frame, const desktop_vector &src_pos,
+                                 const desktop_rect &dest_rect, desktop_region *dirty_region);
+
   // Copies pixels from another frame, with the copied & overwritten regions
   // representing the intersection between the two frames. Returns true if
   // pixels were copied, or false if there's no intersection. The scale factors
@@ -156,6 +177,7 @@ private:
   desktop_vector top_left_;
   desktop_vector dpi_;
   bool may_contain_cursor_ = false;
+  bool updated_region_precomputed_ = false;
   int64_t capture_time_ms_;
   uint32_t capturer_id_;
   std::vector<uint8_t> icc_profile_;
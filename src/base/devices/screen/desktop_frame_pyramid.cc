@@ -0,0 +1,176 @@
+#include "base/devices/screen/desktop_frame_pyramid.h"
+
+#include "base/arch.h"
+#include "base/checks.h"
+#include "base/system/cpu_features_wrapper.h"
+
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+#include "base/devices/screen/desktop_frame_pyramid_sse2.h"
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+
+#include <algorithm>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+void downscale_row_2x2_c(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, int first,
+                         int dst_width) {
+  for (int x = first; x < dst_width; x++) {
+    const uint8_t *top = row0 + x * 8;
+    const uint8_t *bottom = row1 + x * 8;
+    for (int c = 0; c < desktop_frame::k_bytes_per_pixel; c++) {
+      const int sum = top[c] + top[c + 4] + bottom[c] + bottom[c + 4];
+      dst[x * 4 + c] = static_cast<uint8_t>((sum + 2) >> 2);
+    }
+  }
+}
+
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+bool have_sse2() {
+  static const bool have = get_cpu_info(CPU_FEATURE_X86_SSE2) != 0;
+  return have;
+}
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+
+void downscale_row_2x2(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, int dst_width) {
+  int first = 0;
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+  if (have_sse2()) {
+    first = downscale_row_2x2_sse2(row0, row1, dst, dst_width);
+  }
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+  downscale_row_2x2_c(row0, row1, dst, first, dst_width);
+}
+
+// Returns `rect` scaled down by 1 << `level`, rounding outwards.
+desktop_rect scale_rect_down(const desktop_rect &rect, int level) {
+  const int mask = (1 << level) - 1;
+  return desktop_rect::make_ltrb(rect.left() >> level, rect.top() >> level,
+                                 (rect.right() + mask) >> level, (rect.bottom() + mask) >> level);
+}
+
+} // namespace
+
+desktop_frame_pyramid::desktop_frame_pyramid() = default;
+
+desktop_frame_pyramid::~desktop_frame_pyramid() = default;
+
+void desktop_frame_pyramid::subscribe(int level) {
+  TRAA_DCHECK(level >= 1 && level <= k_max_level);
+  subscribers_[level - 1]++;
+}
+
+void desktop_frame_pyramid::unsubscribe(int level) {
+  TRAA_DCHECK(level >= 1 && level <= k_max_level);
+  TRAA_DCHECK_GT(subscribers_[level - 1], 0);
+  subscribers_[level - 1]--;
+}
+
+void desktop_frame_pyramid::update(const desktop_frame &frame) {
+  int depth = 0;
+  for (int i = 0; i < k_max_level; i++) {
+    if (subscribers_[i] > 0) {
+      depth = i + 1;
+    }
+  }
+
+  // Only levels which were produced for a frame of the same size can be
+  // updated incrementally.
+  const int valid_depth = frame.size().equals(size_) ? std::min(depth_, depth) : 0;
+  size_ = frame.size();
+  depth_ = depth;
+  for (int i = depth; i < k_max_level; i++) {
+    levels_[i].reset();
+  }
+
+  for (int i = 0; i < depth; i++) {
+    const desktop_size level_size(size_.width() >> (i + 1), size_.height() >> (i + 1));
+    if (level_size.is_empty()) {
+      levels_[i].reset();
+      continue;
+    }
+    if (!levels_[i] || !levels_[i]->size().equals(level_size)) {
+      levels_[i].reset(new basic_desktop_frame(level_size));
+    }
+    levels_[i]->mutable_updated_region()->clear();
+  }
+  if (depth == 0) {
+    return;
+  }
+
+  // Align the updated area to the blocks of the deepest level, so each rect
+  // produces whole pixels of all levels.
+  const desktop_rect frame_rect = desktop_rect::make_size(size_);
+  const int block_size = 1 << depth;
+  desktop_region region;
+  if (valid_depth < depth) {
+    region.set_rect(frame_rect);
+  } else {
+    for (desktop_region::iterator it(frame.updated_region()); !it.is_at_end(); it.advance()) {
+      desktop_rect rect = scale_rect_down(it.rect(), depth);
+      rect = desktop_rect::make_ltrb(rect.left() * block_size, rect.top() * block_size,
+                                     rect.right() * block_size, rect.bottom() * block_size);
+      rect.intersect_with(frame_rect);
+      region.add_rect(rect);
+    }
+  }
+
+  for (desktop_region::iterator it(region); !it.is_at_end(); it.advance()) {
+    downscale_rect(frame, it.rect(), depth);
+  }
+}
+
+void desktop_frame_pyramid::reset() {
+  depth_ = 0;
+  size_ = desktop_size();
+  for (std::unique_ptr<desktop_frame> &level : levels_) {
+    level.reset();
+  }
+}
+
+const desktop_frame *desktop_frame_pyramid::level(int level) const {
+  TRAA_DCHECK(level >= 1 && level <= k_max_level);
+  return levels_[level - 1].get();
+}
+
+void desktop_frame_pyramid::downscale_rect(const desktop_frame &frame, const desktop_rect &rect,
+                                           int depth) {
+  const int block_size = 1 << depth;
+  TRAA_DCHECK(rect.left() % block_size == 0 && rect.top() % block_size == 0);
+
+  for (int level = 1; level <= depth; level++) {
+    desktop_frame *dst = levels_[level - 1].get();
+    if (!dst) {
+      break;
+    }
+    desktop_rect dst_rect = scale_rect_down(rect, level);
+    dst_rect.intersect_with(desktop_rect::make_size(dst->size()));
+    dst->mutable_updated_region()->add_rect(dst_rect);
+  }
+
+  // Each band of rows produces a single row of the deepest level, and the
+  // rows of the other levels it depends on.
+  for (int band_top = rect.top(); band_top < rect.bottom(); band_top += block_size) {
+    for (int level = 1; level <= depth; level++) {
+      const desktop_frame *src = level == 1 ? &frame : levels_[level - 2].get();
+      desktop_frame *dst = levels_[level - 1].get();
+      if (!dst) {
+        break;
+      }
+      const int top = band_top >> level;
+      const int bottom = std::min((band_top + block_size) >> level, dst->size().height());
+      const int left = rect.left() >> level;
+      const int right = std::min(rect.right() >> level, dst->size().width());
+      for (int y = top; y < bottom; y++) {
+        downscale_row_2x2(src->get_frame_data_at_pos(desktop_vector(left * 2, y * 2)),
+                          src->get_frame_data_at_pos(desktop_vector(left * 2, y * 2 + 1)),
+                          dst->get_frame_data_at_pos(desktop_vector(left, y)), right - left);
+      }
+    }
+  }
+}
+
+} // namespace base
+} // namespace traa
@@ -0,0 +1,72 @@
+#ifndef TRAA_BASE_DEVICES_SCREEN_DESKTOP_FRAME_PYRAMID_H_
+#define TRAA_BASE_DEVICES_SCREEN_DESKTOP_FRAME_PYRAMID_H_
+
+#include "base/devices/screen/desktop_frame.h"
+#include "base/devices/screen/desktop_geometry.h"
+#include "base/devices/screen/desktop_region.h"
+
+#include <memory>
+
+namespace traa {
+namespace base {
+
+// Derives the 1/2, 1/4 and 1/8 scaled levels of the desktop_frames of a single
+// source, so consumers of different resolutions, e.g. a preview and a picker
+// thumbnail, share the scaling work. Level n is the 2x2 box filtered
+// downscale of level n - 1, and level 0 is the captured frame itself. Odd
+// rightmost columns and bottom rows are dropped at each level.
+//
+// Consumers subscribe to the levels they need, and update() only produces the
+// levels up to the deepest subscribed one. Levels are updated incrementally
+// from the updated_region() of each frame, in bands of rows, so the rows of a
+// level are still in the cache when the next level reads them.
+//
+// The levels only stay in sync with the source if update() is called with
+// every frame the source captures, since updated_region() is relative to the
+// previous frame. Call reset() after skipping a frame.
+class desktop_frame_pyramid final {
+public:
+  // The deepest level, i.e. 1/8 of the frame size.
+  static constexpr int k_max_level = 3;
+
+  desktop_frame_pyramid();
+  ~desktop_frame_pyramid();
+
+  desktop_frame_pyramid(const desktop_frame_pyramid &) = delete;
+  desktop_frame_pyramid &operator=(const desktop_frame_pyramid &) = delete;
+
+  // Adds or removes a consumer of `level`, within [1, k_max_level]. Each
+  // subscribe() call must be balanced by an unsubscribe() call.
+  void subscribe(int level);
+  void unsubscribe(int level);
+
+  // Updates the subscribed levels from `frame`. The updated_region() of each
+  // level frame holds the area updated in this call. Levels are produced
+  // entirely on the first frame after construction or reset(), after a size
+  // change, and when they are subscribed.
+  void update(const desktop_frame &frame);
+
+  // Drops all levels, so the next frame is downscaled entirely.
+  void reset();
+
+  // Returns the frame of `level`, within [1, k_max_level], or nullptr if the
+  // level is not produced, or is empty because the frame is too small.
+  const desktop_frame *level(int level) const;
+
+private:
+  // Downscales `rect` of `frame`, in frame coordinates, into levels
+  // [1, `depth`]. Its left and top edges must be multiples of 1 << `depth`.
+  void downscale_rect(const desktop_frame &frame, const desktop_rect &rect, int depth);
+
+  int subscribers_[k_max_level] = {};
+  // The levels produced by the previous update() call.
+  int depth_ = 0;
+  // The size of the previous frame.
+  desktop_size size_;
+  std::unique_ptr<desktop_frame> levels_[k_max_level];
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_DESKTOP_FRAME_PYRAMID_H_
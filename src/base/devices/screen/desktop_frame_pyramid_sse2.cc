@@ -0,0 +1,50 @@
+#include "base/devices/screen/desktop_frame_pyramid_sse2.h"
+
+#if defined(TRAA_ARCH_X86_FAMILY)
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <emmintrin.h>
+#endif
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// Returns the sums of the channels of the 2x2 blocks formed by pixels 0-3 of
+// `top` and `bottom`, as 16-bit values of 2 pixels.
+__m128i sum_blocks(__m128i top, __m128i bottom) {
+  const __m128i zero = _mm_setzero_si128();
+  // Pixels 0 and 1, and pixels 2 and 3, summed vertically.
+  const __m128i sum01 =
+      _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+  const __m128i sum23 =
+      _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+  // Pixels 0 + 1 and 2 + 3.
+  return _mm_add_epi16(_mm_unpacklo_epi64(sum01, sum23), _mm_unpackhi_epi64(sum01, sum23));
+}
+
+} // namespace
+
+extern int downscale_row_2x2_sse2(const uint8_t *row0, const uint8_t *row1, uint8_t *dst,
+                                  int dst_width) {
+  const __m128i rounding = _mm_set1_epi16(2);
+  int x = 0;
+  for (; x + 4 <= dst_width; x += 4) {
+    const __m128i *top = reinterpret_cast<const __m128i *>(row0 + x * 8);
+    const __m128i *bottom = reinterpret_cast<const __m128i *>(row1 + x * 8);
+    const __m128i sum0 = sum_blocks(_mm_loadu_si128(top), _mm_loadu_si128(bottom));
+    const __m128i sum1 = sum_blocks(_mm_loadu_si128(top + 1), _mm_loadu_si128(bottom + 1));
+    const __m128i avg0 = _mm_srli_epi16(_mm_add_epi16(sum0, rounding), 2);
+    const __m128i avg1 = _mm_srli_epi16(_mm_add_epi16(sum1, rounding), 2);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm_packus_epi16(avg0, avg1));
+  }
+  return x;
+}
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_ARCH_X86_FAMILY
@@ -0,0 +1,26 @@
+// This header file is used only by desktop_frame_pyramid.cc. It defines the
+// SSE2 routine for downscaling rows of pixels by half.
+
+#ifndef TRAA_BASE_DEVICES_SCREEN_DESKTOP_FRAME_PYRAMID_SSE2_H_
+#define TRAA_BASE_DEVICES_SCREEN_DESKTOP_FRAME_PYRAMID_SSE2_H_
+
+#include "base/arch.h"
+
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+#include <stdint.h>
+
+namespace traa {
+namespace base {
+
+// Averages each 2x2 block of pixels of the rows `row0` and `row1` into a pixel
+// of `dst`, for as many of the `dst_width` pixels as fit into whole SSE2
+// registers, and returns their number. The caller downscales the rest.
+extern int downscale_row_2x2_sse2(const uint8_t *row0, const uint8_t *row1, uint8_t *dst,
+                                  int dst_width);
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+
+#endif // TRAA_BASE_DEVICES_SCREEN_DESKTOP_FRAME_PYRAMID_SSE2_H_
@@ -0,0 +1,163 @@
+#include "base/devices/screen/desktop_frame_pyramid.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+
+#include <gtest/gtest.h>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+void fill_random(desktop_frame *frame, const desktop_rect &rect) {
+  for (int y = rect.top(); y < rect.bottom(); y++) {
+    uint8_t *row = frame->get_frame_data_at_pos(desktop_vector(rect.left(), y));
+    for (int i = 0; i < rect.width() * desktop_frame::k_bytes_per_pixel; i++) {
+      row[i] = static_cast<uint8_t>(rand());
+    }
+  }
+}
+
+// Returns `frame` downscaled by half with a 2x2 box filter.
+std::unique_ptr<desktop_frame> downscale(const desktop_frame &frame) {
+  std::unique_ptr<desktop_frame> result(new basic_desktop_frame(
+      desktop_size(frame.size().width() / 2, frame.size().height() / 2)));
+  for (int y = 0; y < result->size().height(); y++) {
+    for (int x = 0; x < result->size().width(); x++) {
+      const uint8_t *top = frame.get_frame_data_at_pos(desktop_vector(x * 2, y * 2));
+      const uint8_t *bottom = frame.get_frame_data_at_pos(desktop_vector(x * 2, y * 2 + 1));
+      uint8_t *dst = result->get_frame_data_at_pos(desktop_vector(x, y));
+      for (int c = 0; c < desktop_frame::k_bytes_per_pixel; c++) {
+        dst[c] = static_cast<uint8_t>((top[c] + top[c + 4] + bottom[c] + bottom[c + 4] + 2) / 4);
+      }
+    }
+  }
+  return result;
+}
+
+// Verifies levels [1, `depth`] of `pyramid` match the downscales of `frame`.
+void expect_levels_equal(const desktop_frame &frame, const desktop_frame_pyramid &pyramid,
+                         int depth) {
+  std::unique_ptr<desktop_frame> expected = downscale(frame);
+  for (int level = 1; level <= depth; level++) {
+    const desktop_frame *actual = pyramid.level(level);
+    ASSERT_TRUE(actual) << "level " << level;
+    ASSERT_TRUE(actual->size().equals(expected->size())) << "level " << level;
+    for (int y = 0; y < expected->size().height(); y++) {
+      ASSERT_EQ(memcmp(expected->get_frame_data_at_pos(desktop_vector(0, y)),
+                       actual->get_frame_data_at_pos(desktop_vector(0, y)),
+                       expected->size().width() * desktop_frame::k_bytes_per_pixel),
+                0)
+          << "level " << level << ", row " << y;
+    }
+    expected = downscale(*expected);
+  }
+}
+
+} // namespace
+
+TEST(desktop_frame_pyramid_test, produces_subscribed_levels) {
+  basic_desktop_frame frame(desktop_size(67, 45));
+  fill_random(&frame, desktop_rect::make_size(frame.size()));
+  desktop_frame_pyramid pyramid;
+
+  pyramid.update(frame);
+  EXPECT_FALSE(pyramid.level(1));
+
+  pyramid.subscribe(2);
+  pyramid.update(frame);
+  expect_levels_equal(frame, pyramid, 2);
+  EXPECT_FALSE(pyramid.level(3));
+  EXPECT_TRUE(pyramid.level(2)->updated_region().equals(
+      desktop_region(desktop_rect::make_size(pyramid.level(2)->size()))));
+
+  // A newly subscribed level is produced entirely.
+  pyramid.subscribe(3);
+  frame.mutable_updated_region()->clear();
+  pyramid.update(frame);
+  expect_levels_equal(frame, pyramid, 3);
+
+  pyramid.unsubscribe(3);
+  pyramid.update(frame);
+  EXPECT_TRUE(pyramid.level(2));
+  EXPECT_FALSE(pyramid.level(3));
+  pyramid.unsubscribe(2);
+}
+
+TEST(desktop_frame_pyramid_test, updates_levels_incrementally) {
+  for (const desktop_size &size : {desktop_size(128, 96), desktop_size(101, 77)}) {
+    basic_desktop_frame frame(size);
+    fill_random(&frame, desktop_rect::make_size(size));
+    desktop_frame_pyramid pyramid;
+    pyramid.subscribe(desktop_frame_pyramid::k_max_level);
+    pyramid.update(frame);
+    expect_levels_equal(frame, pyramid, desktop_frame_pyramid::k_max_level);
+
+    for (int i = 0; i < 20; i++) {
+      frame.mutable_updated_region()->clear();
+      for (int j = 0; j < 3; j++) {
+        const int left = rand() % size.width();
+        const int top = rand() % size.height();
+        const desktop_rect rect =
+            desktop_rect::make_xywh(left, top, 1 + rand() % (size.width() - left) / 4,
+                                    1 + rand() % (size.height() - top) / 4);
+        fill_random(&frame, rect);
+        frame.mutable_updated_region()->add_rect(rect);
+      }
+      pyramid.update(frame);
+      expect_levels_equal(frame, pyramid, desktop_frame_pyramid::k_max_level);
+    }
+  }
+}
+
+TEST(desktop_frame_pyramid_test, updated_region_of_levels) {
+  basic_desktop_frame frame(desktop_size(64, 64));
+  fill_random(&frame, desktop_rect::make_size(frame.size()));
+  desktop_frame_pyramid pyramid;
+  pyramid.subscribe(3);
+  pyramid.update(frame);
+
+  frame.mutable_updated_region()->set_rect(desktop_rect::make_xywh(9, 17, 1, 1));
+  pyramid.update(frame);
+  // The pixel lies in the 8x8 block at (8, 16), which is updated in all
+  // levels.
+  EXPECT_TRUE(pyramid.level(1)->updated_region().equals(
+      desktop_region(desktop_rect::make_xywh(4, 8, 4, 4))));
+  EXPECT_TRUE(pyramid.level(2)->updated_region().equals(
+      desktop_region(desktop_rect::make_xywh(2, 4, 2, 2))));
+  EXPECT_TRUE(pyramid.level(3)->updated_region().equals(
+      desktop_region(desktop_rect::make_xywh(1, 2, 1, 1))));
+
+  frame.mutable_updated_region()->clear();
+  pyramid.update(frame);
+  EXPECT_TRUE(pyramid.level(1)->updated_region().is_empty());
+  pyramid.unsubscribe(3);
+}
+
+TEST(desktop_frame_pyramid_test, small_and_resized_frames) {
+  desktop_frame_pyramid pyramid;
+  pyramid.subscribe(3);
+
+  basic_desktop_frame small_frame(desktop_size(5, 5));
+  fill_random(&small_frame, desktop_rect::make_size(small_frame.size()));
+  pyramid.update(small_frame);
+  expect_levels_equal(small_frame, pyramid, 2);
+  EXPECT_FALSE(pyramid.level(3));
+
+  basic_desktop_frame frame(desktop_size(40, 24));
+  fill_random(&frame, desktop_rect::make_size(frame.size()));
+  pyramid.update(frame);
+  expect_levels_equal(frame, pyramid, 3);
+
+  pyramid.reset();
+  fill_random(&frame, desktop_rect::make_size(frame.size()));
+  pyramid.update(frame);
+  expect_levels_equal(frame, pyramid, 3);
+  pyramid.unsubscribe(3);
+}
+
+} // namespace base
+} // namespace traa
@@ -10,6 +10,8 @@
 
 #include "base/devices/screen/desktop_frame_rotation.h"
 
+#include "base/devices/screen/desktop_region.h"
+
 #include <libyuv/rotate_argb.h>
 
 namespace traa {
@@ -100,5 +102,41 @@ void rotate_desktop_frame(const desktop_frame &source, const desktop_rect &sourc
                      source_rect.width(), source_rect.height(), to_libyuv_rotation_mode(rot));
 }
 
+desktop_frame_rotator::desktop_frame_rotator() = default;
+
+desktop_frame_rotator::~desktop_frame_rotator() = default;
+
+const desktop_frame *desktop_frame_rotator::rotate(const desktop_frame &frame, rotation rot) {
+  const bool rotate_all =
+      !rotated_frame_ || rot != rotation_ || !frame.size().equals(source_size_);
+  if (rotate_all) {
+    const desktop_size rotated_size = rotate_size(frame.size(), rot);
+    if (!rotated_frame_ || !rotated_frame_->size().equals(rotated_size)) {
+      rotated_frame_.reset(new basic_desktop_frame(rotated_size));
+    }
+    rotation_ = rot;
+    source_size_ = frame.size();
+  }
+
+  const desktop_region full_region(desktop_rect::make_size(source_size_));
+  const desktop_region &source_region = rotate_all ? full_region : frame.updated_region();
+  desktop_region rotated_region;
+  for (desktop_region::iterator it(source_region); !it.is_at_end(); it.advance()) {
+    desktop_rect rect = it.rect();
+    rect.intersect_with(desktop_rect::make_size(source_size_));
+    rotate_desktop_frame(frame, rect, rotation_, desktop_vector(), rotated_frame_.get());
+    rotated_region.add_rect(rotate_rect(rect, source_size_, rotation_));
+  }
+
+  rotated_frame_->copy_frame_info_from(frame);
+  rotated_frame_->mutable_updated_region()->swap(&rotated_region);
+  return rotated_frame_.get();
+}
+
+void desktop_frame_rotator::reset() {
+  source_size_ = desktop_size();
+  rotated_frame_.reset();
+}
+
 } // namespace base
 } // namespace traa
@@ -14,6 +14,8 @@
 #include "base/devices/screen/desktop_frame.h"
 #include "base/devices/screen/desktop_geometry.h"
 
+#include <memory>
+
 namespace traa {
 namespace base {
 
@@ -46,6 +48,41 @@ desktop_size rotate_size(desktop_size size, rotation rot);
 // the desktop_frame which `rect` belongs in.
 desktop_rect rotate_rect(desktop_rect rect, desktop_size size, rotation rot);
 
+// Rotates the desktop_frames of a single source into a persistent frame, and
+// only rotates the updated_region() of each frame, so rotated sources, e.g.
+// portrait monitors, cost about as much as unrotated ones.
+//
+// The rotated frame only stays in sync with the source if rotate() is called
+// with every frame the source captures, since updated_region() is relative to
+// the previous frame. Call reset() after skipping a frame.
+class desktop_frame_rotator final {
+public:
+  desktop_frame_rotator();
+  ~desktop_frame_rotator();
+
+  desktop_frame_rotator(const desktop_frame_rotator &) = delete;
+  desktop_frame_rotator &operator=(const desktop_frame_rotator &) = delete;
+
+  // Rotates the updated area of `frame` by `rot`, and returns the rotated
+  // frame. Its updated_region() is the rotated area, and the other frame
+  // information is copied from `frame`. The whole frame is rotated if it is
+  // the first frame after construction or reset(), or if its size or `rot`
+  // differs from the previous frame.
+  const desktop_frame *rotate(const desktop_frame &frame, rotation rot);
+
+  // Forgets the previous frame, so the next frame is rotated entirely.
+  void reset();
+
+  // The rotated frame, or nullptr before the first rotate() call.
+  const desktop_frame *rotated_frame() const { return rotated_frame_.get(); }
+
+private:
+  rotation rotation_ = rotation::r_0;
+  // The size of the previous source frame.
+  desktop_size source_size_;
+  std::unique_ptr<desktop_frame> rotated_frame_;
+};
+
 } // namespace base
 } // namespace traa
 
@@ -17,6 +17,7 @@
 #include <gtest/gtest.h>
 
 #include <stdint.h>
+#include <stdlib.h>
 
 namespace traa {
 namespace base {
@@ -36,6 +37,23 @@ array_desktop_frame::array_desktop_frame(desktop_size size, uint32_t *data)
 
 array_desktop_frame::~array_desktop_frame() = default;
 
+void fill_random(desktop_frame *frame, const desktop_rect &rect) {
+  for (int y = rect.top(); y < rect.bottom(); y++) {
+    uint8_t *row = frame->get_frame_data_at_pos(desktop_vector(rect.left(), y));
+    for (int i = 0; i < rect.width() * desktop_frame::k_bytes_per_pixel; i++) {
+      row[i] = static_cast<uint8_t>(rand());
+    }
+  }
+}
+
+// Verifies `rotated` is `frame` entirely rotated by `rot`.
+void expect_rotated_equal(const desktop_frame &frame, rotation rot, const desktop_frame &rotated) {
+  basic_desktop_frame expected(rotate_size(frame.size(), rot));
+  rotate_desktop_frame(frame, desktop_rect::make_size(frame.size()), rot, desktop_vector(),
+                       &expected);
+  ASSERT_TRUE(desktop_frame_data_equals(expected, rotated));
+}
+
 } // namespace
 
 TEST(desktop_frame_rotation_unittest, copy_rect_3x4) {
@@ -405,6 +423,67 @@ TEST(desktop_frame_rotation_unittest, with_offset) {
   }
 }
 
+TEST(desktop_frame_rotation_unittest, rotator_rotates_updated_region) {
+  for (rotation rot : {rotation::r_0, rotation::r_90, rotation::r_180, rotation::r_270}) {
+    basic_desktop_frame frame(desktop_size(37, 23));
+    fill_random(&frame, desktop_rect::make_size(frame.size()));
+    desktop_frame_rotator rotator;
+    const desktop_frame *rotated = rotator.rotate(frame, rot);
+    ASSERT_TRUE(rotated);
+    EXPECT_TRUE(rotated->updated_region().equals(
+        desktop_region(desktop_rect::make_size(rotate_size(frame.size(), rot)))));
+    expect_rotated_equal(frame, rot, *rotated);
+
+    for (int i = 0; i < 10; i++) {
+      const int left = rand() % frame.size().width();
+      const int top = rand() % frame.size().height();
+      const desktop_rect rect =
+          desktop_rect::make_xywh(left, top, 1 + rand() % (frame.size().width() - left),
+                                  1 + rand() % (frame.size().height() - top));
+      fill_random(&frame, rect);
+      frame.mutable_updated_region()->set_rect(rect);
+      ASSERT_EQ(rotator.rotate(frame, rot), rotated);
+      EXPECT_TRUE(rotated->updated_region().equals(
+          desktop_region(rotate_rect(rect, frame.size(), rot))));
+      expect_rotated_equal(frame, rot, *rotated);
+    }
+  }
+}
+
+TEST(desktop_frame_rotation_unittest, rotator_rotates_whole_frame_on_changes) {
+  basic_desktop_frame frame(desktop_size(16, 8));
+  fill_random(&frame, desktop_rect::make_size(frame.size()));
+  frame.set_capture_time_ms(42);
+  desktop_frame_rotator rotator;
+  rotator.rotate(frame, rotation::r_90);
+
+  // A new rotation rotates the whole frame, even if nothing is updated.
+  frame.mutable_updated_region()->clear();
+  const desktop_frame *rotated = rotator.rotate(frame, rotation::r_180);
+  ASSERT_TRUE(rotated);
+  EXPECT_TRUE(rotated->size().equals(frame.size()));
+  EXPECT_TRUE(rotated->updated_region().equals(
+      desktop_region(desktop_rect::make_size(frame.size()))));
+  EXPECT_EQ(rotated->capture_time_ms(), 42);
+  expect_rotated_equal(frame, rotation::r_180, *rotated);
+
+  rotated = rotator.rotate(frame, rotation::r_180);
+  EXPECT_TRUE(rotated->updated_region().is_empty());
+
+  basic_desktop_frame larger_frame(desktop_size(24, 8));
+  fill_random(&larger_frame, desktop_rect::make_size(larger_frame.size()));
+  rotated = rotator.rotate(larger_frame, rotation::r_270);
+  EXPECT_TRUE(rotated->size().equals(desktop_size(8, 24)));
+  expect_rotated_equal(larger_frame, rotation::r_270, *rotated);
+
+  rotator.reset();
+  EXPECT_FALSE(rotator.rotated_frame());
+  fill_random(&larger_frame, desktop_rect::make_size(larger_frame.size()));
+  larger_frame.mutable_updated_region()->clear();
+  rotated = rotator.rotate(larger_frame, rotation::r_270);
+  expect_rotated_equal(larger_frame, rotation::r_270, *rotated);
+}
+
 // On a typical machine (Intel(R) Xeon(R) E5-1650 v3 @ 3.50GHz, with O2
 // optimization, the following case uses ~1.4s to finish. It means entirely
 // rotating one 2048 x 1536 frame, which is a large enough number to cover most
@@ -0,0 +1,106 @@
+#include "base/devices/screen/desktop_frame_scaler.h"
+
+#include "base/devices/screen/desktop_region.h"
+
+#include <libyuv/scale_argb.h>
+
+#include <stdint.h>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// Source pixels around each updated pixel which contribute to the scaled
+// pixels, i.e. the footprint of the bilinear filter libyuv uses when
+// upscaling.
+constexpr int k_source_padding = 1;
+
+// Scaled pixels around the mapped area which may be affected by the rounding
+// of libyuv's fixed point positions.
+constexpr int k_target_padding = 1;
+
+// libyuv scales the last few pixels of each row, which do not fill a SIMD
+// register, with C code that rounds differently. Scaled rects start and end
+// at multiples of this width, so their rows split into SIMD and C pixels the
+// same way as in a full scale.
+constexpr int k_target_alignment = 16;
+
+int scale_down(int value, int from, int to) {
+  return static_cast<int>(static_cast<int64_t>(value) * to / from);
+}
+
+int scale_up(int value, int from, int to) {
+  return static_cast<int>((static_cast<int64_t>(value) * to + from - 1) / from);
+}
+
+} // namespace
+
+desktop_frame_scaler::desktop_frame_scaler(const desktop_size &target_size)
+    : target_size_(target_size) {}
+
+desktop_frame_scaler::~desktop_frame_scaler() = default;
+
+const desktop_frame *desktop_frame_scaler::scale(const desktop_frame &frame) {
+  if (frame.size().is_empty() || target_size_.is_empty()) {
+    return nullptr;
+  }
+
+  desktop_region *scaled_region;
+  if (!scaled_frame_ || !frame.size().equals(source_size_)) {
+    source_size_ = frame.size();
+    if (!scaled_frame_) {
+      scaled_frame_.reset(new basic_desktop_frame(target_size_));
+    }
+    scaled_region = scaled_frame_->mutable_updated_region();
+    scaled_region->set_rect(desktop_rect::make_size(target_size_));
+  } else {
+    scaled_region = scaled_frame_->mutable_updated_region();
+    scaled_region->clear();
+    for (desktop_region::iterator it(frame.updated_region()); !it.is_at_end(); it.advance()) {
+      scaled_region->add_rect(map_to_target(it.rect(), source_size_));
+    }
+  }
+
+  for (desktop_region::iterator it(*scaled_region); !it.is_at_end(); it.advance()) {
+    const desktop_rect &rect = it.rect();
+    libyuv::ARGBScaleClip(frame.data(), frame.stride(), source_size_.width(),
+                          source_size_.height(), scaled_frame_->data(), scaled_frame_->stride(),
+                          target_size_.width(), target_size_.height(), rect.left(), rect.top(),
+                          rect.width(), rect.height(), libyuv::kFilterBox);
+  }
+  return scaled_frame_.get();
+}
+
+void desktop_frame_scaler::reset() {
+  source_size_ = desktop_size();
+  scaled_frame_.reset();
+}
+
+void desktop_frame_scaler::set_target_size(const desktop_size &target_size) {
+  target_size_ = target_size;
+  reset();
+}
+
+desktop_rect desktop_frame_scaler::map_to_target(const desktop_rect &rect,
+                                                 const desktop_size &source_size) const {
+  desktop_rect source_rect = rect;
+  source_rect.extend(k_source_padding, k_source_padding, k_source_padding, k_source_padding);
+  source_rect.intersect_with(desktop_rect::make_size(source_size));
+
+  desktop_rect target_rect = desktop_rect::make_ltrb(
+      scale_down(source_rect.left(), source_size.width(), target_size_.width()),
+      scale_down(source_rect.top(), source_size.height(), target_size_.height()),
+      scale_up(source_rect.right(), source_size.width(), target_size_.width()),
+      scale_up(source_rect.bottom(), source_size.height(), target_size_.height()));
+  target_rect.extend(k_target_padding, k_target_padding, k_target_padding, k_target_padding);
+  target_rect = desktop_rect::make_ltrb(
+      target_rect.left() / k_target_alignment * k_target_alignment, target_rect.top(),
+      (target_rect.right() + k_target_alignment - 1) / k_target_alignment * k_target_alignment,
+      target_rect.bottom());
+  target_rect.intersect_with(desktop_rect::make_size(target_size_));
+  return target_rect;
+}
+
+} // namespace base
+} // namespace traa
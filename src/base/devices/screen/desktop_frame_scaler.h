@@ -0,0 +1,60 @@
+#ifndef TRAA_BASE_DEVICES_SCREEN_DESKTOP_FRAME_SCALER_H_
+#define TRAA_BASE_DEVICES_SCREEN_DESKTOP_FRAME_SCALER_H_
+
+#include "base/devices/screen/desktop_frame.h"
+#include "base/devices/screen/desktop_geometry.h"
+
+#include <memory>
+
+namespace traa {
+namespace base {
+
+// Scales the desktop_frames of a single source into a persistent frame of a
+// fixed size, e.g. a live thumbnail. Only the area of the scaled frame which
+// depends on the updated_region() of each source frame is scaled again, so
+// refreshing a thumbnail of a mostly still source is cheap.
+//
+// The scaled frame only stays in sync with the source if scale() is called
+// with every frame the source captures, since updated_region() is relative to
+// the previous frame. Call reset() after skipping a frame.
+class desktop_frame_scaler final {
+public:
+  explicit desktop_frame_scaler(const desktop_size &target_size);
+  ~desktop_frame_scaler();
+
+  desktop_frame_scaler(const desktop_frame_scaler &) = delete;
+  desktop_frame_scaler &operator=(const desktop_frame_scaler &) = delete;
+
+  // Scales the updated area of `frame`, and returns the scaled frame, whose
+  // updated_region() holds the area scaled in this call. The whole frame is
+  // scaled if it is the first frame after construction or reset(), or if its
+  // size differs from the previous frame. Returns nullptr if `frame` or the
+  // target size is empty.
+  const desktop_frame *scale(const desktop_frame &frame);
+
+  // Forgets the previous frame, so the next frame is scaled entirely.
+  void reset();
+
+  // Changes the size of the scaled frame, which also resets the scaler.
+  void set_target_size(const desktop_size &target_size);
+
+  const desktop_size &target_size() const { return target_size_; }
+
+  // The scaled frame, or nullptr before the first scale() call.
+  const desktop_frame *scaled_frame() const { return scaled_frame_.get(); }
+
+private:
+  // Returns the area of the scaled frame which depends on `rect` of a source
+  // frame of `source_size`.
+  desktop_rect map_to_target(const desktop_rect &rect, const desktop_size &source_size) const;
+
+  desktop_size target_size_;
+  // The size of the previous source frame.
+  desktop_size source_size_;
+  std::unique_ptr<desktop_frame> scaled_frame_;
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_DESKTOP_FRAME_SCALER_H_
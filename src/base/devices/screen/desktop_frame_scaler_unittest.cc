@@ -0,0 +1,120 @@
+#include "base/devices/screen/desktop_frame_scaler.h"
+
+#include "base/devices/screen/desktop_region.h"
+
+#include <libyuv/scale_argb.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <gtest/gtest.h>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+void fill_random(desktop_frame *frame, const desktop_rect &rect) {
+  for (int y = rect.top(); y < rect.bottom(); y++) {
+    uint8_t *row = frame->get_frame_data_at_pos(desktop_vector(rect.left(), y));
+    for (int i = 0; i < rect.width() * desktop_frame::k_bytes_per_pixel; i++) {
+      row[i] = static_cast<uint8_t>(rand());
+    }
+  }
+}
+
+// Scales the whole `frame` with libyuv, and compares the result with
+// `scaled_frame`.
+void expect_scaled_equal(const desktop_frame &frame, const desktop_frame &scaled_frame) {
+  basic_desktop_frame expected(scaled_frame.size());
+  libyuv::ARGBScale(frame.data(), frame.stride(), frame.size().width(), frame.size().height(),
+                    expected.data(), expected.stride(), expected.size().width(),
+                    expected.size().height(), libyuv::kFilterBox);
+  for (int y = 0; y < expected.size().height(); y++) {
+    ASSERT_EQ(memcmp(expected.get_frame_data_at_pos(desktop_vector(0, y)),
+                     scaled_frame.get_frame_data_at_pos(desktop_vector(0, y)),
+                     expected.size().width() * desktop_frame::k_bytes_per_pixel),
+              0)
+        << "row " << y;
+  }
+}
+
+// Changes small random rectangles of a frame of `source_size` over several
+// frames, and verifies the incrementally scaled frame matches a full scale.
+void test_incremental_scale(const desktop_size &source_size, const desktop_size &target_size) {
+  basic_desktop_frame frame(source_size);
+  fill_random(&frame, desktop_rect::make_size(source_size));
+  desktop_frame_scaler scaler(target_size);
+  const desktop_frame *scaled_frame = scaler.scale(frame);
+  ASSERT_TRUE(scaled_frame);
+  EXPECT_TRUE(scaled_frame->updated_region().equals(
+      desktop_region(desktop_rect::make_size(target_size))));
+  expect_scaled_equal(frame, *scaled_frame);
+
+  for (int i = 0; i < 20; i++) {
+    frame.mutable_updated_region()->clear();
+    for (int j = 0; j < 3; j++) {
+      const int left = rand() % source_size.width();
+      const int top = rand() % source_size.height();
+      const desktop_rect rect =
+          desktop_rect::make_xywh(left, top, 1 + rand() % (source_size.width() - left),
+                                  1 + rand() % (source_size.height() - top));
+      fill_random(&frame, rect);
+      frame.mutable_updated_region()->add_rect(rect);
+    }
+    ASSERT_EQ(scaler.scale(frame), scaled_frame);
+    expect_scaled_equal(frame, *scaled_frame);
+  }
+}
+
+} // namespace
+
+TEST(desktop_frame_scaler_test, downscale_incrementally) {
+  test_incremental_scale(desktop_size(640, 480), desktop_size(160, 120));
+  test_incremental_scale(desktop_size(333, 217), desktop_size(100, 61));
+}
+
+TEST(desktop_frame_scaler_test, upscale_incrementally) {
+  test_incremental_scale(desktop_size(100, 61), desktop_size(333, 217));
+}
+
+TEST(desktop_frame_scaler_test, scales_only_dependent_area) {
+  basic_desktop_frame frame(desktop_size(400, 400));
+  fill_random(&frame, desktop_rect::make_size(frame.size()));
+  desktop_frame_scaler scaler(desktop_size(100, 100));
+  scaler.scale(frame);
+
+  frame.mutable_updated_region()->set_rect(desktop_rect::make_xywh(200, 200, 4, 4));
+  const desktop_frame *scaled_frame = scaler.scale(frame);
+  ASSERT_TRUE(scaled_frame);
+  // The padded source pixels [199, 205) map to [49, 52), plus a pixel of
+  // padding around, and the columns are aligned to 16 pixels.
+  EXPECT_TRUE(scaled_frame->updated_region().equals(
+      desktop_region(desktop_rect::make_ltrb(48, 48, 64, 53))));
+
+  frame.mutable_updated_region()->clear();
+  scaled_frame = scaler.scale(frame);
+  EXPECT_TRUE(scaled_frame->updated_region().is_empty());
+}
+
+TEST(desktop_frame_scaler_test, scales_whole_frame_after_resize) {
+  desktop_frame_scaler scaler(desktop_size(50, 50));
+  basic_desktop_frame frame(desktop_size(100, 100));
+  fill_random(&frame, desktop_rect::make_size(frame.size()));
+  scaler.scale(frame);
+
+  basic_desktop_frame larger_frame(desktop_size(200, 100));
+  fill_random(&larger_frame, desktop_rect::make_size(larger_frame.size()));
+  larger_frame.mutable_updated_region()->set_rect(desktop_rect::make_xywh(0, 0, 2, 2));
+  const desktop_frame *scaled_frame = scaler.scale(larger_frame);
+  ASSERT_TRUE(scaled_frame);
+  EXPECT_TRUE(scaled_frame->updated_region().equals(
+      desktop_region(desktop_rect::make_size(desktop_size(50, 50)))));
+  expect_scaled_equal(larger_frame, *scaled_frame);
+
+  scaler.set_target_size(desktop_size(0, 0));
+  EXPECT_FALSE(scaler.scale(larger_frame));
+}
+
+} // namespace base
+} // namespace traa
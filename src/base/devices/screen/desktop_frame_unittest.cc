@@ -101,6 +101,47 @@ TEST(desktop_frame_test, frame_data_switches_between_non_black_and_black) {
   EXPECT_TRUE(frame->frame_data_is_black());
 }
 
+TEST(desktop_frame_test, copy_and_diff_pixels_reports_changed_blocks) {
+  auto dest_frame = create_test_frame(desktop_rect::make_xywh(0, 0, 100, 100), 0);
+  auto src_frame = create_test_frame(desktop_rect::make_xywh(0, 0, 100, 100), 0);
+  // One pixel in the first block, and one in the block at the bottom right
+  // corner, which is partially covered by the copied area.
+  *reinterpret_cast<uint32_t *>(src_frame->get_frame_data_at_pos(desktop_vector(10, 10))) = 1;
+  *reinterpret_cast<uint32_t *>(src_frame->get_frame_data_at_pos(desktop_vector(97, 97))) = 1;
+
+  desktop_region dirty_region;
+  const desktop_rect dest_rect = desktop_rect::make_ltrb(5, 5, 99, 99);
+  dest_frame->copy_and_diff_pixels_from(*src_frame, dest_rect.top_left(), dest_rect,
+                                        &dirty_region);
+
+  desktop_region expected;
+  expected.add_rect(desktop_rect::make_ltrb(5, 5, 32, 32));
+  expected.add_rect(desktop_rect::make_ltrb(96, 96, 99, 99));
+  EXPECT_TRUE(dirty_region.equals(expected));
+  EXPECT_EQ(1u, *reinterpret_cast<uint32_t *>(
+                    dest_frame->get_frame_data_at_pos(desktop_vector(10, 10))));
+  EXPECT_EQ(1u, *reinterpret_cast<uint32_t *>(
+                    dest_frame->get_frame_data_at_pos(desktop_vector(97, 97))));
+
+  // Copying the same content again reports nothing.
+  dirty_region.clear();
+  dest_frame->copy_and_diff_pixels_from(*src_frame, dest_rect.top_left(), dest_rect,
+                                        &dirty_region);
+  EXPECT_TRUE(dirty_region.is_empty());
+}
+
+TEST(desktop_frame_test, frame_info_does_not_carry_precomputed_region) {
+  auto frame = create_test_frame(desktop_rect::make_xywh(0, 0, 10, 10), 0);
+  frame->set_updated_region_precomputed(true);
+
+  auto copy = create_test_frame(desktop_rect::make_xywh(0, 0, 10, 10), 0);
+  copy->copy_frame_info_from(*frame);
+  EXPECT_FALSE(copy->is_updated_region_precomputed());
+
+  copy->move_frame_info_from(frame.get());
+  EXPECT_FALSE(copy->is_updated_region_precomputed());
+}
+
 TEST(desktop_frame_test, copy_intersecting_pixels_matching_rects) {
   // clang-format off
   const test_data tests[] = {
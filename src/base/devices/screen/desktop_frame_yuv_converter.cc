@@ -0,0 +1,108 @@
+#include "base/devices/screen/desktop_frame_yuv_converter.h"
+
+#include "base/checks.h"
+
+#include <libyuv/convert_from_argb.h>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// Extends `rect` to even coordinates, so it covers whole chroma blocks, and
+// clips it to `size`.
+desktop_rect align_to_chroma_blocks(const desktop_rect &rect, const desktop_size &size) {
+  desktop_rect aligned = desktop_rect::make_ltrb(rect.left() & ~1, rect.top() & ~1,
+                                                 (rect.right() + 1) & ~1, (rect.bottom() + 1) & ~1);
+  aligned.intersect_with(desktop_rect::make_size(size));
+  return aligned;
+}
+
+} // namespace
+
+desktop_frame_yuv_converter::desktop_frame_yuv_converter(format fmt) : format_(fmt) {}
+
+desktop_frame_yuv_converter::~desktop_frame_yuv_converter() = default;
+
+void desktop_frame_yuv_converter::convert(const desktop_frame &frame) {
+  converted_region_.clear();
+  if (!frame.size().equals(size_) || y_plane_.empty()) {
+    allocate(frame.size());
+    if (size_.is_empty()) {
+      return;
+    }
+    converted_region_.set_rect(desktop_rect::make_size(size_));
+  } else {
+    for (desktop_region::iterator it(frame.updated_region()); !it.is_at_end(); it.advance()) {
+      converted_region_.add_rect(align_to_chroma_blocks(it.rect(), size_));
+    }
+  }
+
+  for (desktop_region::iterator it(converted_region_); !it.is_at_end(); it.advance()) {
+    convert_rect(frame, it.rect());
+  }
+}
+
+void desktop_frame_yuv_converter::reset() {
+  size_ = desktop_size();
+  y_plane_.clear();
+  chroma_planes_.clear();
+  converted_region_.clear();
+}
+
+const uint8_t *desktop_frame_yuv_converter::u_data() const {
+  TRAA_DCHECK(format_ == format::i420);
+  return chroma_planes_.data();
+}
+
+const uint8_t *desktop_frame_yuv_converter::v_data() const {
+  TRAA_DCHECK(format_ == format::i420);
+  return chroma_planes_.data() + chroma_stride_ * chroma_height_;
+}
+
+const uint8_t *desktop_frame_yuv_converter::uv_data() const {
+  TRAA_DCHECK(format_ == format::nv12);
+  return chroma_planes_.data();
+}
+
+void desktop_frame_yuv_converter::allocate(const desktop_size &size) {
+  size_ = size;
+  if (size.is_empty()) {
+    y_plane_.clear();
+    chroma_planes_.clear();
+    return;
+  }
+
+  const int chroma_width = (size.width() + 1) / 2;
+  y_stride_ = size.width();
+  chroma_height_ = (size.height() + 1) / 2;
+  y_plane_.resize(y_stride_ * size.height());
+  if (format_ == format::i420) {
+    chroma_stride_ = chroma_width;
+    chroma_planes_.resize(chroma_stride_ * chroma_height_ * 2);
+  } else {
+    chroma_stride_ = chroma_width * 2;
+    chroma_planes_.resize(chroma_stride_ * chroma_height_);
+  }
+}
+
+void desktop_frame_yuv_converter::convert_rect(const desktop_frame &frame,
+                                               const desktop_rect &rect) {
+  TRAA_DCHECK(rect.left() % 2 == 0 && rect.top() % 2 == 0);
+  const uint8_t *src = frame.get_frame_data_at_pos(rect.top_left());
+  uint8_t *y = y_plane_.data() + rect.top() * y_stride_ + rect.left();
+  const int chroma_offset = rect.top() / 2 * chroma_stride_;
+  if (format_ == format::i420) {
+    uint8_t *u = chroma_planes_.data() + chroma_offset + rect.left() / 2;
+    uint8_t *v = u + chroma_stride_ * chroma_height_;
+    libyuv::ARGBToI420(src, frame.stride(), y, y_stride_, u, chroma_stride_, v, chroma_stride_,
+                       rect.width(), rect.height());
+  } else {
+    uint8_t *uv = chroma_planes_.data() + chroma_offset + rect.left();
+    libyuv::ARGBToNV12(src, frame.stride(), y, y_stride_, uv, chroma_stride_, rect.width(),
+                       rect.height());
+  }
+}
+
+} // namespace base
+} // namespace traa
@@ -0,0 +1,90 @@
+#ifndef TRAA_BASE_DEVICES_SCREEN_DESKTOP_FRAME_YUV_CONVERTER_H_
+#define TRAA_BASE_DEVICES_SCREEN_DESKTOP_FRAME_YUV_CONVERTER_H_
+
+#include "base/devices/screen/desktop_frame.h"
+#include "base/devices/screen/desktop_geometry.h"
+#include "base/devices/screen/desktop_region.h"
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace traa {
+namespace base {
+
+// Converts the desktop_frames of a single source to I420 or NV12, and keeps
+// the converted planes across frames. Only the updated_region() of each frame
+// is converted again, extended to whole 2x2 chroma blocks, so a frame with a
+// few small changes costs a fraction of a full conversion.
+//
+// The planes only stay in sync with the source if convert() is called with
+// every frame the source captures, since updated_region() is relative to the
+// previous frame. Call reset() after skipping a frame.
+class desktop_frame_yuv_converter final {
+public:
+  enum class format {
+    // Y plane, followed by U and V planes of half width and half height.
+    i420,
+    // Y plane, followed by an interleaved UV plane of half height.
+    nv12,
+  };
+
+  explicit desktop_frame_yuv_converter(format fmt);
+  ~desktop_frame_yuv_converter();
+
+  desktop_frame_yuv_converter(const desktop_frame_yuv_converter &) = delete;
+  desktop_frame_yuv_converter &operator=(const desktop_frame_yuv_converter &) = delete;
+
+  // Converts the updated area of `frame`. The whole frame is converted if it
+  // is the first frame after construction or reset(), or if its size differs
+  // from the previous frame.
+  void convert(const desktop_frame &frame);
+
+  // Drops the converted planes, so the next frame is converted entirely.
+  void reset();
+
+  format output_format() const { return format_; }
+
+  // The size of the last converted frame.
+  const desktop_size &size() const { return size_; }
+
+  // The area converted by the last convert() call, aligned to even
+  // coordinates except at the right and bottom edges of odd sized frames.
+  const desktop_region &converted_region() const { return converted_region_; }
+
+  const uint8_t *y_data() const { return y_plane_.data(); }
+  int y_stride() const { return y_stride_; }
+
+  // Only valid for format::i420.
+  const uint8_t *u_data() const;
+  const uint8_t *v_data() const;
+
+  // Only valid for format::nv12.
+  const uint8_t *uv_data() const;
+
+  // The stride of the U and V planes, or of the UV plane.
+  int chroma_stride() const { return chroma_stride_; }
+
+private:
+  // Allocates the planes for frames of `size`.
+  void allocate(const desktop_size &size);
+
+  // Converts `rect` of `frame`, whose top left corner must be even.
+  void convert_rect(const desktop_frame &frame, const desktop_rect &rect);
+
+  const format format_;
+  desktop_size size_;
+  int y_stride_ = 0;
+  int chroma_stride_ = 0;
+  int chroma_height_ = 0;
+  std::vector<uint8_t> y_plane_;
+  // The U and V planes of format::i420 back to back, or the UV plane of
+  // format::nv12.
+  std::vector<uint8_t> chroma_planes_;
+  desktop_region converted_region_;
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_DESKTOP_FRAME_YUV_CONVERTER_H_
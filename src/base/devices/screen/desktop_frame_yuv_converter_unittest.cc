@@ -0,0 +1,148 @@
+#include "base/devices/screen/desktop_frame_yuv_converter.h"
+
+#include "base/devices/screen/desktop_frame.h"
+
+#include <libyuv/convert_from_argb.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+void fill_random(desktop_frame *frame, const desktop_rect &rect) {
+  for (int y = rect.top(); y < rect.bottom(); y++) {
+    uint8_t *row = frame->get_frame_data_at_pos(desktop_vector(rect.left(), y));
+    for (int i = 0; i < rect.width() * desktop_frame::k_bytes_per_pixel; i++) {
+      row[i] = static_cast<uint8_t>(rand());
+    }
+  }
+}
+
+// Converts the whole `frame` with libyuv, and compares the result with the
+// planes of `converter`.
+void expect_planes_equal(const desktop_frame &frame,
+                         const desktop_frame_yuv_converter &converter) {
+  const int width = frame.size().width();
+  const int height = frame.size().height();
+  const int chroma_width = (width + 1) / 2;
+  const int chroma_height = (height + 1) / 2;
+  ASSERT_TRUE(converter.size().equals(frame.size()));
+
+  std::vector<uint8_t> y(width * height);
+  std::vector<uint8_t> chroma(chroma_width * 2 * chroma_height);
+  if (converter.output_format() == desktop_frame_yuv_converter::format::i420) {
+    uint8_t *u = chroma.data();
+    uint8_t *v = u + chroma_width * chroma_height;
+    libyuv::ARGBToI420(frame.data(), frame.stride(), y.data(), width, u, chroma_width, v,
+                       chroma_width, width, height);
+    for (int row = 0; row < chroma_height; row++) {
+      ASSERT_EQ(memcmp(converter.u_data() + row * converter.chroma_stride(),
+                       u + row * chroma_width, chroma_width),
+                0);
+      ASSERT_EQ(memcmp(converter.v_data() + row * converter.chroma_stride(),
+                       v + row * chroma_width, chroma_width),
+                0);
+    }
+  } else {
+    libyuv::ARGBToNV12(frame.data(), frame.stride(), y.data(), width, chroma.data(),
+                       chroma_width * 2, width, height);
+    for (int row = 0; row < chroma_height; row++) {
+      ASSERT_EQ(memcmp(converter.uv_data() + row * converter.chroma_stride(),
+                       chroma.data() + row * chroma_width * 2, chroma_width * 2),
+                0);
+    }
+  }
+  for (int row = 0; row < height; row++) {
+    ASSERT_EQ(memcmp(converter.y_data() + row * converter.y_stride(), y.data() + row * width,
+                     width),
+              0);
+  }
+}
+
+// Changes random rectangles of `frame` over several frames, and verifies the
+// incrementally converted planes match a full conversion.
+void test_incremental_conversion(desktop_frame_yuv_converter::format fmt,
+                                 const desktop_size &size) {
+  std::unique_ptr<desktop_frame> frame(new basic_desktop_frame(size));
+  fill_random(frame.get(), desktop_rect::make_size(size));
+  desktop_frame_yuv_converter converter(fmt);
+  converter.convert(*frame);
+  EXPECT_TRUE(converter.converted_region().equals(desktop_region(desktop_rect::make_size(size))));
+  expect_planes_equal(*frame, converter);
+
+  for (int i = 0; i < 20; i++) {
+    frame->mutable_updated_region()->clear();
+    for (int j = 0; j < 3; j++) {
+      const int left = rand() % size.width();
+      const int top = rand() % size.height();
+      const desktop_rect rect =
+          desktop_rect::make_ltrb(left, top, left + 1 + rand() % (size.width() - left),
+                                  top + 1 + rand() % (size.height() - top));
+      fill_random(frame.get(), rect);
+      frame->mutable_updated_region()->add_rect(rect);
+    }
+    converter.convert(*frame);
+    expect_planes_equal(*frame, converter);
+  }
+}
+
+} // namespace
+
+TEST(desktop_frame_yuv_converter_test, i420_incremental) {
+  test_incremental_conversion(desktop_frame_yuv_converter::format::i420, desktop_size(64, 48));
+  test_incremental_conversion(desktop_frame_yuv_converter::format::i420, desktop_size(37, 29));
+}
+
+TEST(desktop_frame_yuv_converter_test, nv12_incremental) {
+  test_incremental_conversion(desktop_frame_yuv_converter::format::nv12, desktop_size(64, 48));
+  test_incremental_conversion(desktop_frame_yuv_converter::format::nv12, desktop_size(37, 29));
+}
+
+TEST(desktop_frame_yuv_converter_test, converts_aligned_updated_region) {
+  basic_desktop_frame frame(desktop_size(32, 32));
+  fill_random(&frame, desktop_rect::make_size(frame.size()));
+  desktop_frame_yuv_converter converter(desktop_frame_yuv_converter::format::i420);
+  converter.convert(frame);
+
+  frame.mutable_updated_region()->set_rect(desktop_rect::make_ltrb(3, 5, 8, 9));
+  converter.convert(frame);
+  EXPECT_TRUE(converter.converted_region().equals(
+      desktop_region(desktop_rect::make_ltrb(2, 4, 8, 10))));
+
+  frame.mutable_updated_region()->clear();
+  converter.convert(frame);
+  EXPECT_TRUE(converter.converted_region().is_empty());
+}
+
+TEST(desktop_frame_yuv_converter_test, converts_whole_frame_after_resize_or_reset) {
+  desktop_frame_yuv_converter converter(desktop_frame_yuv_converter::format::nv12);
+  basic_desktop_frame frame(desktop_size(16, 16));
+  fill_random(&frame, desktop_rect::make_size(frame.size()));
+  converter.convert(frame);
+
+  basic_desktop_frame larger_frame(desktop_size(24, 16));
+  fill_random(&larger_frame, desktop_rect::make_size(larger_frame.size()));
+  larger_frame.mutable_updated_region()->set_rect(desktop_rect::make_xywh(0, 0, 2, 2));
+  converter.convert(larger_frame);
+  EXPECT_TRUE(converter.converted_region().equals(
+      desktop_region(desktop_rect::make_size(larger_frame.size()))));
+  expect_planes_equal(larger_frame, converter);
+
+  converter.reset();
+  fill_random(&larger_frame, desktop_rect::make_size(larger_frame.size()));
+  converter.convert(larger_frame);
+  EXPECT_TRUE(converter.converted_region().equals(
+      desktop_region(desktop_rect::make_size(larger_frame.size()))));
+  expect_planes_equal(larger_frame, converter);
+}
+
+} // namespace base
+} // namespace traa
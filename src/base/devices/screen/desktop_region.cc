@@ -16,14 +16,94 @@
 namespace traa {
 namespace base {
 
-desktop_region::row_span::row_span(int32_t left, int32_t right) : left(left), right(right) {}
+inline namespace {
+
+// Unused spans are only dropped from the span buffer once there are at least
+// this many of them, and they take more than half of the buffer.
+constexpr size_t k_min_unused_spans_to_compact = 32;
+
+// simplify() considers merging each rectangle with this many rectangles
+// following it, ordered by position.
+constexpr size_t k_simplify_neighbours = 8;
+
+// simplify() rebuilds the region at most this many times, since the union of
+// overlapping bounding rectangles may be split into more rectangles again.
+constexpr int k_max_simplify_rounds = 4;
+
+int64_t rect_area(const desktop_rect &rect) {
+  return static_cast<int64_t>(rect.width()) * rect.height();
+}
 
-desktop_region::row::row(const row &) = default;
-desktop_region::row::row(row &&) = default;
+desktop_rect bounding_rect(const desktop_rect &a, const desktop_rect &b) {
+  return desktop_rect::make_ltrb(std::min(a.left(), b.left()), std::min(a.top(), b.top()),
+                                 std::max(a.right(), b.right()), std::max(a.bottom(), b.bottom()));
+}
 
-desktop_region::row::row(int32_t top, int32_t bottom) : top(top), bottom(bottom) {}
+// Replaces pairs of nearby `rects` with their bounding rectangles, cheapest
+// first, as long as there are more than `max_rects` of them and the total area
+// of `rects` stays within `max_area`. Returns false if no pair can be merged.
+bool merge_nearby_rects(std::vector<desktop_rect> *rects, size_t max_rects, int64_t max_area) {
+  struct merge_candidate {
+    int64_t cost;
+    size_t first;
+    size_t second;
+  };
+
+  std::sort(rects->begin(), rects->end(), [](const desktop_rect &a, const desktop_rect &b) {
+    return a.top() < b.top() || (a.top() == b.top() && a.left() < b.left());
+  });
+
+  int64_t area = 0;
+  std::vector<merge_candidate> candidates;
+  candidates.reserve(rects->size() * k_simplify_neighbours);
+  for (size_t i = 0; i < rects->size(); ++i) {
+    const desktop_rect &rect = (*rects)[i];
+    area += rect_area(rect);
+    for (size_t j = i + 1; j < rects->size() && j <= i + k_simplify_neighbours; ++j) {
+      const desktop_rect &other = (*rects)[j];
+      candidates.push_back(
+          {rect_area(bounding_rect(rect, other)) - rect_area(rect) - rect_area(other), i, j});
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const merge_candidate &a, const merge_candidate &b) { return a.cost < b.cost; });
+
+  // Each rectangle is merged at most once per call, since the costs of the
+  // candidates involving a merged rectangle are stale.
+  std::vector<bool> merged(rects->size(), false);
+  std::vector<bool> removed(rects->size(), false);
+  size_t count = rects->size();
+  bool changed = false;
+  for (const merge_candidate &candidate : candidates) {
+    if (count <= max_rects || area + candidate.cost > max_area)
+      break;
+    if (merged[candidate.first] || merged[candidate.second])
+      continue;
 
-desktop_region::row::~row() {}
+    (*rects)[candidate.first] =
+        bounding_rect((*rects)[candidate.first], (*rects)[candidate.second]);
+    merged[candidate.first] = merged[candidate.second] = true;
+    removed[candidate.second] = true;
+    area += candidate.cost;
+    --count;
+    changed = true;
+  }
+
+  size_t kept = 0;
+  for (size_t i = 0; i < rects->size(); ++i) {
+    if (!removed[i])
+      (*rects)[kept++] = (*rects)[i];
+  }
+  rects->resize(kept);
+  return changed;
+}
+
+} // namespace
+
+desktop_region::row_span::row_span(int32_t left, int32_t right) : left(left), right(right) {}
+
+desktop_region::row::row(int32_t top, int32_t bottom, uint32_t first_span, uint32_t span_count)
+    : top(top), bottom(bottom), first_span(first_span), span_count(span_count) {}
 
 desktop_region::desktop_region() {}
 
@@ -33,40 +113,34 @@ desktop_region::desktop_region(const desktop_rect *rects, int count) { add_rects
 
 desktop_region::desktop_region(const desktop_region &other) { *this = other; }
 
-desktop_region::~desktop_region() { clear(); }
+desktop_region::~desktop_region() {}
 
 desktop_region &desktop_region::operator=(const desktop_region &other) {
-  clear();
   rows_ = other.rows_;
-  for (rows_t::iterator it = rows_.begin(); it != rows_.end(); ++it) {
-    // Copy each row.
-    row *r = it->second;
-    it->second = new row(*r);
-  }
+  spans_ = other.spans_;
+  unused_spans_ = other.unused_spans_;
   return *this;
 }
 
 bool desktop_region::equals(const desktop_region &region) const {
   // Iterate over rows of the tow regions and compare each row.
-  rows_t::const_iterator it1 = rows_.begin();
-  rows_t::const_iterator it2 = region.rows_.begin();
-  while (it1 != rows_.end()) {
-    if (it2 == region.rows_.end() || it1->first != it2->first ||
-        it1->second->top != it2->second->top || it1->second->bottom != it2->second->bottom ||
-        it1->second->spans != it2->second->spans) {
+  if (rows_.size() != region.rows_.size())
+    return false;
+  for (size_t i = 0; i < rows_.size(); ++i) {
+    const row &r1 = rows_[i];
+    const row &r2 = region.rows_[i];
+    if (r1.top != r2.top || r1.bottom != r2.bottom || r1.span_count != r2.span_count ||
+        !std::equal(spans_begin(r1), spans_end(r1), region.spans_begin(r2))) {
       return false;
     }
-    ++it1;
-    ++it2;
   }
-  return it2 == region.rows_.end();
+  return true;
 }
 
 void desktop_region::clear() {
-  for (rows_t::iterator r = rows_.begin(); r != rows_.end(); ++r) {
-    delete r->second;
-  }
   rows_.clear();
+  spans_.clear();
+  unused_spans_ = 0;
 }
 
 void desktop_region::set_rect(const desktop_rect &rect) {
@@ -84,48 +158,45 @@ void desktop_region::add_rect(const desktop_rect &rect) {
 
   // Iterate over all rows that may intersect with `rect` and add new rows when
   // necessary.
-  rows_t::iterator r = rows_.upper_bound(top);
+  size_t r = find_row(top);
   while (top < rect.bottom()) {
-    if (r == rows_.end() || top < r->second->top) {
+    if (r == rows_.size() || top < rows_[r].top) {
       // If `top` is above the top of the current `row` then add a new row above
       // the current one.
       int32_t bottom = rect.bottom();
-      if (r != rows_.end() && r->second->top < bottom)
-        bottom = r->second->top;
-      r = rows_.insert(r, rows_t::value_type(bottom, new row(top, bottom)));
-    } else if (top > r->second->top) {
+      if (r != rows_.size() && rows_[r].top < bottom)
+        bottom = rows_[r].top;
+      rows_.insert(rows_.begin() + r,
+                   row(top, bottom, static_cast<uint32_t>(spans_.size()), 0));
+    } else if (top > rows_[r].top) {
       // If the `top` falls in the middle of the `row` then split `row` into
-      // two, at `top`, and leave `row` referring to the lower of the two,
-      // ready to insert a new span into.
-      rows_t::iterator new_r =
-          rows_.insert(r, rows_t::value_type(top, new row(r->second->top, top)));
-      r->second->top = top;
-      new_r->second->spans = r->second->spans;
+      // two, at `top`, and move `r` to the lower of the two, ready to insert a
+      // new span into.
+      split_row(r, top);
+      ++r;
     }
 
-    if (rect.bottom() < r->second->bottom) {
+    if (rect.bottom() < rows_[r].bottom) {
       // If the bottom of the `rect` falls in the middle of the `row` split
-      // `row` into two, at `top`, and leave `row` referring to the upper of
-      // the two, ready to insert a new span into.
-      rows_t::iterator new_r =
-          rows_.insert(r, rows_t::value_type(rect.bottom(), new row(top, rect.bottom())));
-      r->second->top = rect.bottom();
-      new_r->second->spans = r->second->spans;
-      r = new_r;
+      // `row` into two, at `rect.bottom()`, and leave `r` referring to the
+      // upper of the two, ready to insert a new span into.
+      split_row(r, rect.bottom());
     }
 
     // Add a new span to the current row.
-    add_span_to_row(r->second, rect.left(), rect.right());
-    top = r->second->bottom;
+    add_span_to_row(r, rect.left(), rect.right());
+    top = rows_[r].bottom;
 
-    merge_with_preceding_row(r);
+    r = merge_with_preceding_row(r);
 
     // Move to the next row.
     ++r;
   }
 
-  if (r != rows_.end())
+  if (r != rows_.size())
     merge_with_preceding_row(r);
+
+  compact_spans_if_needed();
 }
 
 void desktop_region::add_rects(const desktop_rect *rects, int count) {
@@ -134,20 +205,21 @@ void desktop_region::add_rects(const desktop_rect *rects, int count) {
   }
 }
 
-void desktop_region::merge_with_preceding_row(rows_t::iterator r) {
-  if (r != rows_.begin()) {
-    rows_t::iterator previous_r = r;
-    previous_r--;
+size_t desktop_region::merge_with_preceding_row(size_t index) {
+  if (index == 0)
+    return index;
 
-    // If `row` and `previous_r` are next to each other and contain the same
-    // set of spans then they can be merged.
-    if (previous_r->second->bottom == r->second->top &&
-        previous_r->second->spans == r->second->spans) {
-      r->second->top = previous_r->second->top;
-      delete previous_r->second;
-      rows_.erase(previous_r);
-    }
+  row &previous_r = rows_[index - 1];
+  const row &r = rows_[index];
+
+  // If `row` and `previous_r` are next to each other and contain the same
+  // set of spans then they can be merged.
+  if (previous_r.bottom == r.top && row_spans_equal(previous_r, r)) {
+    previous_r.bottom = r.bottom;
+    erase_row(index);
+    return index - 1;
   }
+  return index;
 }
 
 void desktop_region::add_region(const desktop_region &region) {
@@ -161,57 +233,62 @@ void desktop_region::add_region(const desktop_region &region) {
 void desktop_region::intersect(const desktop_region &region1, const desktop_region &region2) {
   clear();
 
-  rows_t::const_iterator it1 = region1.rows_.begin();
-  rows_t::const_iterator end1 = region1.rows_.end();
-  rows_t::const_iterator it2 = region2.rows_.begin();
-  rows_t::const_iterator end2 = region2.rows_.end();
-  if (it1 == end1 || it2 == end2)
-    return;
+  const rows_t *rows1 = &region1.rows_;
+  const rows_t *rows2 = &region2.rows_;
+  const desktop_region *spans1 = &region1;
+  const desktop_region *spans2 = &region2;
+  size_t it1 = 0;
+  size_t it2 = 0;
 
-  while (it1 != end1 && it2 != end2) {
+  while (it1 != rows1->size() && it2 != rows2->size()) {
     // Arrange for `it1` to always be the top-most of the rows.
-    if (it2->second->top < it1->second->top) {
+    if ((*rows2)[it2].top < (*rows1)[it1].top) {
       std::swap(it1, it2);
-      std::swap(end1, end2);
+      std::swap(rows1, rows2);
+      std::swap(spans1, spans2);
     }
 
+    const row &row1 = (*rows1)[it1];
+    const row &row2 = (*rows2)[it2];
+
     // Skip `it1` if it doesn't intersect `it2` at all.
-    if (it1->second->bottom <= it2->second->top) {
+    if (row1.bottom <= row2.top) {
       ++it1;
       continue;
     }
 
     // Top of the `it1` row is above the top of `it2`, so top of the
     // intersection is always the top of `it2`.
-    int32_t top = it2->second->top;
-    int32_t bottom = std::min(it1->second->bottom, it2->second->bottom);
-
-    rows_t::iterator new_row =
-        rows_.insert(rows_.end(), rows_t::value_type(bottom, new row(top, bottom)));
-    intersect_rows(it1->second->spans, it2->second->spans, &new_row->second->spans);
-    if (new_row->second->spans.empty()) {
-      delete new_row->second;
-      rows_.erase(new_row);
-    } else {
-      merge_with_preceding_row(new_row);
+    int32_t top = row2.top;
+    int32_t bottom = std::min(row1.bottom, row2.bottom);
+
+    // The spans of the new row are appended straight to the span buffer.
+    const size_t first_span = spans_.size();
+    intersect_rows(spans1->spans_begin(row1), spans1->spans_end(row1), spans2->spans_begin(row2),
+                   spans2->spans_end(row2), &spans_);
+    if (spans_.size() != first_span) {
+      rows_.push_back(row(top, bottom, static_cast<uint32_t>(first_span),
+                          static_cast<uint32_t>(spans_.size() - first_span)));
+      merge_with_preceding_row(rows_.size() - 1);
     }
 
     // If `it1` was completely consumed, move to the next one.
-    if (it1->second->bottom == bottom)
+    if (row1.bottom == bottom)
       ++it1;
     // If `it2` was completely consumed, move to the next one.
-    if (it2->second->bottom == bottom)
+    if (row2.bottom == bottom)
       ++it2;
   }
+
+  compact_spans_if_needed();
 }
 
 // static
-void desktop_region::intersect_rows(const row_span_set_t &set1, const row_span_set_t &set2,
+void desktop_region::intersect_rows(const row_span *begin1, const row_span *end1,
+                                    const row_span *begin2, const row_span *end2,
                                     row_span_set_t *output) {
-  row_span_set_t::const_iterator it1 = set1.begin();
-  row_span_set_t::const_iterator end1 = set1.end();
-  row_span_set_t::const_iterator it2 = set2.begin();
-  row_span_set_t::const_iterator end2 = set2.end();
+  const row_span *it1 = begin1;
+  const row_span *it2 = begin2;
 
   do {
     // Arrange for `it1` to always be the left-most of the spans.
@@ -256,88 +333,90 @@ void desktop_region::subtract(const desktop_region &region) {
   if (region.rows_.empty())
     return;
 
+  if (&region == this) {
+    clear();
+    return;
+  }
+
   // `row_b` refers to the current row being subtracted.
-  rows_t::const_iterator row_b = region.rows_.begin();
+  size_t row_b = 0;
 
   // Current vertical position at which subtraction is happening.
-  int top = row_b->second->top;
+  int top = region.rows_[row_b].top;
 
   // `row_a` refers to the current row we are subtracting from. Skip all rows
   // above `top`.
-  rows_t::iterator row_a = rows_.upper_bound(top);
+  size_t row_a = find_row(top);
+
+  row_span_set_t new_spans;
 
   // Step through rows of the both regions subtracting content of `row_b` from
   // `row_a`.
-  while (row_a != rows_.end() && row_b != region.rows_.end()) {
+  while (row_a != rows_.size() && row_b != region.rows_.size()) {
     // Skip `row_a` if it doesn't intersect with the `row_b`.
-    if (row_a->second->bottom <= top) {
+    if (rows_[row_a].bottom <= top) {
       // Each output row is merged with previously-processed rows before further
       // rows are processed.
-      merge_with_preceding_row(row_a);
+      row_a = merge_with_preceding_row(row_a);
       ++row_a;
       continue;
     }
 
-    if (top > row_a->second->top) {
+    if (top > rows_[row_a].top) {
       // If `top` falls in the middle of `row_a` then split `row_a` into two, at
-      // `top`, and leave `row_a` referring to the lower of the two, ready to
-      // subtract spans from.
-      rows_t::iterator new_row =
-          rows_.insert(row_a, rows_t::value_type(top, new row(row_a->second->top, top)));
-      row_a->second->top = top;
-      new_row->second->spans = row_a->second->spans;
-    } else if (top < row_a->second->top) {
+      // `top`, and move `row_a` to the lower of the two, ready to subtract
+      // spans from.
+      split_row(row_a, top);
+      ++row_a;
+    } else if (top < rows_[row_a].top) {
       // If the `top` is above `row_a` then skip the range between `top` and
       // top of `row_a` because it's empty.
-      top = row_a->second->top;
-      if (top >= row_b->second->bottom) {
+      top = rows_[row_a].top;
+      if (top >= region.rows_[row_b].bottom) {
         ++row_b;
-        if (row_b != region.rows_.end())
-          top = row_b->second->top;
+        if (row_b != region.rows_.size())
+          top = region.rows_[row_b].top;
         continue;
       }
     }
 
-    if (row_b->second->bottom < row_a->second->bottom) {
+    const row &b = region.rows_[row_b];
+
+    if (b.bottom < rows_[row_a].bottom) {
       // If the bottom of `row_b` falls in the middle of the `row_a` split
-      // `row_a` into two, at `top`, and leave `row_a` referring to the upper of
-      // the two, ready to subtract spans from.
-      int bottom = row_b->second->bottom;
-      rows_t::iterator new_row =
-          rows_.insert(row_a, rows_t::value_type(bottom, new row(top, bottom)));
-      row_a->second->top = bottom;
-      new_row->second->spans = row_a->second->spans;
-      row_a = new_row;
+      // `row_a` into two, at `b.bottom`, and leave `row_a` referring to the
+      // upper of the two, ready to subtract spans from.
+      split_row(row_a, b.bottom);
     }
 
     // At this point the vertical range covered by `row_a` lays within the
     // range covered by `row_b`. subtract `row_b` spans from `row_a`.
-    row_span_set_t new_spans;
-    subtract_rows(row_a->second->spans, row_b->second->spans, &new_spans);
-    new_spans.swap(row_a->second->spans);
-    top = row_a->second->bottom;
+    new_spans.clear();
+    subtract_rows(spans_begin(rows_[row_a]), spans_end(rows_[row_a]), region.spans_begin(b),
+                  region.spans_end(b), &new_spans);
+    set_row_spans(row_a, new_spans);
+    top = rows_[row_a].bottom;
 
-    if (top >= row_b->second->bottom) {
+    if (top >= b.bottom) {
       ++row_b;
-      if (row_b != region.rows_.end())
-        top = row_b->second->top;
+      if (row_b != region.rows_.size())
+        top = region.rows_[row_b].top;
     }
 
     // Check if the row is empty after subtraction and delete it. Otherwise move
     // to the next one.
-    if (row_a->second->spans.empty()) {
-      rows_t::iterator row_to_delete = row_a;
-      ++row_a;
-      delete row_to_delete->second;
-      rows_.erase(row_to_delete);
+    if (rows_[row_a].span_count == 0) {
+      erase_row(row_a);
     } else {
-      merge_with_preceding_row(row_a);
+      row_a = merge_with_preceding_row(row_a);
       ++row_a;
     }
   }
 
-  if (row_a != rows_.end())
+  if (row_a != rows_.size())
     merge_with_preceding_row(row_a);
+
+  compact_spans_if_needed();
 }
 
 void desktop_region::subtract(const desktop_rect &rect) {
@@ -347,31 +426,64 @@ void desktop_region::subtract(const desktop_rect &rect) {
 }
 
 void desktop_region::translate(int32_t dx, int32_t dy) {
-  rows_t new_rows;
+  // Rows keep their order, so they can be translated in place. Unused spans
+  // are translated as well, which is harmless.
+  if (dy != 0) {
+    for (row &r : rows_) {
+      r.top += dy;
+      r.bottom += dy;
+    }
+  }
 
-  for (rows_t::iterator it = rows_.begin(); it != rows_.end(); ++it) {
-    row *r = it->second;
+  if (dx != 0) {
+    for (row_span &span : spans_) {
+      span.left += dx;
+      span.right += dx;
+    }
+  }
+}
 
-    r->top += dy;
-    r->bottom += dy;
+void desktop_region::swap(desktop_region *region) {
+  rows_.swap(region->rows_);
+  spans_.swap(region->spans_);
+  std::swap(unused_spans_, region->unused_spans_);
+}
 
-    if (dx != 0) {
-      // translate each span.
-      for (row_span_set_t::iterator span = r->spans.begin(); span != r->spans.end(); ++span) {
-        span->left += dx;
-        span->right += dx;
-      }
-    }
+void desktop_region::simplify(int max_rects, double max_waste_ratio) {
+  const size_t max_count = static_cast<size_t>(std::max(max_rects, 1));
+  std::vector<desktop_rect> rects;
+  for (iterator it(*this); !it.is_at_end(); it.advance()) {
+    rects.push_back(it.rect());
+  }
+  if (rects.size() <= max_count)
+    return;
 
-    if (dy != 0)
-      new_rows.insert(new_rows.end(), rows_t::value_type(r->bottom, r));
+  // Rectangles returned by the iterator never overlap.
+  int64_t area = 0;
+  for (const desktop_rect &rect : rects) {
+    area += rect_area(rect);
   }
+  const int64_t max_area = area + static_cast<int64_t>(area * std::max(max_waste_ratio, 0.0));
 
-  if (dy != 0)
-    new_rows.swap(rows_);
-}
+  for (int round = 0; round < k_max_simplify_rounds; ++round) {
+    bool changed = false;
+    while (rects.size() > max_count && merge_nearby_rects(&rects, max_count, max_area)) {
+      changed = true;
+    }
+    if (!changed)
+      return;
 
-void desktop_region::swap(desktop_region *region) { rows_.swap(region->rows_); }
+    clear();
+    add_rects(rects.data(), static_cast<int>(rects.size()));
+
+    rects.clear();
+    for (iterator it(*this); !it.is_at_end(); it.advance()) {
+      rects.push_back(it.rect());
+    }
+    if (rects.size() <= max_count)
+      return;
+  }
+}
 
 // static
 bool desktop_region::compare_span_right(const row_span &r, int32_t value) {
@@ -381,26 +493,113 @@ bool desktop_region::compare_span_right(const row_span &r, int32_t value) {
 // static
 bool desktop_region::compare_span_left(const row_span &r, int32_t value) { return r.left < value; }
 
-// static
-void desktop_region::add_span_to_row(row *r, int left, int right) {
+bool desktop_region::row_spans_equal(const row &r1, const row &r2) const {
+  return r1.span_count == r2.span_count &&
+         std::equal(spans_begin(r1), spans_end(r1), spans_begin(r2));
+}
+
+size_t desktop_region::find_row(int32_t y) const {
+  return std::upper_bound(rows_.begin(), rows_.end(), y,
+                          [](int32_t value, const row &r) { return value < r.bottom; }) -
+         rows_.begin();
+}
+
+void desktop_region::split_row(size_t index, int32_t y) {
+  const uint32_t first_span = static_cast<uint32_t>(spans_.size());
+  const uint32_t span_count = rows_[index].span_count;
+  spans_.reserve(spans_.size() + span_count);
+  for (uint32_t i = 0; i < span_count; ++i) {
+    spans_.push_back(spans_[rows_[index].first_span + i]);
+  }
+
+  const int32_t bottom = rows_[index].bottom;
+  rows_[index].bottom = y;
+  rows_.insert(rows_.begin() + index + 1, row(y, bottom, first_span, span_count));
+}
+
+void desktop_region::move_spans_to_end(size_t index) {
+  row &r = rows_[index];
+  if (r.first_span + r.span_count == spans_.size())
+    return;
+
+  const uint32_t first_span = static_cast<uint32_t>(spans_.size());
+  spans_.reserve(spans_.size() + r.span_count);
+  for (uint32_t i = 0; i < r.span_count; ++i) {
+    spans_.push_back(spans_[r.first_span + i]);
+  }
+  release_spans(r.first_span, r.span_count);
+  r.first_span = first_span;
+}
+
+void desktop_region::release_spans(uint32_t first_span, uint32_t span_count) {
+  if (first_span + span_count == spans_.size()) {
+    spans_.erase(spans_.begin() + first_span, spans_.end());
+  } else {
+    unused_spans_ += span_count;
+  }
+}
+
+void desktop_region::set_row_spans(size_t index, const row_span_set_t &spans) {
+  row &r = rows_[index];
+  if (spans.size() <= r.span_count) {
+    // The spans fit into the ones of the row.
+    std::copy(spans.begin(), spans.end(), spans_.begin() + r.first_span);
+    release_spans(r.first_span + static_cast<uint32_t>(spans.size()),
+                  r.span_count - static_cast<uint32_t>(spans.size()));
+  } else {
+    release_spans(r.first_span, r.span_count);
+    r.first_span = static_cast<uint32_t>(spans_.size());
+    spans_.insert(spans_.end(), spans.begin(), spans.end());
+  }
+  r.span_count = static_cast<uint32_t>(spans.size());
+}
+
+void desktop_region::erase_row(size_t index) {
+  release_spans(rows_[index].first_span, rows_[index].span_count);
+  rows_.erase(rows_.begin() + index);
+}
+
+void desktop_region::compact_spans_if_needed() {
+  if (unused_spans_ < k_min_unused_spans_to_compact || unused_spans_ * 2 < spans_.size())
+    return;
+
+  row_span_set_t spans;
+  spans.reserve(spans_.size() - unused_spans_);
+  for (row &r : rows_) {
+    const uint32_t first_span = static_cast<uint32_t>(spans.size());
+    spans.insert(spans.end(), spans_begin(r), spans_end(r));
+    r.first_span = first_span;
+  }
+  spans_.swap(spans);
+  unused_spans_ = 0;
+}
+
+void desktop_region::add_span_to_row(size_t index, int left, int right) {
+  row &r = rows_[index];
+
   // First check if the new span is located to the right of all existing spans.
   // This is an optimization to avoid binary search in the case when rectangles
   // are inserted sequentially from left to right.
-  if (r->spans.empty() || left > r->spans.back().right) {
-    r->spans.push_back(row_span(left, right));
+  if (r.span_count == 0 || left > spans_[r.first_span + r.span_count - 1].right) {
+    move_spans_to_end(index);
+    spans_.push_back(row_span(left, right));
+    ++r.span_count;
     return;
   }
 
+  row_span *begin = spans_.data() + r.first_span;
+  row_span *row_end = begin + r.span_count;
+
   // Find the first span that ends at or after `left`.
-  row_span_set_t::iterator start =
-      std::lower_bound(r->spans.begin(), r->spans.end(), left, compare_span_right);
+  row_span *start = std::lower_bound(begin, row_end, left, compare_span_right);
 
   // Find the first span that starts after `right`.
-  row_span_set_t::iterator end =
-      std::lower_bound(start, r->spans.end(), right + 1, compare_span_left);
-  if (end == r->spans.begin()) {
+  row_span *end = std::lower_bound(start, row_end, right + 1, compare_span_left);
+  if (end == begin) {
     // There are no overlaps. Just insert the new span at the beginning.
-    r->spans.insert(r->spans.begin(), row_span(left, right));
+    move_spans_to_end(index);
+    spans_.insert(spans_.begin() + r.first_span, row_span(left, right));
+    ++r.span_count;
     return;
   }
 
@@ -411,8 +610,12 @@ void desktop_region::add_span_to_row(row *r, int left, int right) {
   // At this point [start, end] is the range of spans that intersect with the
   // new one.
   if (end < start) {
-    // There are no overlaps. Just insert the new span at the correct position.
-    r->spans.insert(start, row_span(left, right));
+    // There are no overlaps. Just insert the new span at the correct position,
+    // which needs the spans of the row at the end of the buffer.
+    const size_t position = start - begin;
+    move_spans_to_end(index);
+    spans_.insert(spans_.begin() + r.first_span + position, row_span(left, right));
+    ++r.span_count;
     return;
   }
 
@@ -423,36 +626,40 @@ void desktop_region::add_span_to_row(row *r, int left, int right) {
   *start = row_span(left, right);
   ++start;
   ++end;
-  if (start < end)
-    r->spans.erase(start, end);
+  if (start < end) {
+    std::copy(end, row_end, start);
+    const uint32_t removed = static_cast<uint32_t>(end - start);
+    r.span_count -= removed;
+    release_spans(r.first_span + r.span_count, removed);
+  }
 }
 
-// static
-bool desktop_region::is_span_in_row(const row &r, const row_span &span) {
+bool desktop_region::is_span_in_row(const row &r, const row_span &span) const {
   // Find the first span that starts at or after `span.left` and then check if
   // it's the same span.
-  row_span_set_t::const_iterator it =
-      std::lower_bound(r.spans.begin(), r.spans.end(), span.left, compare_span_left);
-  return it != r.spans.end() && *it == span;
+  const row_span *end = spans_end(r);
+  const row_span *it = std::lower_bound(spans_begin(r), end, span.left, compare_span_left);
+  return it != end && *it == span;
 }
 
 // static
-void desktop_region::subtract_rows(const row_span_set_t &set_a, const row_span_set_t &set_b,
+void desktop_region::subtract_rows(const row_span *begin_a, const row_span *end_a,
+                                   const row_span *begin_b, const row_span *end_b,
                                    row_span_set_t *output) {
-  row_span_set_t::const_iterator it_b = set_b.begin();
+  const row_span *it_b = begin_b;
 
   // Iterate over all spans in `set_a` adding parts of it that do not intersect
   // with `set_b` to the `output`.
-  for (row_span_set_t::const_iterator it_a = set_a.begin(); it_a != set_a.end(); ++it_a) {
+  for (const row_span *it_a = begin_a; it_a != end_a; ++it_a) {
     // If there is no intersection then append the current span and continue.
-    if (it_b == set_b.end() || it_a->right < it_b->left) {
+    if (it_b == end_b || it_a->right < it_b->left) {
       output->push_back(*it_a);
       continue;
     }
 
     // Iterate over `set_b` spans that may intersect with `it_a`.
     int pos = it_a->left;
-    while (it_b != set_b.end() && it_b->left < it_a->right) {
+    while (it_b != end_b && it_b->left < it_a->right) {
       if (it_b->left > pos)
         output->push_back(row_span(pos, it_b->left));
       if (it_b->right > pos) {
@@ -468,25 +675,26 @@ void desktop_region::subtract_rows(const row_span_set_t &set_a, const row_span_s
 }
 
 desktop_region::iterator::iterator(const desktop_region &region)
-    : region_(region), row_(region.rows_.begin()), previous_row_(region.rows_.end()) {
+    : region_(region), row_(0), previous_row_(region.rows_.size()), row_span_(0) {
   if (!is_at_end()) {
-    row_span_ = row_->second->spans.begin();
+    row_span_ = region_.rows_[row_].first_span;
     update_current_rect();
   }
 }
 
 desktop_region::iterator::~iterator() {}
 
-bool desktop_region::iterator::is_at_end() const { return row_ == region_.rows_.end(); }
+bool desktop_region::iterator::is_at_end() const { return row_ == region_.rows_.size(); }
 
 void desktop_region::iterator::advance() {
+  const rows_t &rows = region_.rows_;
   while (true) {
     ++row_span_;
-    if (row_span_ == row_->second->spans.end()) {
+    if (row_span_ == rows[row_].first_span + rows[row_].span_count) {
       previous_row_ = row_;
       ++row_;
-      if (row_ != region_.rows_.end()) {
-        row_span_ = row_->second->spans.begin();
+      if (row_ != rows.size()) {
+        row_span_ = rows[row_].first_span;
       }
     }
 
@@ -496,9 +704,8 @@ void desktop_region::iterator::advance() {
     // If the same span exists on the previous row then skip it, as we've
     // already returned this span merged into the previous one, via
     // update_current_rect().
-    if (previous_row_ != region_.rows_.end() &&
-        previous_row_->second->bottom == row_->second->top &&
-        is_span_in_row(*previous_row_->second, *row_span_)) {
+    if (previous_row_ != rows.size() && rows[previous_row_].bottom == rows[row_].top &&
+        region_.is_span_in_row(rows[previous_row_], region_.spans_[row_span_])) {
       continue;
     }
 
@@ -510,18 +717,15 @@ void desktop_region::iterator::advance() {
 
 void desktop_region::iterator::update_current_rect() {
   // Merge the current rectangle with the matching spans from later rows.
-  int bottom;
-  rows_t::const_iterator bottom_row = row_;
-  rows_t::const_iterator previous;
-  do {
-    bottom = bottom_row->second->bottom;
-    previous = bottom_row;
+  const rows_t &rows = region_.rows_;
+  const row_span &span = region_.spans_[row_span_];
+  size_t bottom_row = row_;
+  while (bottom_row + 1 != rows.size() && rows[bottom_row].bottom == rows[bottom_row + 1].top &&
+         region_.is_span_in_row(rows[bottom_row + 1], span)) {
     ++bottom_row;
-  } while (bottom_row != region_.rows_.end() &&
-           previous->second->bottom == bottom_row->second->top &&
-           is_span_in_row(*bottom_row->second, *row_span_));
-  rect_ = desktop_rect::make_ltrb(row_span_->left, row_->second->top, row_span_->right, bottom);
+  }
+  rect_ = desktop_rect::make_ltrb(span.left, rows[row_].top, span.right, rows[bottom_row].bottom);
 }
 
 } // namespace base
-} // namespace traa
\ No newline at end of file
+} // namespace traa
@@ -15,7 +15,8 @@
 
 #include "base/devices/screen/desktop_geometry.h"
 
-#include <map>
+#include <stddef.h>
+
 #include <vector>
 
 namespace traa {
@@ -24,7 +25,10 @@ namespace base {
 // desktop_region represents a region of the screen or window.
 //
 // Internally each region is stored as a set of rows where each row contains one
-// or more rectangles aligned vertically.
+// or more rectangles aligned vertically. Rows are kept in a vector sorted by
+// their position, and the spans of all rows are kept in a single buffer shared
+// by the rows, so building a region row by row, as the differ does, only
+// appends to two vectors.
 class desktop_region {
 private:
   // The following private types need to be declared first because they are used
@@ -34,7 +38,6 @@ private:
   struct row_span {
     row_span(int32_t left, int32_t right);
 
-    // Used by std::vector<>.
     bool operator==(const row_span &that) const { return left == that.left && right == that.right; }
 
     int32_t left;
@@ -44,23 +47,21 @@ private:
   using row_span_set_t = std::vector<row_span>;
 
   // row represents a single row of a region. A row is set of rectangles that
-  // have the same vertical position.
+  // have the same vertical position. Its spans are the `span_count` elements
+  // starting from `first_span` in `spans_`.
   struct row {
-    row(const row &);
-    row(row &&);
-    row(int32_t top, int32_t bottom);
-    ~row();
+    row(int32_t top, int32_t bottom, uint32_t first_span, uint32_t span_count);
 
     int32_t top;
     int32_t bottom;
 
-    row_span_set_t spans;
+    uint32_t first_span;
+    uint32_t span_count;
   };
 
-  // Type used to store list of rows in the region. The bottom position of row
-  // is used as the key so that rows are always ordered by their position. The
-  // map stores pointers to make Translate() more efficient.
-  using rows_t = std::map<int, row *>;
+  // Type used to store list of rows in the region. Rows are always ordered by
+  // their position and never overlap.
+  using rows_t = std::vector<row>;
 
 public:
   // iterator that can be used to iterate over rectangles of a desktop_region.
@@ -83,9 +84,11 @@ public:
     // into `rect_`, to generate more efficient output.
     void update_current_rect();
 
-    rows_t::const_iterator row_;
-    rows_t::const_iterator previous_row_;
-    row_span_set_t::const_iterator row_span_;
+    // Indices of the current and previous rows in `region_.rows_`, and of the
+    // current span in `region_.spans_`.
+    size_t row_;
+    size_t previous_row_;
+    size_t row_span_;
     desktop_rect rect_;
   };
 
@@ -132,32 +135,77 @@ public:
 
   void swap(desktop_region *region);
 
+  // Merges rectangles of the region, so iterating over it returns at most
+  // `max_rects` rectangles, while keeping the covered area within
+  // (1 + `max_waste_ratio`) times the current one. Rectangles close to each
+  // other are replaced with their bounding rectangle, cheapest merges first.
+  // The region only grows, and it keeps more than `max_rects` rectangles if
+  // the area limit is reached first.
+  void simplify(int max_rects, double max_waste_ratio);
+
 private:
   // Comparison functions used for std::lower_bound(). Compare left or right
   // edges withs a given `value`.
   static bool compare_span_left(const row_span &r, int32_t value);
   static bool compare_span_right(const row_span &r, int32_t value);
 
-  // Adds a new span to the row, coalescing spans if necessary.
-  static void add_span_to_row(row *r, int32_t left, int32_t right);
+  // Returns the spans of `r`.
+  const row_span *spans_begin(const row &r) const { return spans_.data() + r.first_span; }
+  const row_span *spans_end(const row &r) const { return spans_begin(r) + r.span_count; }
+
+  // Returns true if `r1` and `r2` contain the same spans.
+  bool row_spans_equal(const row &r1, const row &r2) const;
+
+  // Returns the index of the first row which ends below `y`.
+  size_t find_row(int32_t y) const;
+
+  // Splits the row at `index` at `y` into two rows. The upper one stays at
+  // `index` and keeps the spans of the row, the lower one gets a copy of them
+  // at the end of `spans_`.
+  void split_row(size_t index, int32_t y);
+
+  // Moves the spans of the row at `index` to the end of `spans_`, so spans can
+  // be inserted into it.
+  void move_spans_to_end(size_t index);
+
+  // Marks `span_count` spans starting from `first_span` as unused, or drops
+  // them if they are at the end of `spans_`.
+  void release_spans(uint32_t first_span, uint32_t span_count);
+
+  // Replaces the spans of the row at `index` with `spans`.
+  void set_row_spans(size_t index, const row_span_set_t &spans);
+
+  // Removes the row at `index`, its spans become unused.
+  void erase_row(size_t index);
+
+  // Rewrites `spans_` without unused spans if they take too much space.
+  void compact_spans_if_needed();
+
+  // Adds a new span to the row at `index`, coalescing spans if necessary.
+  void add_span_to_row(size_t index, int32_t left, int32_t right);
 
   // Returns true if the `span` exists in the given `row`.
-  static bool is_span_in_row(const row &r, const row_span &rect);
+  bool is_span_in_row(const row &r, const row_span &span) const;
 
   // Calculates the intersection of two sets of spans.
-  static void intersect_rows(const row_span_set_t &set1, const row_span_set_t &set2,
+  static void intersect_rows(const row_span *begin1, const row_span *end1,
+                             const row_span *begin2, const row_span *end2,
                              row_span_set_t *output);
 
-  static void subtract_rows(const row_span_set_t &set_a, const row_span_set_t &set_b,
+  static void subtract_rows(const row_span *begin_a, const row_span *end_a,
+                            const row_span *begin_b, const row_span *end_b,
                             row_span_set_t *output);
 
-  // Merges `row` with the row above it if they contain the same spans. Doesn't
-  // do anything if called with `row` set to rows_.begin() (i.e. first row of
-  // the region). If the rows were merged `row` remains a valid iterator to the
-  // merged row.
-  void merge_with_preceding_row(rows_t::iterator r);
+  // Merges the row at `index` with the row above it if they contain the same
+  // spans. Doesn't do anything if called with `index` set to 0 (i.e. first row
+  // of the region). Returns the index of the row, which is `index` - 1 if the
+  // rows were merged.
+  size_t merge_with_preceding_row(size_t index);
 
   rows_t rows_;
+  row_span_set_t spans_;
+  // Number of elements in `spans_` which are not used by any row.
+  size_t unused_spans_ = 0;
 };
 
 } // namespace base
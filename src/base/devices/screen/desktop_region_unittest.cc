@@ -14,6 +14,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -38,6 +39,22 @@ void compare_region(const desktop_region &region, const desktop_rect rects[], in
   EXPECT_TRUE(it.is_at_end());
 }
 
+int count_rects(const desktop_region &region) {
+  int count = 0;
+  for (desktop_region::iterator it(region); !it.is_at_end(); it.advance()) {
+    ++count;
+  }
+  return count;
+}
+
+int64_t region_area(const desktop_region &region) {
+  int64_t area = 0;
+  for (desktop_region::iterator it(region); !it.is_at_end(); it.advance()) {
+    area += static_cast<int64_t>(it.rect().width()) * it.rect().height();
+  }
+  return area;
+}
+
 } // namespace
 
 // Verify that regions are empty when created.
@@ -736,6 +753,64 @@ TEST(desktop_region_test, subtract_rect_on_same_col) {
   }
 }
 
+TEST(desktop_region_test, simplify_keeps_small_regions) {
+  desktop_region region;
+  region.add_rect(desktop_rect::make_xywh(0, 0, 10, 10));
+  region.add_rect(desktop_rect::make_xywh(100, 100, 10, 10));
+  desktop_region simplified(region);
+  simplified.simplify(2, 0);
+  EXPECT_TRUE(simplified.equals(region));
+}
+
+TEST(desktop_region_test, simplify_bounds_rect_count) {
+  // A 10x10 grid of 4x4 rectangles, 8 pixels apart.
+  desktop_region region;
+  for (int y = 0; y < 10; ++y) {
+    for (int x = 0; x < 10; ++x) {
+      region.add_rect(desktop_rect::make_xywh(x * 8, y * 8, 4, 4));
+    }
+  }
+  ASSERT_EQ(count_rects(region), 100);
+
+  for (int max_rects : {1, 10, 50}) {
+    desktop_region simplified(region);
+    simplified.simplify(max_rects, 4);
+    EXPECT_LE(count_rects(simplified), max_rects);
+    EXPECT_LE(region_area(simplified), region_area(region) * 5);
+
+    // The simplified region still covers the original one.
+    desktop_region uncovered(region);
+    uncovered.subtract(simplified);
+    EXPECT_TRUE(uncovered.is_empty());
+  }
+}
+
+TEST(desktop_region_test, simplify_limits_waste) {
+  desktop_region region;
+  region.add_rect(desktop_rect::make_xywh(0, 0, 10, 10));
+  region.add_rect(desktop_rect::make_xywh(12, 0, 10, 10));
+  region.add_rect(desktop_rect::make_xywh(500, 500, 10, 10));
+
+  // Merging the first two rectangles wastes 10% of the area, merging the third
+  // one far more.
+  desktop_region simplified(region);
+  simplified.simplify(1, 0.1);
+  EXPECT_EQ(count_rects(simplified), 2);
+  EXPECT_EQ(region_area(simplified), region_area(region) + 20);
+
+  simplified = region;
+  simplified.simplify(1, 0.01);
+  EXPECT_TRUE(simplified.equals(region));
+}
+
+// With rows stored in a std::map of heap-allocated rows, on a release build:
+// [       OK ] desktop_region_test.DISABLED_performance (1860 ms)
+// [       OK ] desktop_region_test.DISABLED_performance_block_rows (68 ms)
+// [       OK ] desktop_region_test.DISABLED_performance_intersect_and_subtract (700 ms)
+// With rows and spans stored in flat vectors:
+// [       OK ] desktop_region_test.DISABLED_performance (1290 ms)
+// [       OK ] desktop_region_test.DISABLED_performance_block_rows (42 ms)
+// [       OK ] desktop_region_test.DISABLED_performance_intersect_and_subtract (370 ms)
 TEST(desktop_region_test, DISABLED_performance) {
   for (int c = 0; c < 1000; ++c) {
     desktop_region r;
@@ -754,5 +829,56 @@ TEST(desktop_region_test, DISABLED_performance) {
   }
 }
 
+// Mimics how desktop_capturer_differ_wrapper builds the updated region of a
+// 1920x1080 frame with about a third of its 32x32 blocks changed: rectangles
+// are added row by row, from left to right.
+TEST(desktop_region_test, DISABLED_performance_block_rows) {
+  constexpr int k_block_size = 32;
+  constexpr int k_width_in_blocks = 1920 / k_block_size;
+  constexpr int k_height_in_blocks = (1080 + k_block_size - 1) / k_block_size;
+  std::vector<bool> dirty_blocks(k_width_in_blocks * k_height_in_blocks * 16);
+  for (size_t i = 0; i < dirty_blocks.size(); ++i) {
+    dirty_blocks[i] = random_int(3) == 0;
+  }
+
+  for (int c = 0; c < 1000; ++c) {
+    desktop_region r;
+    auto dirty = dirty_blocks.begin() + (c % 16) * k_width_in_blocks * k_height_in_blocks;
+    for (int y = 0; y < 1080; y += k_block_size) {
+      int first_dirty_x = -1;
+      for (int x = 0; x <= 1920; x += k_block_size) {
+        const bool dirty_block = x < 1920 && *dirty++;
+        if (dirty_block && first_dirty_x == -1) {
+          first_dirty_x = x;
+        } else if (!dirty_block && first_dirty_x != -1) {
+          r.add_rect(desktop_rect::make_ltrb(first_dirty_x, y, x, y + k_block_size));
+          first_dirty_x = -1;
+        }
+      }
+    }
+
+    for (desktop_region::iterator it(r); !it.is_at_end(); it.advance()) {
+    }
+  }
+}
+
+TEST(desktop_region_test, DISABLED_performance_intersect_and_subtract) {
+  for (int c = 0; c < 1000; ++c) {
+    desktop_region r1;
+    desktop_region r2;
+    for (int i = 0; i < 200; ++i) {
+      r1.add_rect(desktop_rect::make_xywh(random_int(1000), random_int(1000),
+                                          5 + random_int(10) * 5, 5 + random_int(10) * 5));
+      r2.add_rect(desktop_rect::make_xywh(random_int(1000), random_int(1000),
+                                          5 + random_int(10) * 5, 5 + random_int(10) * 5));
+    }
+
+    desktop_region intersection;
+    intersection.intersect(r1, r2);
+    r1.subtract(r2);
+    r1.add_region(intersection);
+  }
+}
+
 } // namespace base
 } // namespace traa
@@ -71,5 +71,26 @@ bool block_difference(const uint8_t *image1, const uint8_t *image2, int stride)
   return block_difference(image1, image2, k_differ_block_size, stride);
 }
 
+bool copy_and_block_difference(const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride,
+                               int width, int height) {
+  const int width_bytes = width * k_differ_bytes_per_pixel;
+  bool differ = false;
+  for (int i = 0; i < height; i++) {
+    // Once a difference has been found, the rest of the block only needs to be
+    // copied. Before that, the row is still hot in the cache after the
+    // comparison, so the copy does not read it from memory again.
+    if (differ) {
+      memcpy(dst, src, width_bytes);
+    } else if (width == k_differ_block_size ? vector_difference(src, dst)
+                                            : memcmp(src, dst, width_bytes) != 0) {
+      differ = true;
+      memcpy(dst, src, width_bytes);
+    }
+    src += src_stride;
+    dst += dst_stride;
+  }
+  return differ;
+}
+
 } // namespace base
 } // namespace traa
\ No newline at end of file
@@ -35,6 +35,13 @@ bool block_difference(const uint8_t *image1, const uint8_t *image2, int height,
 // (k_differ_block_size, k_differ_block_size).  Returns whether the blocks differ.
 bool block_difference(const uint8_t *image1, const uint8_t *image2, int stride);
 
+// Low level function to copy a block of pixels of size (`width`, `height`) from
+// `src` into `dst`, comparing it with the previous content of `dst` in the same
+// pass. Rows which are known to be equal are not written. `width` must not be
+// larger than k_differ_block_size. Returns whether the blocks differ.
+bool copy_and_block_difference(const uint8_t *src, int src_stride, uint8_t *dst, int dst_stride,
+                               int width, int height);
+
 } // namespace base
 } // namespace traa
 
@@ -87,5 +87,51 @@ TEST(block_difference_test_first, block_difference) {
   }
 }
 
+TEST(copy_and_block_difference_test_same, copy_and_block_difference) {
+  uint8_t *block1;
+  uint8_t *block2;
+  prepare_buffers(block1, block2);
+
+  const int stride = k_differ_block_size * k_differ_bytes_per_pixel;
+  EXPECT_FALSE(
+      copy_and_block_difference(block1, stride, block2, stride, k_differ_block_size,
+                                k_differ_block_size));
+  EXPECT_EQ(0, memcmp(block1, block2, k_size_of_block));
+}
+
+TEST(copy_and_block_difference_test_mid, copy_and_block_difference) {
+  uint8_t *block1;
+  uint8_t *block2;
+  prepare_buffers(block1, block2);
+  block2[k_size_of_block / 2 + 1] += 1;
+  block2[k_size_of_block - 2] += 1;
+
+  const int stride = k_differ_block_size * k_differ_bytes_per_pixel;
+  EXPECT_TRUE(
+      copy_and_block_difference(block1, stride, block2, stride, k_differ_block_size,
+                                k_differ_block_size));
+  EXPECT_EQ(0, memcmp(block1, block2, k_size_of_block));
+}
+
+TEST(copy_and_block_difference_test_partial, copy_and_block_difference) {
+  uint8_t *block1;
+  uint8_t *block2;
+  prepare_buffers(block1, block2);
+  // Out of the compared width, so it should be neither reported nor copied.
+  block2[k_size_of_block - 1] += 1;
+
+  const int stride = k_differ_block_size * k_differ_bytes_per_pixel;
+  const int width = k_differ_block_size - 1;
+  EXPECT_FALSE(copy_and_block_difference(block1, stride, block2, stride, width,
+                                         k_differ_block_size));
+  EXPECT_NE(block1[k_size_of_block - 1], block2[k_size_of_block - 1]);
+
+  block2[0] += 1;
+  EXPECT_TRUE(copy_and_block_difference(block1, stride, block2, stride, width,
+                                        k_differ_block_size));
+  EXPECT_EQ(block1[0], block2[0]);
+  EXPECT_NE(block1[k_size_of_block - 1], block2[k_size_of_block - 1]);
+}
+
 } // namespace base
 } // namespace traa
@@ -0,0 +1,198 @@
+/*
+ *  Copyright (c) 2013 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "base/devices/screen/linux/x11/mouse_cursor_monitor_x11.h"
+
+#include "base/checks.h"
+#include "base/devices/screen/desktop_frame.h"
+#include "base/devices/screen/desktop_geometry.h"
+#include "base/devices/screen/linux/x11/x_error_trap.h"
+#include "base/logger.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xfixes.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// The number of cursor shapes kept by their serial. Applications rarely use
+// more shapes than this at once.
+constexpr size_t k_max_cached_cursors = 16;
+
+} // namespace
+
+// static
+std::unique_ptr<mouse_cursor>
+mouse_cursor_monitor_x11::create_mouse_cursor(const XFixesCursorImage &image) {
+  std::unique_ptr<desktop_frame> frame(
+      new basic_desktop_frame(desktop_size(image.width, image.height)));
+
+  // Xlib stores 32-bit data in longs, even if longs are 64-bits long.
+  const unsigned long *src = image.pixels;
+  for (int y = 0; y < image.height; y++) {
+    uint32_t *dst =
+        reinterpret_cast<uint32_t *>(frame->get_frame_data_at_pos(desktop_vector(0, y)));
+    for (int x = 0; x < image.width; x++) {
+      dst[x] = static_cast<uint32_t>(*src++);
+    }
+  }
+
+  desktop_vector hotspot(std::min(static_cast<int>(image.width), static_cast<int>(image.xhot)),
+                         std::min(static_cast<int>(image.height), static_cast<int>(image.yhot)));
+  return std::unique_ptr<mouse_cursor>(new mouse_cursor(frame.release(), hotspot));
+}
+
+// static
+std::unique_ptr<mouse_cursor_monitor>
+mouse_cursor_monitor_x11::create_for_screen(const desktop_capture_options &options) {
+  if (!options.x_display_t()) {
+    return nullptr;
+  }
+  return std::unique_ptr<mouse_cursor_monitor>(new mouse_cursor_monitor_x11(
+      options, DefaultRootWindow(options.x_display_t()->display())));
+}
+
+mouse_cursor_monitor_x11::mouse_cursor_monitor_x11(const desktop_capture_options &options,
+                                                   Window window)
+    : x_display_(options.x_display_t()), window_(window) {}
+
+mouse_cursor_monitor_x11::~mouse_cursor_monitor_x11() {
+  if (have_xfixes_) {
+    x_display_->remove_x_event_handler(xfixes_event_base_ + XFixesCursorNotify, this);
+  }
+}
+
+void mouse_cursor_monitor_x11::init(callback *callback, mode mode) {
+  // init() must be called only once.
+  TRAA_DCHECK(!callback_);
+  TRAA_DCHECK(callback);
+
+  callback_ = callback;
+  mode_ = mode;
+
+  have_xfixes_ = XFixesQueryExtension(display(), &xfixes_event_base_, &xfixes_error_base_);
+  if (!have_xfixes_) {
+    LOG_INFO("X server does not support XFixes.");
+    return;
+  }
+
+  // Register for changes to the cursor shape.
+  XFixesSelectCursorInput(display(), window_, XFixesDisplayCursorNotifyMask);
+  x_display_->add_x_event_handler(xfixes_event_base_ + XFixesCursorNotify, this);
+
+  // Report the current cursor on the first capture().
+  notified_serial_ = 0;
+  shape_changed_ = true;
+}
+
+void mouse_cursor_monitor_x11::capture() {
+  TRAA_DCHECK(callback_);
+
+  // Process X11 events, the cursor shape may have changed.
+  x_display_->process_pending_x_events();
+
+  if (shape_changed_) {
+    shape_changed_ = false;
+    unsigned long serial = notified_serial_;
+    const mouse_cursor *cursor = find_or_fetch_cursor(&serial);
+    if (cursor && serial != reported_serial_) {
+      reported_serial_ = serial;
+      callback_->on_mouse_cursor(mouse_cursor::copy_of(*cursor));
+    }
+  }
+
+  if (mode_ != mode::shape_and_position) {
+    return;
+  }
+
+  // Fetch mouse position.
+  int root_x;
+  int root_y;
+  int win_x;
+  int win_y;
+  Window root_window;
+  Window child_window;
+  unsigned int mask;
+
+  x_error_trap error_trap(display());
+  Bool result = XQueryPointer(display(), window_, &root_window, &child_window, &root_x, &root_y,
+                              &win_x, &win_y, &mask);
+  if (!result || error_trap.get_last_error_and_disable() != 0) {
+    return;
+  }
+
+  callback_->on_mouse_cursor_position(desktop_vector(root_x, root_y));
+}
+
+bool mouse_cursor_monitor_x11::on_x_event(const x_event_t &event) {
+  if (!have_xfixes_ || event.type != xfixes_event_base_ + XFixesCursorNotify) {
+    return false;
+  }
+
+  const XFixesCursorNotifyEvent &cursor_event =
+      reinterpret_cast<const XFixesCursorNotifyEvent &>(event);
+  if (cursor_event.subtype != XFixesDisplayCursorNotify) {
+    return false;
+  }
+
+  // Only remember the serial, the image is fetched on the next capture() if it
+  // is not cached.
+  notified_serial_ = cursor_event.cursor_serial;
+  shape_changed_ = true;
+  return true;
+}
+
+const mouse_cursor *mouse_cursor_monitor_x11::find_or_fetch_cursor(unsigned long *serial) {
+  if (*serial != 0) {
+    for (auto it = cursor_cache_.begin(); it != cursor_cache_.end(); ++it) {
+      if (it->first == *serial) {
+        std::rotate(it, it + 1, cursor_cache_.end());
+        return cursor_cache_.back().second.get();
+      }
+    }
+  }
+
+  XFixesCursorImage *image;
+  {
+    x_error_trap error_trap(display());
+    image = XFixesGetCursorImage(display());
+    if (error_trap.get_last_error_and_disable() != 0 && image) {
+      XFree(image);
+      image = nullptr;
+    }
+  }
+  if (!image) {
+    return nullptr;
+  }
+
+  // The cursor may have changed again since the notification, so the image is
+  // cached by its own serial.
+  *serial = image->cursor_serial;
+  cursor_cache_.erase(std::remove_if(cursor_cache_.begin(), cursor_cache_.end(),
+                                     [&](const auto &entry) { return entry.first == *serial; }),
+                      cursor_cache_.end());
+  cursor_cache_.emplace_back(*serial, create_mouse_cursor(*image));
+  XFree(image);
+
+  if (cursor_cache_.size() > k_max_cached_cursors) {
+    cursor_cache_.pop_front();
+  }
+  return cursor_cache_.back().second.get();
+}
+
+} // namespace base
+} // namespace traa
@@ -0,0 +1,91 @@
+/*
+ *  Copyright (c) 2013 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef TRAA_BASE_DEVICES_SCREEN_LINUX_X11_MOUSE_CURSOR_MONITOR_X11_H_
+#define TRAA_BASE_DEVICES_SCREEN_LINUX_X11_MOUSE_CURSOR_MONITOR_X11_H_
+
+#include "base/devices/screen/desktop_capture_options.h"
+#include "base/devices/screen/linux/x11/shared_x_display.h"
+#include "base/devices/screen/mouse_cursor.h"
+#include "base/devices/screen/mouse_cursor_monitor.h"
+
+#include <X11/X.h>
+#include <X11/extensions/Xfixes.h>
+
+#include <deque>
+#include <memory>
+#include <utility>
+
+namespace traa {
+namespace base {
+
+// Captures the cursor of an X11 screen with the XFixes extension.
+//
+// Shape changes are reported by XFixesCursorNotify events dispatched through
+// shared_x_display, so a stable cursor costs one XQueryPointer() per capture()
+// for the position. The converted shapes are cached by their XFixes cursor
+// serial, so switching back to a recently used shape (e.g. between the arrow
+// and the I-beam) does not fetch or convert the image again.
+class mouse_cursor_monitor_x11 : public mouse_cursor_monitor,
+                                 public shared_x_display::x_evt_handler {
+public:
+  // Returns nullptr if `options` has no X display.
+  static std::unique_ptr<mouse_cursor_monitor>
+  create_for_screen(const desktop_capture_options &options);
+
+  mouse_cursor_monitor_x11(const desktop_capture_options &options, Window window);
+  ~mouse_cursor_monitor_x11() override;
+
+  mouse_cursor_monitor_x11(const mouse_cursor_monitor_x11 &) = delete;
+  mouse_cursor_monitor_x11 &operator=(const mouse_cursor_monitor_x11 &) = delete;
+
+  // mouse_cursor_monitor interface.
+  void init(callback *callback, mode mode) override;
+  void capture() override;
+
+  // Converts the cursor `image` of XFixes to a mouse_cursor. Xlib stores the
+  // 32-bit ARGB pixels in longs, even where longs are 64 bits. The hotspot is
+  // clamped to the image.
+  static std::unique_ptr<mouse_cursor> create_mouse_cursor(const XFixesCursorImage &image);
+
+private:
+  // shared_x_display::x_evt_handler interface.
+  bool on_x_event(const x_event_t &event) override;
+
+  x_display_t *display() { return x_display_->display(); }
+
+  // Returns the cached cursor of `serial`, or fetches and caches the current
+  // cursor of the X server if `serial` is not cached. Sets `serial` to the
+  // serial of the returned cursor. Returns nullptr if XFixes fails.
+  const mouse_cursor *find_or_fetch_cursor(unsigned long *serial);
+
+  std::shared_ptr<shared_x_display> x_display_;
+  callback *callback_ = nullptr;
+  mode mode_ = mode::shape_and_position;
+  Window window_;
+
+  bool have_xfixes_ = false;
+  int xfixes_event_base_ = -1;
+  int xfixes_error_base_ = -1;
+
+  // The serial of the cursor last passed to the callback, 0 if none.
+  unsigned long reported_serial_ = 0;
+  // The serial of the latest XFixesCursorNotify, valid if `shape_changed_`.
+  unsigned long notified_serial_ = 0;
+  bool shape_changed_ = false;
+
+  // Recently used cursors by serial, the most recently used last.
+  std::deque<std::pair<unsigned long, std::unique_ptr<mouse_cursor>>> cursor_cache_;
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_LINUX_X11_MOUSE_CURSOR_MONITOR_X11_H_
@@ -0,0 +1,67 @@
+// gtest comes before the X headers, which define None.
+#include <gtest/gtest.h>
+
+#include "base/devices/screen/desktop_frame.h"
+#include "base/devices/screen/linux/x11/mouse_cursor_monitor_x11.h"
+
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+XFixesCursorImage make_cursor_image(int width, int height, int xhot, int yhot,
+                                    std::vector<unsigned long> *pixels) {
+  XFixesCursorImage image = {};
+  image.width = static_cast<unsigned short>(width);
+  image.height = static_cast<unsigned short>(height);
+  image.xhot = static_cast<unsigned short>(xhot);
+  image.yhot = static_cast<unsigned short>(yhot);
+  image.pixels = pixels->data();
+  return image;
+}
+
+} // namespace
+
+TEST(mouse_cursor_monitor_x11_test, converts_long_pixels_to_argb) {
+  const int width = 3;
+  const int height = 2;
+  std::vector<unsigned long> pixels(width * height);
+  for (size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = 0xff000000u | static_cast<uint32_t>(i * 0x10203);
+  }
+  // On LP64 the upper halves of the longs are not part of the pixels.
+  if (sizeof(unsigned long) > sizeof(uint32_t)) {
+    pixels[1] |= ~static_cast<unsigned long>(0xffffffffu);
+  }
+  XFixesCursorImage image = make_cursor_image(width, height, 1, 1, &pixels);
+
+  std::unique_ptr<mouse_cursor> cursor = mouse_cursor_monitor_x11::create_mouse_cursor(image);
+  ASSERT_TRUE(cursor);
+  const desktop_frame *frame = cursor->image();
+  ASSERT_TRUE(frame->size().equals(desktop_size(width, height)));
+  for (int y = 0; y < height; y++) {
+    const uint32_t *row =
+        reinterpret_cast<const uint32_t *>(frame->get_frame_data_at_pos(desktop_vector(0, y)));
+    for (int x = 0; x < width; x++) {
+      EXPECT_EQ(static_cast<uint32_t>(pixels[y * width + x]), row[x]) << x << "," << y;
+    }
+  }
+  EXPECT_TRUE(cursor->hotspot().equals(desktop_vector(1, 1)));
+}
+
+TEST(mouse_cursor_monitor_x11_test, clamps_hotspot_to_image) {
+  std::vector<unsigned long> pixels(4, 0xffffffffu);
+  XFixesCursorImage image = make_cursor_image(2, 2, 5, 7, &pixels);
+
+  std::unique_ptr<mouse_cursor> cursor = mouse_cursor_monitor_x11::create_mouse_cursor(image);
+  ASSERT_TRUE(cursor);
+  EXPECT_TRUE(cursor->hotspot().equals(desktop_vector(2, 2)));
+}
+
+} // namespace base
+} // namespace traa
@@ -0,0 +1,193 @@
+/*
+ *  Copyright (c) 2013 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "base/devices/screen/linux/x11/screen_capturer_x11.h"
+
+#include "base/checks.h"
+#include "base/devices/screen/desktop_capture_types.h"
+#include "base/devices/screen/desktop_frame.h"
+#include "base/logger.h"
+#include "base/utils/time_utils.h"
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+
+#include <string>
+#include <utility>
+
+namespace traa {
+namespace base {
+
+// static
+std::unique_ptr<desktop_capturer>
+screen_capturer_x11::create_raw_screen_capturer(const desktop_capture_options &options) {
+  if (!options.x_display_t()) {
+    return nullptr;
+  }
+  return std::unique_ptr<desktop_capturer>(new screen_capturer_x11(options));
+}
+
+screen_capturer_x11::screen_capturer_x11(const desktop_capture_options &options)
+    : x_display_(options.x_display_t()),
+      session_client_(x_root_capture_session::create_client(options)) {
+  // The session selects the event on the root window.
+  int randr_error_base = 0;
+  if (XRRQueryExtension(display(), &randr_event_base_, &randr_error_base)) {
+    x_display_->add_x_event_handler(randr_event_base_ + RRScreenChangeNotify, this);
+  } else {
+    randr_event_base_ = -1;
+  }
+}
+
+screen_capturer_x11::~screen_capturer_x11() {
+  if (randr_event_base_ >= 0) {
+    x_display_->remove_x_event_handler(randr_event_base_ + RRScreenChangeNotify, this);
+  }
+}
+
+void screen_capturer_x11::start(capture_callback *callback) {
+  TRAA_DCHECK(!callback_);
+  TRAA_DCHECK(callback);
+
+  callback_ = callback;
+  selected_rect_ = get_screen_rect(selected_screen_, &selected_monitor_name_);
+}
+
+bool screen_capturer_x11::get_source_list(source_list_t *sources) {
+  int event_base, error_base;
+  if (!XRRQueryExtension(display(), &event_base, &error_base)) {
+    // Without XRandR the whole screen is the only source.
+    sources->push_back({k_screen_id_full, std::string()});
+    return true;
+  }
+
+  int monitor_count = 0;
+  XRRMonitorInfo *monitors =
+      XRRGetMonitors(display(), DefaultRootWindow(display()), True, &monitor_count);
+  if (!monitors) {
+    LOG_ERROR("failed to get monitors");
+    return false;
+  }
+
+  for (int i = 0; i < monitor_count; ++i) {
+    source_t source;
+    source.id = static_cast<source_id_t>(i);
+    char *monitor_name = XGetAtomName(display(), monitors[i].name);
+    if (monitor_name) {
+      source.title = monitor_name;
+      XFree(monitor_name);
+    }
+    sources->push_back(source);
+  }
+  XRRFreeMonitors(monitors);
+  return true;
+}
+
+bool screen_capturer_x11::select_source(source_id_t id) {
+  Atom name = None;
+  const desktop_rect rect = get_screen_rect(id, &name);
+  if (rect.is_empty()) {
+    return false;
+  }
+
+  selected_screen_ = id;
+  selected_monitor_name_ = name;
+  selected_rect_ = rect;
+  return true;
+}
+
+void screen_capturer_x11::capture_frame() {
+  TRAA_DCHECK(callback_);
+
+  int64_t capture_start_time_nanos = time_nanos();
+
+  // Process X11 events, e.g. the damage of the root window.
+  x_display_->process_pending_x_events();
+
+  if (layout_changed_) {
+    layout_changed_ = false;
+    // The index of the monitor may have changed, its name has not.
+    selected_rect_ = get_screen_rect(selected_screen_, &selected_monitor_name_);
+    if (selected_rect_.is_empty()) {
+      LOG_ERROR("The selected screen is gone.");
+      callback_->on_capture_result(capture_result::error_permanent, nullptr);
+      return;
+    }
+  }
+
+  std::unique_ptr<desktop_frame> frame =
+      session_client_ ? session_client_->capture(selected_rect_) : nullptr;
+  if (!frame) {
+    LOG_WARN("Failed to capture the screen.");
+    callback_->on_capture_result(capture_result::error_temporary, nullptr);
+    return;
+  }
+
+  frame->set_capture_time_ms((time_nanos() - capture_start_time_nanos) /
+                             k_num_nanosecs_per_millisec);
+  frame->set_capturer_id(desktop_capture_id::k_capture_x11);
+  callback_->on_capture_result(capture_result::success, std::move(frame));
+}
+
+bool screen_capturer_x11::on_x_event(const x_event_t &event) {
+  layout_changed_ = true;
+  // Every capturer of the display handles the event.
+  return false;
+}
+
+desktop_rect screen_capturer_x11::get_screen_rect(source_id_t id, Atom *name) {
+  ::Window root = DefaultRootWindow(display());
+  if (id == k_screen_id_full) {
+    XWindowAttributes attributes;
+    if (!XGetWindowAttributes(display(), root, &attributes)) {
+      return desktop_rect();
+    }
+    return desktop_rect::make_wh(attributes.width, attributes.height);
+  }
+
+  int event_base, error_base;
+  if (id < 0 || !XRRQueryExtension(display(), &event_base, &error_base)) {
+    return desktop_rect();
+  }
+
+  int monitor_count = 0;
+  XRRMonitorInfo *monitors = XRRGetMonitors(display(), root, True, &monitor_count);
+  if (!monitors) {
+    return desktop_rect();
+  }
+  int index = -1;
+  if (*name != None) {
+    for (int i = 0; i < monitor_count; ++i) {
+      if (monitors[i].name == *name) {
+        index = i;
+        break;
+      }
+    }
+  } else if (id < monitor_count) {
+    index = static_cast<int>(id);
+    *name = monitors[index].name;
+  }
+  desktop_rect rect;
+  if (index >= 0) {
+    rect = desktop_rect::make_xywh(monitors[index].x, monitors[index].y, monitors[index].width,
+                                   monitors[index].height);
+  }
+  XRRFreeMonitors(monitors);
+  return rect;
+}
+
+// static
+std::unique_ptr<desktop_capturer>
+desktop_capturer::create_raw_screen_capturer(const desktop_capture_options &options) {
+  return screen_capturer_x11::create_raw_screen_capturer(options);
+}
+
+} // namespace base
+} // namespace traa
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2013 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef TRAA_BASE_DEVICES_SCREEN_LINUX_X11_SCREEN_CAPTURER_X11_H_
+#define TRAA_BASE_DEVICES_SCREEN_LINUX_X11_SCREEN_CAPTURER_X11_H_
+
+#include "base/devices/screen/desktop_capture_options.h"
+#include "base/devices/screen/desktop_capturer.h"
+#include "base/devices/screen/desktop_geometry.h"
+#include "base/devices/screen/linux/x11/shared_x_display.h"
+#include "base/devices/screen/linux/x11/x_root_capture_session.h"
+
+#include <X11/X.h>
+
+#include <memory>
+
+namespace traa {
+namespace base {
+
+// Captures a monitor, or the whole X screen, from the root window.
+//
+// The pixels come from the x_root_capture_session of the X display, so several
+// capturers of the same display share one grab per tick. The monitors are
+// listed with XRandR, their ids are their indices like in enum_screens(). The
+// indices change with the layout, so the selected monitor is remembered by its
+// name, and looked up by it again when RRScreenChangeNotify reports a new
+// layout, not on every frame. If it is gone, the capture fails permanently.
+//
+// Not thread-safe. Xlib calls on one display are not serialized, so all the
+// capturers sharing a shared_x_display must be used on one thread.
+class screen_capturer_x11 : public desktop_capturer, public shared_x_display::x_evt_handler {
+public:
+  explicit screen_capturer_x11(const desktop_capture_options &options);
+  ~screen_capturer_x11() override;
+
+  screen_capturer_x11(const screen_capturer_x11 &) = delete;
+  screen_capturer_x11 &operator=(const screen_capturer_x11 &) = delete;
+
+  // Returns nullptr if `options` has no X display.
+  static std::unique_ptr<desktop_capturer>
+  create_raw_screen_capturer(const desktop_capture_options &options);
+
+  // desktop_capturer interface.
+  uint32_t current_capturer_id() const override { return desktop_capture_id::k_capture_x11; }
+  void start(capture_callback *callback) override;
+  void capture_frame() override;
+  bool get_source_list(source_list_t *sources) override;
+  bool select_source(source_id_t id) override;
+
+private:
+  // shared_x_display::x_evt_handler interface.
+  bool on_x_event(const x_event_t &event) override;
+
+  x_display_t *display() { return x_display_->display(); }
+
+  // Returns the rectangle of a monitor in the coordinates of the root window,
+  // the whole root window for k_screen_id_full, or an empty rectangle if there
+  // is no such monitor. The monitor is the one named `*name` if it is not None,
+  // the monitor `id` otherwise, whose name is stored in `*name`.
+  desktop_rect get_screen_rect(source_id_t id, Atom *name);
+
+  capture_callback *callback_ = nullptr;
+
+  std::shared_ptr<shared_x_display> x_display_;
+  std::unique_ptr<x_root_capture_session::client> session_client_;
+
+  int randr_event_base_ = -1;
+  // Set by on_x_event(), from process_pending_x_events() of this or another
+  // capturer of the display, and cleared by capture_frame().
+  bool layout_changed_ = false;
+
+  source_id_t selected_screen_ = k_screen_id_full;
+  // The XRRMonitorInfo::name of `selected_screen_`, None for k_screen_id_full.
+  Atom selected_monitor_name_ = None;
+  desktop_rect selected_rect_;
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_LINUX_X11_SCREEN_CAPTURER_X11_H_
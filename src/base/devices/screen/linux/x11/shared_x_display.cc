@@ -31,7 +31,7 @@ std::shared_ptr<shared_x_display> shared_x_display::create(std::string_view disp
     LOG_ERROR("Unable to open display");
     return nullptr;
   }
-  return std::make_shared<shared_x_display>(display);
+  return std::shared_ptr<shared_x_display>(new shared_x_display(display));
 }
 
 // static
@@ -40,12 +40,12 @@ std::shared_ptr<shared_x_display> shared_x_display::create_default() {
 }
 
 void shared_x_display::add_x_event_handler(int type, x_evt_handler *handler) {
-  std::lock_guard<std::mutex> lock(&mutex_);
+  std::lock_guard<std::mutex> lock(mutex_);
   event_handlers_[type].push_back(handler);
 }
 
 void shared_x_display::remove_x_event_handler(int type, x_evt_handler *handler) {
-  std::lock_guard<std::mutex> lock(&mutex_);
+  std::lock_guard<std::mutex> lock(mutex_);
   x_event_handlers_map_t::iterator handlers = event_handlers_.find(type);
   if (handlers == event_handlers_.end())
     return;
@@ -62,11 +62,11 @@ void shared_x_display::remove_x_event_handler(int type, x_evt_handler *handler)
 void shared_x_display::process_pending_x_events() {
   // Hold reference to `this` to prevent it from being destroyed while
   // processing events.
-  std::shared_ptr<shared_x_display> self = std::shared_from_this();
+  std::shared_ptr<shared_x_display> self = shared_from_this();
 
   // Protect access to `event_handlers_` after incrementing the refcount for
   // `this` to ensure the instance is still valid when the lock is acquired.
-  std::lock_guard<std::mutex> lock(&mutex_);
+  std::lock_guard<std::mutex> lock(mutex_);
 
   // Find the number of events that are outstanding "now."  We don't just loop
   // on XPending because we want to guarantee this terminates.
@@ -12,6 +12,7 @@
 #define TRAA_BASE_DEVICES_SCREEN_LINUX_X11_SHARED_X_DISPLAY_H_
 
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string_view>
 #include <vector>
@@ -0,0 +1,477 @@
+/*
+ *  Copyright (c) 2013 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#include "base/devices/screen/linux/x11/window_capturer_x11.h"
+
+#include "base/checks.h"
+#include "base/devices/screen/desktop_capture_types.h"
+#include "base/devices/screen/desktop_frame.h"
+#include "base/devices/screen/linux/x11/x_error_trap.h"
+#include "base/devices/screen/linux/x11/x_window_list_utils.h"
+#include "base/logger.h"
+#include "base/utils/time_utils.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/composite.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace traa {
+namespace base {
+
+// static
+std::unique_ptr<desktop_capturer>
+window_capturer_x11::create_raw_window_capturer(const desktop_capture_options &options) {
+  if (!options.x_display_t()) {
+    return nullptr;
+  }
+  return std::unique_ptr<desktop_capturer>(new window_capturer_x11(options));
+}
+
+window_capturer_x11::window_capturer_x11(const desktop_capture_options &options)
+    : x_display_(options.x_display_t()), atom_cache_(display()) {
+  int event_base, error_base, major_version, minor_version;
+  if (XCompositeQueryExtension(display(), &event_base, &error_base) &&
+      XCompositeQueryVersion(display(), &major_version, &minor_version) &&
+      // XCompositeNameWindowPixmap() requires version 0.2
+      (major_version > 0 || minor_version >= 2)) {
+    has_composite_extension_ = true;
+  } else {
+    LOG_INFO("Xcomposite extension not available or too old.");
+  }
+
+#if defined(TRAA_ENABLE_XDAMAGE)
+  if (options.use_update_notifications()) {
+    use_damage_ = XDamageQueryExtension(display(), &damage_event_base_, &damage_error_base_);
+    if (use_damage_) {
+      damage_region_ = XFixesCreateRegion(display(), nullptr, 0);
+      x_display_->add_x_event_handler(damage_event_base_ + XDamageNotify, this);
+    } else {
+      LOG_INFO("X server does not support XDamage.");
+    }
+  }
+#endif
+
+  x_display_->add_x_event_handler(ConfigureNotify, this);
+  x_display_->add_x_event_handler(ReparentNotify, this);
+  x_display_->add_x_event_handler(MapNotify, this);
+  x_display_->add_x_event_handler(DestroyNotify, this);
+  x_display_->add_x_event_handler(PropertyNotify, this);
+}
+
+window_capturer_x11::~window_capturer_x11() {
+  release_window();
+
+  x_display_->remove_x_event_handler(ConfigureNotify, this);
+  x_display_->remove_x_event_handler(ReparentNotify, this);
+  x_display_->remove_x_event_handler(MapNotify, this);
+  x_display_->remove_x_event_handler(DestroyNotify, this);
+  x_display_->remove_x_event_handler(PropertyNotify, this);
+#if defined(TRAA_ENABLE_XDAMAGE)
+  if (use_damage_) {
+    x_display_->remove_x_event_handler(damage_event_base_ + XDamageNotify, this);
+    XFixesDestroyRegion(display(), damage_region_);
+  }
+#endif
+}
+
+void window_capturer_x11::start(capture_callback *callback) {
+  TRAA_DCHECK(!callback_);
+  TRAA_DCHECK(callback);
+
+  callback_ = callback;
+}
+
+bool window_capturer_x11::get_source_list(source_list_t *sources) {
+  std::vector<traa_screen_source_info> infos;
+  if (x_window_list_utils::enum_windows(traa_size(0, 0), traa_size(0, 0),
+                                        TRAA_SCREEN_SOURCE_FLAG_NONE,
+                                        infos) != traa_error::TRAA_ERROR_NONE) {
+    return false;
+  }
+
+  for (const traa_screen_source_info &info : infos) {
+    source_t source;
+    source.id = static_cast<source_id_t>(info.id);
+    source.title = info.title;
+    sources->push_back(source);
+  }
+  return true;
+}
+
+bool window_capturer_x11::select_source(source_id_t id) {
+  release_window();
+
+  const ::Window window = static_cast<::Window>(id);
+  {
+    x_error_trap error_trap(display());
+    // Tell the X server to send us moving, resizing, mapping and destruction
+    // events of the window, and the changes of its WM_STATE.
+    XSelectInput(display(), window, StructureNotifyMask | PropertyChangeMask);
+
+    // The position in real ConfigureNotify events is relative to the parent.
+    ::Window parent = 0;
+    ::Window *children = nullptr;
+    unsigned int children_num = 0;
+    if (XQueryTree(display(), window, &root_window_, &parent, &children, &children_num)) {
+      parent_is_root_ = parent == root_window_;
+      if (children) {
+        XFree(children);
+      }
+    }
+
+    // In addition to needing X11 server-side support for Xcomposite, it
+    // actually needs to be turned on for the window. If the user has modern
+    // hardware/drivers but isn't using a compositing window manager, that won't
+    // be the case. Here we automatically turn it on, release_window() turns it
+    // off again.
+    if (has_composite_extension_) {
+      XCompositeRedirectWindow(display(), window, CompositeRedirectAutomatic);
+    }
+    XSync(display(), False);
+    if (error_trap.get_last_error_and_disable() != 0) {
+      LOG_ERROR("failed to select window {}", window);
+      return false;
+    }
+  }
+
+  selected_window_ = window;
+  window_destroyed_ = false;
+  if (!init_pixel_buffer()) {
+    release_window();
+    return false;
+  }
+  is_minimized_ = x_window_list_utils::get_window_state(&atom_cache_, window) == IconicState;
+
+#if defined(TRAA_ENABLE_XDAMAGE)
+  if (use_damage_) {
+    x_error_trap error_trap(display());
+    damage_handle_ = XDamageCreate(display(), window, XDamageReportNonEmpty);
+    XSync(display(), False);
+    if (error_trap.get_last_error_and_disable() != 0) {
+      LOG_WARN("failed to create damage for window {}, capture the whole window", window);
+      damage_handle_ = 0;
+    }
+  }
+#endif
+
+  return true;
+}
+
+void window_capturer_x11::capture_frame() {
+  TRAA_DCHECK(callback_);
+
+  int64_t capture_start_time_nanos = time_nanos();
+
+  // Process X11 events, the window may have been resized or destroyed.
+  x_display_->process_pending_x_events();
+
+  if (!selected_window_ || window_destroyed_) {
+    LOG_ERROR("The window is no longer valid.");
+    callback_->on_capture_result(capture_result::error_permanent, nullptr);
+    return;
+  }
+
+  if (!has_composite_extension_) {
+    // Without the Xcomposite extension we capture when the whole window is
+    // visible on screen and not covered by any other window. This is not
+    // something we want so instead, just bail out.
+    LOG_ERROR("No Xcomposite extension detected.");
+    callback_->on_capture_result(capture_result::error_permanent, nullptr);
+    return;
+  }
+
+  if (is_minimized_) {
+    // Window is in minimized. Return a 1x1 frame as same as OSX/Win does.
+    std::unique_ptr<desktop_frame> frame(new basic_desktop_frame(desktop_size(1, 1)));
+    callback_->on_capture_result(capture_result::success, std::move(frame));
+    return;
+  }
+
+  if (pixel_buffer_stale_ && !init_pixel_buffer()) {
+    LOG_WARN("Failed to reinitialize the pixel buffer of the window.");
+    callback_->on_capture_result(capture_result::error_temporary, nullptr);
+    return;
+  }
+
+  if (window_origin_stale_) {
+    // Only after the window moved within its parent, which is rare.
+    x_error_trap error_trap(display());
+    int x = 0;
+    int y = 0;
+    ::Window child;
+    const bool translated =
+        XTranslateCoordinates(display(), selected_window_, root_window_, 0, 0, &x, &y, &child);
+    if (error_trap.get_last_error_and_disable() == 0 && translated) {
+      window_origin_.set(x, y);
+      window_origin_stale_ = false;
+    }
+  }
+
+  queue_.move_to_next_frame();
+  const bool frame_reused =
+      queue_.current_frame() &&
+      queue_.current_frame()->size().equals(x_server_pixel_buffer_.window_size());
+  if (!frame_reused) {
+    std::unique_ptr<desktop_frame> frame(
+        new basic_desktop_frame(x_server_pixel_buffer_.window_size()));
+    queue_.replace_current_frame(shared_desktop_frame::wrap(std::move(frame)));
+  }
+
+  desktop_region updated_region;
+  bool updated_region_precomputed = false;
+  if (!capture_updated_region(frame_reused, &updated_region, &updated_region_precomputed)) {
+    LOG_WARN("Failed to capture window content.");
+    // The frames of the queue may be partially updated.
+    queue_.reset();
+    last_updated_region_.clear();
+    callback_->on_capture_result(capture_result::error_temporary, nullptr);
+    return;
+  }
+  last_updated_region_ = updated_region;
+
+  std::unique_ptr<desktop_frame> result = queue_.current_frame()->share();
+  result->mutable_updated_region()->swap(&updated_region);
+  result->set_top_left(window_origin_);
+  result->set_capture_time_ms((time_nanos() - capture_start_time_nanos) /
+                              k_num_nanosecs_per_millisec);
+  result->set_capturer_id(desktop_capture_id::k_capture_x11);
+  result->set_updated_region_precomputed(updated_region_precomputed);
+  callback_->on_capture_result(capture_result::success, std::move(result));
+}
+
+bool window_capturer_x11::capture_updated_region(bool frame_reused,
+                                                 desktop_region *updated_region, bool *compared) {
+  shared_desktop_frame *frame = queue_.current_frame();
+  shared_desktop_frame *previous_frame = queue_.previous_frame();
+  const desktop_rect frame_rect = desktop_rect::make_size(frame->size());
+  const bool has_previous_frame = previous_frame && previous_frame->size().equals(frame->size());
+
+  // Without a previous frame of the same size the current one may hold
+  // anything, so the whole window is read. Without damage the whole window is
+  // read too, and compared with a reused frame while being copied.
+  const bool capture_whole_window = !has_damage() || !has_previous_frame;
+  *compared = !has_damage() && has_previous_frame && frame_reused;
+  desktop_region read_region;
+
+#if defined(TRAA_ENABLE_XDAMAGE)
+  if (damage_handle_) {
+    // Atomically fetch and clear the damage region.
+    XDamageSubtract(display(), damage_handle_, None, damage_region_);
+    if (!capture_whole_window) {
+      int rects_num = 0;
+      XRectangle bounds;
+      XRectangle *rects =
+          XFixesFetchRegionAndBounds(display(), damage_region_, &rects_num, &bounds);
+      for (int i = 0; i < rects_num; ++i) {
+        read_region.add_rect(
+            desktop_rect::make_xywh(rects[i].x, rects[i].y, rects[i].width, rects[i].height));
+      }
+      if (rects) {
+        XFree(rects);
+      }
+      read_region.intersect_with(frame_rect);
+    }
+  }
+#endif
+
+  if (capture_whole_window) {
+    read_region.set_rect(frame_rect);
+  }
+  if (!capture_whole_window || *compared) {
+    // The current frame lacks the changes captured into the previous one, copy
+    // the ones which are not captured again. A compared frame has to match the
+    // previous one everywhere.
+    desktop_region copy_region = last_updated_region_;
+    if (!*compared) {
+      copy_region.subtract(read_region);
+    }
+    copy_region.intersect_with(frame_rect);
+    for (desktop_region::iterator it(copy_region); !it.is_at_end(); it.advance()) {
+      frame->copy_pixels_from(*previous_frame, it.rect().top_left(), it.rect());
+    }
+  }
+
+  // Nothing was damaged, the copied changes bring the frame up to date and the
+  // X server does not have to be asked for anything.
+  if (read_region.is_empty()) {
+    return true;
+  }
+
+  x_server_pixel_buffer_.synchronize();
+  for (desktop_region::iterator it(read_region); !it.is_at_end(); it.advance()) {
+    if (!x_server_pixel_buffer_.capture_rect(it.rect(), frame,
+                                             *compared ? updated_region : nullptr)) {
+      return false;
+    }
+  }
+  if (!*compared) {
+    updated_region->swap(&read_region);
+  }
+  return true;
+}
+
+bool window_capturer_x11::init_pixel_buffer() {
+  if (composite_pixmap_) {
+    // The pixmap keeps the content of the window before the resize, a new one
+    // is named for the current content.
+    XFreePixmap(display(), composite_pixmap_);
+    composite_pixmap_ = 0;
+  }
+
+  if (has_composite_extension_) {
+    // Naming fails while the window is unmapped, the window itself is read
+    // then.
+    x_error_trap error_trap(display());
+    Pixmap pixmap = XCompositeNameWindowPixmap(display(), selected_window_);
+    XSync(display(), False);
+    if (error_trap.get_last_error_and_disable() == 0) {
+      composite_pixmap_ = pixmap;
+    }
+  }
+
+  if (!x_server_pixel_buffer_.init(&atom_cache_, selected_window_, composite_pixmap_)) {
+    LOG_ERROR("failed to init pixel buffer for window {}", selected_window_);
+    // Try again on the next capture.
+    pixel_buffer_stale_ = true;
+    return false;
+  }
+  pixel_buffer_stale_ = false;
+  window_origin_ = x_server_pixel_buffer_.window_rect().top_left();
+  window_origin_stale_ = false;
+
+  // The frames of the queue are of the previous size.
+  queue_.reset();
+  last_updated_region_.clear();
+  return true;
+}
+
+void window_capturer_x11::release_window() {
+  if (!selected_window_) {
+    return;
+  }
+
+  x_server_pixel_buffer_.release();
+  queue_.reset();
+  last_updated_region_.clear();
+
+  {
+    // The window, and so its damage, may be destroyed already.
+    x_error_trap error_trap(display());
+    if (composite_pixmap_) {
+      XFreePixmap(display(), composite_pixmap_);
+    }
+#if defined(TRAA_ENABLE_XDAMAGE)
+    if (damage_handle_) {
+      XDamageDestroy(display(), damage_handle_);
+    }
+#endif
+    if (!window_destroyed_) {
+      XSelectInput(display(), selected_window_, NoEventMask);
+      if (has_composite_extension_) {
+        XCompositeUnredirectWindow(display(), selected_window_, CompositeRedirectAutomatic);
+      }
+    }
+    XSync(display(), False);
+    error_trap.get_last_error_and_disable();
+  }
+
+  composite_pixmap_ = 0;
+#if defined(TRAA_ENABLE_XDAMAGE)
+  damage_handle_ = 0;
+#endif
+  selected_window_ = 0;
+  window_destroyed_ = false;
+  window_origin_stale_ = false;
+  root_window_ = 0;
+  parent_is_root_ = false;
+  pixel_buffer_stale_ = false;
+  is_minimized_ = false;
+}
+
+bool window_capturer_x11::on_x_event(const x_event_t &event) {
+  if (!selected_window_) {
+    return false;
+  }
+
+#if defined(TRAA_ENABLE_XDAMAGE)
+  if (use_damage_ && event.type == damage_event_base_ + XDamageNotify) {
+    // The damage is fetched by capture_frame(), the event is only consumed.
+    const XDamageNotifyEvent *damage_event = reinterpret_cast<const XDamageNotifyEvent *>(&event);
+    return damage_event->damage == damage_handle_;
+  }
+#endif
+
+  switch (event.type) {
+  case ConfigureNotify: {
+    const XConfigureEvent &xce = event.xconfigure;
+    if (xce.window != selected_window_) {
+      return false;
+    }
+    // The composite pixmap of the window is replaced when it is resized.
+    if (!desktop_size(xce.width, xce.height).equals(x_server_pixel_buffer_.window_size())) {
+      pixel_buffer_stale_ = true;
+    }
+    // Window managers send synthetic events in root coordinates when they move
+    // the frame of the window, see ICCCM 4.1.5. The position of real events is
+    // relative to the parent. Both are the outer corner of the border.
+    if (xce.send_event || parent_is_root_) {
+      window_origin_.set(xce.x + xce.border_width, xce.y + xce.border_width);
+      window_origin_stale_ = false;
+    } else {
+      window_origin_stale_ = true;
+    }
+    return true;
+  }
+  case ReparentNotify:
+    if (event.xreparent.window != selected_window_) {
+      return false;
+    }
+    parent_is_root_ = event.xreparent.parent == root_window_;
+    window_origin_stale_ = true;
+    return true;
+  case MapNotify:
+    if (event.xmap.window != selected_window_) {
+      return false;
+    }
+    // Unmapped windows have no pixmap, name the new one.
+    pixel_buffer_stale_ = true;
+    return true;
+  case DestroyNotify:
+    if (event.xdestroywindow.window != selected_window_) {
+      return false;
+    }
+    window_destroyed_ = true;
+    return true;
+  case PropertyNotify:
+    if (event.xproperty.window != selected_window_ ||
+        event.xproperty.atom != atom_cache_.wm_state()) {
+      return false;
+    }
+    is_minimized_ =
+        x_window_list_utils::get_window_state(&atom_cache_, selected_window_) == IconicState;
+    return true;
+  default:
+    return false;
+  }
+}
+
+// static
+std::unique_ptr<desktop_capturer>
+desktop_capturer::create_raw_window_capturer(const desktop_capture_options &options) {
+  return window_capturer_x11::create_raw_window_capturer(options);
+}
+
+} // namespace base
+} // namespace traa
@@ -0,0 +1,141 @@
+/*
+ *  Copyright (c) 2013 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef TRAA_BASE_DEVICES_SCREEN_LINUX_X11_WINDOW_CAPTURER_X11_H_
+#define TRAA_BASE_DEVICES_SCREEN_LINUX_X11_WINDOW_CAPTURER_X11_H_
+
+#include "base/devices/screen/desktop_capture_options.h"
+#include "base/devices/screen/desktop_capturer.h"
+#include "base/devices/screen/desktop_geometry.h"
+#include "base/devices/screen/desktop_region.h"
+#include "base/devices/screen/linux/x11/shared_x_display.h"
+#include "base/devices/screen/linux/x11/x_atom_cache.h"
+#include "base/devices/screen/linux/x11/x_server_pixel_buffer.h"
+#include "base/devices/screen/screen_capture_frame_queue.h"
+#include "base/devices/screen/shared_desktop_frame.h"
+
+#include <X11/X.h>
+#include <X11/extensions/Xfixes.h>
+#if defined(TRAA_ENABLE_XDAMAGE)
+#include <X11/extensions/Xdamage.h>
+#endif
+
+#include <memory>
+
+namespace traa {
+namespace base {
+
+// Captures a single window with the XComposite extension.
+//
+// The window is redirected to off-screen storage, and its pixels are read from
+// the pixmap XCompositeNameWindowPixmap() names for it, through the XShm path of
+// x_server_pixel_buffer. The content stays available while other windows cover
+// the window, and the rest of the screen is never read.
+//
+// If desktop_capture_options::use_update_notifications() is set, an XDamage
+// object tracks the changes of the window, and only the damaged rectangles are
+// read again. The updated region of the frames is exact then, instead of the
+// whole window.
+//
+// The position of the window comes from its ConfigureNotify events, so a moved
+// window does not cost a round trip per frame.
+class window_capturer_x11 : public desktop_capturer, public shared_x_display::x_evt_handler {
+public:
+  explicit window_capturer_x11(const desktop_capture_options &options);
+  ~window_capturer_x11() override;
+
+  window_capturer_x11(const window_capturer_x11 &) = delete;
+  window_capturer_x11 &operator=(const window_capturer_x11 &) = delete;
+
+  // Returns nullptr if `options` has no X display.
+  static std::unique_ptr<desktop_capturer>
+  create_raw_window_capturer(const desktop_capture_options &options);
+
+  // desktop_capturer interface.
+  uint32_t current_capturer_id() const override { return desktop_capture_id::k_capture_x11; }
+  void start(capture_callback *callback) override;
+  void capture_frame() override;
+  bool get_source_list(source_list_t *sources) override;
+  bool select_source(source_id_t id) override;
+
+private:
+  // shared_x_display::x_evt_handler interface.
+  bool on_x_event(const x_event_t &event) override;
+
+  x_display_t *display() { return x_display_->display(); }
+
+  // Names the composite pixmap of the selected window and initializes the
+  // pixel buffer from it. Falls back to reading the window itself if the
+  // pixmap can not be named, e.g. while the window is unmapped.
+  bool init_pixel_buffer();
+
+  // Stops capturing the selected window and frees its X resources.
+  void release_window();
+
+  // Whether XDamage tracks the changes of the selected window.
+  bool has_damage() const {
+#if defined(TRAA_ENABLE_XDAMAGE)
+    return damage_handle_ != 0;
+#else
+    return false;
+#endif
+  }
+
+  // Captures the parts of the current frame which changed since it was last
+  // captured into `updated_region`. `frame_reused` tells whether the current
+  // frame holds the window as of two captures ago. `compared` is set if
+  // `updated_region` comes from comparing the pixels. Returns false if the
+  // window can not be read.
+  bool capture_updated_region(bool frame_reused, desktop_region *updated_region, bool *compared);
+
+  capture_callback *callback_ = nullptr;
+
+  std::shared_ptr<shared_x_display> x_display_;
+  x_atom_cache atom_cache_;
+
+  bool has_composite_extension_ = false;
+#if defined(TRAA_ENABLE_XDAMAGE)
+  bool use_damage_ = false;
+  int damage_event_base_ = -1;
+  int damage_error_base_ = -1;
+#endif
+
+  ::Window selected_window_ = 0;
+  // The pixmap named for `selected_window_`, 0 if none.
+  Pixmap composite_pixmap_ = 0;
+#if defined(TRAA_ENABLE_XDAMAGE)
+  Damage damage_handle_ = 0;
+  XserverRegion damage_region_ = 0;
+#endif
+
+  // Set by the X events of `selected_window_`.
+  bool window_destroyed_ = false;
+  // The position of `selected_window_` on the root window, stale if the window
+  // moved within a parent other than the root window.
+  desktop_vector window_origin_;
+  bool window_origin_stale_ = false;
+  ::Window root_window_ = 0;
+  bool parent_is_root_ = false;
+  bool pixel_buffer_stale_ = false;
+  bool is_minimized_ = false;
+
+  x_server_pixel_buffer x_server_pixel_buffer_;
+
+  // The frames are reused, so only the damaged rectangles have to be read.
+  screen_capture_frame_queue<shared_desktop_frame> queue_;
+  // The region updated in the previous frame, which the current frame of the
+  // queue lacks.
+  desktop_region last_updated_region_;
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_LINUX_X11_WINDOW_CAPTURER_X11_H_
@@ -10,32 +10,82 @@
 
 #include "base/devices/screen/linux/x11/x_atom_cache.h"
 
+#include <string.h>
+
 namespace traa {
 namespace base {
 
-x_atom_cache::x_atom_cache(::Display *display) : display_(display) {}
+inline namespace {
+
+// The names of the atoms, in the order of x_atom_cache::atom_id.
+const char *const k_atom_names[] = {
+    "WM_STATE",      "_NET_WM_WINDOW_TYPE", "_NET_WM_WINDOW_TYPE_NORMAL",
+    "_ICC_PROFILE",  "_NET_WM_PID",         "_NET_WM_ICON",
+    "_NET_WM_NAME",  "_NET_WM_STATE",       "_NET_CLIENT_LIST",
+};
+
+} // namespace
+
+x_atom_cache::x_atom_cache(::Display *display) : display_(display) { intern_missing_atoms(); }
+
+x_atom_cache::x_atom_cache(::Display *display, const x_atom_cache &other) : display_(display) {
+  memcpy(atoms_, other.atoms_, sizeof(atoms_));
+}
 
 x_atom_cache::~x_atom_cache() = default;
 
 ::Display *x_atom_cache::display() const { return display_; }
 
-Atom x_atom_cache::wm_state() { return create_if_not_exist(&wm_state_, "WM_STATE"); }
+Atom x_atom_cache::wm_state() { return get(k_wm_state); }
 
-Atom x_atom_cache::window_type() {
-  return create_if_not_exist(&window_type_, "_NET_WM_WINDOW_TYPE");
-}
+Atom x_atom_cache::window_type() { return get(k_window_type); }
+
+Atom x_atom_cache::window_type_normal() { return get(k_window_type_normal); }
+
+Atom x_atom_cache::icc_profile() { return get(k_icc_profile); }
 
-Atom x_atom_cache::window_type_normal() {
-  return create_if_not_exist(&window_type_normal_, "_NET_WM_WINDOW_TYPE_NORMAL");
+Atom x_atom_cache::net_wm_pid() { return get(k_net_wm_pid); }
+
+Atom x_atom_cache::net_wm_icon() { return get(k_net_wm_icon); }
+
+Atom x_atom_cache::net_wm_name() { return get(k_net_wm_name); }
+
+Atom x_atom_cache::net_wm_state() { return get(k_net_wm_state); }
+
+Atom x_atom_cache::net_client_list() { return get(k_net_client_list); }
+
+Atom x_atom_cache::get(atom_id id) {
+  if (atoms_[id] == None) {
+    intern_missing_atoms();
+  }
+  return atoms_[id];
 }
 
-Atom x_atom_cache::icc_profile() { return create_if_not_exist(&icc_profile_, "_ICC_PROFILE"); }
+void x_atom_cache::intern_missing_atoms() {
+  static_assert(sizeof(k_atom_names) / sizeof(k_atom_names[0]) == k_atom_count,
+                "every atom needs a name");
+
+  char *names[k_atom_count];
+  int indices[k_atom_count];
+  int count = 0;
+  for (int i = 0; i < k_atom_count; i++) {
+    if (atoms_[i] == None) {
+      names[count] = const_cast<char *>(k_atom_names[i]);
+      indices[count] = i;
+      count++;
+    }
+  }
+  if (count == 0) {
+    return;
+  }
 
-Atom x_atom_cache::create_if_not_exist(Atom *atom, const char *name) {
-  if (*atom == None) {
-    *atom = XInternAtom(display(), name, True);
+  // Atoms which do not exist are returned as None, and are asked for again
+  // next time as some client may have created them in the meantime.
+  Atom atoms[k_atom_count];
+  XInternAtoms(display_, names, count, True, atoms);
+  for (int i = 0; i < count; i++) {
+    atoms_[indices[i]] = atoms[i];
   }
-  return *atom;
 }
 
 } // namespace base
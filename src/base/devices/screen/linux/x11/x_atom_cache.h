@@ -17,28 +17,58 @@
 namespace traa {
 namespace base {
 
-// A cache of Atom. Each Atom object is created on demand.
+// A cache of Atom. The well-known atoms are interned with one XInternAtoms()
+// round trip when the cache is created. The atoms which do not exist on the X
+// server yet are None, and are interned again, all in one round trip, when one
+// of them is asked for.
+//
+// Atoms are global to the X server, so a cache can be copied to another
+// connection to the same server without any round trip.
 class x_atom_cache final {
 public:
   explicit x_atom_cache(::Display *display);
+  // Copies the atoms of `other`, which must be connected to the same X server
+  // as `display`.
+  x_atom_cache(::Display *display, const x_atom_cache &other);
   ~x_atom_cache();
 
+  x_atom_cache(const x_atom_cache &) = delete;
+  x_atom_cache &operator=(const x_atom_cache &) = delete;
+
   ::Display *display() const;
 
   Atom wm_state();
   Atom window_type();
   Atom window_type_normal();
   Atom icc_profile();
+  Atom net_wm_pid();
+  Atom net_wm_icon();
+  Atom net_wm_name();
+  Atom net_wm_state();
+  Atom net_client_list();
 
 private:
-  // If |*atom| is None, this function uses XInternAtom() to retrieve an Atom.
-  Atom create_if_not_exist(Atom *atom, const char *name);
+  enum atom_id {
+    k_wm_state,
+    k_window_type,
+    k_window_type_normal,
+    k_icc_profile,
+    k_net_wm_pid,
+    k_net_wm_icon,
+    k_net_wm_name,
+    k_net_wm_state,
+    k_net_client_list,
+    k_atom_count,
+  };
+
+  // Returns the atom `id`, interning the missing atoms first if it is None.
+  Atom get(atom_id id);
+
+  // Interns all the atoms which are None with one XInternAtoms() call.
+  void intern_missing_atoms();
 
   ::Display *const display_;
-  Atom wm_state_ = None;
-  Atom window_type_ = None;
-  Atom window_type_normal_ = None;
-  Atom icc_profile_ = None;
+  Atom atoms_[k_atom_count] = {};
 };
 
 } // namespace base
@@ -15,43 +15,93 @@
 #include <stddef.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 
 namespace traa {
 namespace base {
 
 inline namespace {
 
-static int g_last_xserver_error_code = 0;
-static std::atomic<Display *> g_display_for_error_handler = nullptr;
+// The maximum number of displays trapping errors at the same time.
+constexpr int k_max_trapped_displays = 16;
 
+// The display and the last error of an active trap. The error handler only
+// touches atomics, since it runs while Xlib holds its own locks.
+struct trap_slot {
+  std::atomic<Display *> display{nullptr};
+  std::atomic<int> error_code{0};
+};
+
+static trap_slot g_trap_slots[k_max_trapped_displays];
+
+// Guards the slot assignment and the installation of the error handler.
 static std::mutex g_mutex_;
+static std::condition_variable g_slot_released_;
+static int g_active_traps = 0;
+static XErrorHandler g_original_error_handler = nullptr;
+
+// Returns the index of the slot of `display`, or of a free slot if `display` is
+// nullptr, or -1.
+int find_slot(Display *display) {
+  for (int i = 0; i < k_max_trapped_displays; i++) {
+    if (g_trap_slots[i].display.load() == display) {
+      return i;
+    }
+  }
+  return -1;
+}
 
 int xserver_error_handler(Display *display, XErrorEvent *error_event) {
-  g_last_xserver_error_code = error_event->error_code;
+  // Errors of displays without an active trap are ignored.
+  const int slot = find_slot(display);
+  if (slot >= 0) {
+    g_trap_slots[slot].error_code.store(error_event->error_code);
+  }
   return 0;
 }
 
 } // namespace
 
-x_error_trap::x_error_trap(Display *display) : mutex_lock_(g_mutex_) {
-  // We don't expect this class to be used in a nested fashion so therefore
-  // g_display_for_error_handler should never be valid here.
-  g_display_for_error_handler.store(display);
-  g_last_xserver_error_code = 0;
-  original_error_handler_ = XSetErrorHandler(&xserver_error_handler);
+x_error_trap::x_error_trap(Display *display) {
+  std::unique_lock<std::mutex> lock(g_mutex_);
+  // We don't expect this class to be used in a nested fashion, but other
+  // threads may trap errors of the same display.
+  g_slot_released_.wait(lock, [display]() {
+    return find_slot(display) < 0 && find_slot(nullptr) >= 0;
+  });
+  slot_ = find_slot(nullptr);
+  g_trap_slots[slot_].error_code.store(0);
+  g_trap_slots[slot_].display.store(display);
+  if (g_active_traps++ == 0) {
+    g_original_error_handler = XSetErrorHandler(&xserver_error_handler);
+  }
 }
 
 int x_error_trap::get_last_error_and_disable() {
-  g_display_for_error_handler.store(nullptr);
-  XSetErrorHandler(original_error_handler_);
-  if(g_last_xserver_error_code != 0) {
-    LOG_ERROR("X11 error code: {}", g_last_xserver_error_code);
+  if (slot_ < 0) {
+    return last_error_;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(g_mutex_);
+    last_error_ = g_trap_slots[slot_].error_code.load();
+    g_trap_slots[slot_].display.store(nullptr);
+    slot_ = -1;
+    if (--g_active_traps == 0) {
+      XSetErrorHandler(g_original_error_handler);
+    }
+  }
+  g_slot_released_.notify_all();
+
+  if (last_error_ != 0) {
+    LOG_ERROR("X11 error code: {}", last_error_);
   }
-  return g_last_xserver_error_code;
+  return last_error_;
 }
 
 x_error_trap::~x_error_trap() {
-  if (g_display_for_error_handler.load() != nullptr)
+  if (slot_ >= 0)
     get_last_error_and_disable();
 }
 
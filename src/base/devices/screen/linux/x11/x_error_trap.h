@@ -13,13 +13,14 @@
 
 #include <X11/Xlib.h>
 
-#include <mutex>
-
 namespace traa {
 namespace base {
 
 // Helper class that registers an X Window error handler. Caller can use
 // get_last_error_and_disable() to get the last error that was caught, if any.
+//
+// Errors are caught per display, so threads using their own connections can
+// trap errors at the same time. Traps of the same display are serialized.
 class x_error_trap {
 public:
   explicit x_error_trap(Display *display);
@@ -34,8 +35,10 @@ public:
   int get_last_error_and_disable();
 
 private:
-  std::unique_lock<std::mutex> mutex_lock_;
-  XErrorHandler original_error_handler_ = nullptr;
+  // The index of the slot catching the errors of the display, or -1 once
+  // disabled.
+  int slot_ = -1;
+  int last_error_ = 0;
 };
 
 } // namespace base
@@ -0,0 +1,157 @@
+#include "base/devices/screen/linux/x11/x_image_converter.h"
+
+#include "base/arch.h"
+#include "base/checks.h"
+#include "base/system/cpu_features_wrapper.h"
+
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+#include "base/devices/screen/linux/x11/x_image_converter_sse2.h"
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+
+#include <string.h>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// Converts pixels [`first`, `width`) of a row.
+using convert_pixels_proc_t = void (*)(const uint8_t *src, uint32_t *dst, int first, int width);
+
+// Converts the first pixels of a row of `width` pixels with SIMD instructions,
+// and returns the number of pixels converted.
+using convert_row_proc_t = int (*)(const uint8_t *src, uint32_t *dst, int width);
+
+uint16_t load_16(const uint8_t *src) {
+  uint16_t value;
+  memcpy(&value, src, sizeof(value));
+  return value;
+}
+
+uint32_t load_32(const uint8_t *src) {
+  uint32_t value;
+  memcpy(&value, src, sizeof(value));
+  return value;
+}
+
+void convert_rgb565_pixels(const uint8_t *src, uint32_t *dst, int first, int width) {
+  for (int x = first; x < width; x++) {
+    const uint32_t pixel = load_16(src + x * 2);
+    const uint32_t r5 = pixel >> 11;
+    const uint32_t g6 = (pixel >> 5) & 0x3f;
+    const uint32_t b5 = pixel & 0x1f;
+    const uint32_t r8 = (r5 << 3) | (r5 >> 2);
+    const uint32_t g8 = (g6 << 2) | (g6 >> 4);
+    const uint32_t b8 = (b5 << 3) | (b5 >> 2);
+    dst[x] = (r8 << 16) | (g8 << 8) | b8;
+  }
+}
+
+void convert_bgr888_pixels(const uint8_t *src, uint32_t *dst, int first, int width) {
+  for (int x = first; x < width; x++) {
+    const uint32_t pixel = load_32(src + x * 4);
+    dst[x] = ((pixel >> 16) & 0xff) | (pixel & 0xff00) | ((pixel << 16) & 0xff0000);
+  }
+}
+
+void convert_rgb101010_pixels(const uint8_t *src, uint32_t *dst, int first, int width) {
+  for (int x = first; x < width; x++) {
+    const uint32_t pixel = load_32(src + x * 4);
+    dst[x] = ((pixel >> 6) & 0xff0000) | ((pixel >> 4) & 0xff00) | ((pixel >> 2) & 0xff);
+  }
+}
+
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+bool have_sse2() {
+  static const bool have = get_cpu_info(CPU_FEATURE_X86_SSE2) != 0;
+  return have;
+}
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+
+convert_pixels_proc_t get_convert_pixels_proc(x_image_format format) {
+  switch (format) {
+  case x_image_format::rgb565:
+    return &convert_rgb565_pixels;
+  case x_image_format::bgr888:
+    return &convert_bgr888_pixels;
+  case x_image_format::rgb101010:
+    return &convert_rgb101010_pixels;
+  case x_image_format::other:
+    break;
+  }
+  TRAA_DCHECK_NOTREACHED();
+  return nullptr;
+}
+
+// Returns nullptr if there is no SIMD routine for `format` on this CPU.
+convert_row_proc_t get_convert_row_proc(x_image_format format) {
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+  if (have_sse2()) {
+    switch (format) {
+    case x_image_format::rgb565:
+      return &convert_rgb565_row_sse2;
+    case x_image_format::bgr888:
+      return &convert_bgr888_row_sse2;
+    case x_image_format::rgb101010:
+      return &convert_rgb101010_row_sse2;
+    case x_image_format::other:
+      break;
+    }
+  }
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+  return nullptr;
+}
+
+} // namespace
+
+x_image_format get_x_image_format(int bits_per_pixel, uint32_t red_mask, uint32_t green_mask,
+                                  uint32_t blue_mask) {
+#if defined(TRAA_ARCH_LITTLE_ENDIAN)
+  if (bits_per_pixel == 16 && red_mask == 0xf800 && green_mask == 0x7e0 && blue_mask == 0x1f) {
+    return x_image_format::rgb565;
+  }
+  if (bits_per_pixel == 32 && red_mask == 0xff && green_mask == 0xff00 &&
+      blue_mask == 0xff0000) {
+    return x_image_format::bgr888;
+  }
+  if (bits_per_pixel == 32 && red_mask == 0x3ff00000 && green_mask == 0xffc00 &&
+      blue_mask == 0x3ff) {
+    return x_image_format::rgb101010;
+  }
+#endif // defined(TRAA_ARCH_LITTLE_ENDIAN)
+  return x_image_format::other;
+}
+
+void convert_x_image_pixels(x_image_format format, const uint8_t *src, int src_stride,
+                            uint8_t *dst, int dst_stride, int width, int height) {
+  const convert_pixels_proc_t convert_pixels = get_convert_pixels_proc(format);
+  const convert_row_proc_t convert_row = get_convert_row_proc(format);
+  for (int y = 0; y < height; y++) {
+    uint32_t *dst_32 = reinterpret_cast<uint32_t *>(dst);
+    // The SIMD routines leave the last few pixels of the row.
+    const int converted = convert_row ? convert_row(src, dst_32, width) : 0;
+    convert_pixels(src, dst_32, converted, width);
+    src += src_stride;
+    dst += dst_stride;
+  }
+}
+
+void convert_x_cardinal_pixels(const unsigned long *src, uint32_t *dst, int count) {
+#if defined(TRAA_ARCH_32_BITS)
+  memcpy(dst, src, count * sizeof(uint32_t));
+#else
+  int first = 0;
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+  if (have_sse2()) {
+    first = convert_cardinal_row_sse2(src, dst, count);
+  }
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+  // The upper halves of the longs are padding.
+  for (int i = first; i < count; i++) {
+    dst[i] = static_cast<uint32_t>(src[i]);
+  }
+#endif // defined(TRAA_ARCH_32_BITS)
+}
+
+} // namespace base
+} // namespace traa
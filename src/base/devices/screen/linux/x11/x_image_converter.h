@@ -0,0 +1,41 @@
+#ifndef TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_IMAGE_CONVERTER_H_
+#define TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_IMAGE_CONVERTER_H_
+
+#include <stdint.h>
+
+namespace traa {
+namespace base {
+
+// Pixel formats of XImage which are not laid out like desktop_frame, but have
+// dedicated converters.
+enum class x_image_format {
+  // Any other format, which needs the generic mask and shift conversion.
+  other,
+  // 16 bits per pixel, 5 bits of red, 6 of green and 5 of blue.
+  rgb565,
+  // 32 bits per pixel, 8 bits per channel, red in the least significant byte.
+  bgr888,
+  // 32 bits per pixel, 10 bits per channel, i.e. 30-bit deep color.
+  rgb101010,
+};
+
+// Returns the format of XImage pixels with the given layout, in native byte
+// order.
+x_image_format get_x_image_format(int bits_per_pixel, uint32_t red_mask, uint32_t green_mask,
+                                  uint32_t blue_mask);
+
+// Converts `height` rows of `width` pixels in `format`, which must not be
+// x_image_format::other, to the 32-bit pixels of desktop_frame. Channels of
+// less than 8 bits are scaled to the full range, e.g. white stays white.
+void convert_x_image_pixels(x_image_format format, const uint8_t *src, int src_stride,
+                            uint8_t *dst, int dst_stride, int width, int height);
+
+// Converts `count` pixels of a window property of 32-bit CARDINALs, like
+// _NET_WM_ICON, to the 32-bit pixels of desktop_frame. Xlib returns such
+// properties as an array of longs, which are 64 bits wide on LP64 platforms.
+void convert_x_cardinal_pixels(const unsigned long *src, uint32_t *dst, int count);
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_IMAGE_CONVERTER_H_
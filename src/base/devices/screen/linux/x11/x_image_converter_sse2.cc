@@ -0,0 +1,82 @@
+#include "base/devices/screen/linux/x11/x_image_converter_sse2.h"
+
+#if defined(TRAA_ARCH_X86_FAMILY)
+
+#include <emmintrin.h>
+
+namespace traa {
+namespace base {
+
+extern int convert_rgb565_row_sse2(const uint8_t *src, uint32_t *dst, int width) {
+  const __m128i mask5 = _mm_set1_epi16(0x1f);
+  const __m128i mask6 = _mm_set1_epi16(0x3f);
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 2));
+    const __m128i r5 = _mm_srli_epi16(v, 11);
+    const __m128i g6 = _mm_and_si128(_mm_srli_epi16(v, 5), mask6);
+    const __m128i b5 = _mm_and_si128(v, mask5);
+    // Replicate the most significant bits into the low bits, so the channels
+    // cover [0, 255].
+    const __m128i r8 = _mm_or_si128(_mm_slli_epi16(r5, 3), _mm_srli_epi16(r5, 2));
+    const __m128i g8 = _mm_or_si128(_mm_slli_epi16(g6, 2), _mm_srli_epi16(g6, 4));
+    const __m128i b8 = _mm_or_si128(_mm_slli_epi16(b5, 3), _mm_srli_epi16(b5, 2));
+    const __m128i bg = _mm_or_si128(b8, _mm_slli_epi16(g8, 8));
+    __m128i *out = reinterpret_cast<__m128i *>(dst + x);
+    _mm_storeu_si128(out, _mm_unpacklo_epi16(bg, r8));
+    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(bg, r8));
+  }
+  return x;
+}
+
+extern int convert_bgr888_row_sse2(const uint8_t *src, uint32_t *dst, int width) {
+  const __m128i mask_low = _mm_set1_epi32(0xff);
+  const __m128i mask_green = _mm_set1_epi32(0xff00);
+  const __m128i mask_high = _mm_set1_epi32(0xff0000);
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+    const __m128i b = _mm_and_si128(_mm_srli_epi32(v, 16), mask_low);
+    const __m128i g = _mm_and_si128(v, mask_green);
+    const __m128i r = _mm_and_si128(_mm_slli_epi32(v, 16), mask_high);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x),
+                     _mm_or_si128(_mm_or_si128(b, g), r));
+  }
+  return x;
+}
+
+extern int convert_rgb101010_row_sse2(const uint8_t *src, uint32_t *dst, int width) {
+  const __m128i mask_low = _mm_set1_epi32(0xff);
+  const __m128i mask_green = _mm_set1_epi32(0xff00);
+  const __m128i mask_high = _mm_set1_epi32(0xff0000);
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+    // Keep the 8 most significant bits of each 10-bit channel.
+    const __m128i b = _mm_and_si128(_mm_srli_epi32(v, 2), mask_low);
+    const __m128i g = _mm_and_si128(_mm_srli_epi32(v, 4), mask_green);
+    const __m128i r = _mm_and_si128(_mm_srli_epi32(v, 6), mask_high);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x),
+                     _mm_or_si128(_mm_or_si128(b, g), r));
+  }
+  return x;
+}
+
+#if defined(TRAA_ARCH_64_BITS)
+extern int convert_cardinal_row_sse2(const unsigned long *src, uint32_t *dst, int width) {
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    const __m128i *in = reinterpret_cast<const __m128i *>(src + x);
+    // Move the low halves of the two longs of each register to its low 64 bits.
+    const __m128i low = _mm_shuffle_epi32(_mm_loadu_si128(in), _MM_SHUFFLE(3, 1, 2, 0));
+    const __m128i high = _mm_shuffle_epi32(_mm_loadu_si128(in + 1), _MM_SHUFFLE(3, 1, 2, 0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_unpacklo_epi64(low, high));
+  }
+  return x;
+}
+#endif // TRAA_ARCH_64_BITS
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_ARCH_X86_FAMILY
@@ -0,0 +1,29 @@
+// This header file is used only by x_image_converter.cc. It defines the SSE2
+// routines converting rows of XImage and window property pixels.
+
+#ifndef TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_IMAGE_CONVERTER_SSE2_H_
+#define TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_IMAGE_CONVERTER_SSE2_H_
+
+#include "base/arch.h"
+
+#if defined(TRAA_ARCH_X86_FAMILY) && defined(TRAA_ENABLE_SSE2)
+#include <stdint.h>
+
+namespace traa {
+namespace base {
+
+// Each routine converts as many pixels of the row as fit into whole SSE2
+// registers, and returns their number. The caller converts the rest.
+extern int convert_rgb565_row_sse2(const uint8_t *src, uint32_t *dst, int width);
+extern int convert_bgr888_row_sse2(const uint8_t *src, uint32_t *dst, int width);
+extern int convert_rgb101010_row_sse2(const uint8_t *src, uint32_t *dst, int width);
+#if defined(TRAA_ARCH_64_BITS)
+extern int convert_cardinal_row_sse2(const unsigned long *src, uint32_t *dst, int width);
+#endif // TRAA_ARCH_64_BITS
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_ARCH_X86_FAMILY && TRAA_ENABLE_SSE2
+
+#endif // TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_IMAGE_CONVERTER_SSE2_H_
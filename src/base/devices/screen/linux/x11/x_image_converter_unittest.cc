@@ -0,0 +1,120 @@
+#include "base/devices/screen/linux/x11/x_image_converter.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// Extracts the channel of `pixel` selected by `mask`, scaled to 8 bits by
+// replicating its most significant bits, or truncated to 8 bits.
+uint32_t channel(uint32_t pixel, uint32_t mask) {
+  int shift = 0;
+  while (!((mask >> shift) & 1)) {
+    shift++;
+  }
+  int bits = 0;
+  while ((mask >> (shift + bits)) & 1) {
+    bits++;
+  }
+  const uint32_t value = (pixel & mask) >> shift;
+  if (bits >= 8) {
+    return value >> (bits - 8);
+  }
+  uint32_t result = 0;
+  for (int filled = 0; filled < 8; filled += bits) {
+    result = (result << bits) | value;
+  }
+  return (result >> ((8 / bits + 1) * bits - 8)) & 0xff;
+}
+
+// Converts rows of random pixels with the given layout, and compares the
+// results with a straightforward per-pixel conversion.
+void test_conversion(int bits_per_pixel, uint32_t red_mask, uint32_t green_mask,
+                     uint32_t blue_mask, x_image_format expected_format) {
+  const x_image_format format =
+      get_x_image_format(bits_per_pixel, red_mask, green_mask, blue_mask);
+  ASSERT_EQ(format, expected_format);
+
+  const int bytes_per_pixel = bits_per_pixel / 8;
+  // Widths cover whole SIMD registers, and rows with a few pixels left over.
+  for (int width = 1; width <= 20; width++) {
+    const int height = 3;
+    const int src_stride = width * bytes_per_pixel + 3;
+    const int dst_stride = width * 4;
+    std::vector<uint8_t> src(src_stride * height);
+    for (uint8_t &byte : src) {
+      byte = static_cast<uint8_t>(rand());
+    }
+    std::vector<uint8_t> dst(dst_stride * height);
+    convert_x_image_pixels(format, src.data(), src_stride, dst.data(), dst_stride, width, height);
+
+    for (int y = 0; y < height; y++) {
+      for (int x = 0; x < width; x++) {
+        uint32_t pixel = 0;
+        memcpy(&pixel, src.data() + y * src_stride + x * bytes_per_pixel, bytes_per_pixel);
+        const uint32_t expected = (channel(pixel, red_mask) << 16) |
+                                  (channel(pixel, green_mask) << 8) | channel(pixel, blue_mask);
+        uint32_t actual;
+        memcpy(&actual, dst.data() + y * dst_stride + x * 4, sizeof(actual));
+        ASSERT_EQ(actual, expected) << "width = " << width << ", x = " << x << ", y = " << y;
+      }
+    }
+  }
+}
+
+} // namespace
+
+TEST(x_image_converter_test, rgb565) {
+  test_conversion(16, 0xf800, 0x7e0, 0x1f, x_image_format::rgb565);
+}
+
+TEST(x_image_converter_test, bgr888) {
+  test_conversion(32, 0xff, 0xff00, 0xff0000, x_image_format::bgr888);
+}
+
+TEST(x_image_converter_test, rgb101010) {
+  test_conversion(32, 0x3ff00000, 0xffc00, 0x3ff, x_image_format::rgb101010);
+}
+
+TEST(x_image_converter_test, full_range) {
+  // White stays white, even with 5 and 6 bits per channel.
+  const uint16_t src[] = {0xffff, 0x0000, 0xf800};
+  uint32_t dst[3];
+  convert_x_image_pixels(x_image_format::rgb565, reinterpret_cast<const uint8_t *>(src),
+                         sizeof(src), reinterpret_cast<uint8_t *>(dst), sizeof(dst), 3, 1);
+  EXPECT_EQ(dst[0], 0xffffffu);
+  EXPECT_EQ(dst[1], 0u);
+  EXPECT_EQ(dst[2], 0xff0000u);
+}
+
+TEST(x_image_converter_test, cardinal) {
+  // Widths cover whole SIMD registers, and rows with a few pixels left over.
+  for (int count = 1; count <= 20; count++) {
+    std::vector<unsigned long> src(count);
+    for (unsigned long &value : src) {
+      // Xlib leaves the padding of 64-bit longs zero, but it must be ignored.
+      value = static_cast<unsigned long>(rand()) << 16 ^ static_cast<unsigned long>(rand());
+    }
+    std::vector<uint32_t> dst(count);
+    convert_x_cardinal_pixels(src.data(), dst.data(), count);
+    for (int i = 0; i < count; i++) {
+      ASSERT_EQ(dst[i], static_cast<uint32_t>(src[i])) << "count = " << count << ", i = " << i;
+    }
+  }
+}
+
+TEST(x_image_converter_test, other_formats) {
+  EXPECT_EQ(get_x_image_format(32, 0xff0000, 0xff00, 0xff), x_image_format::other);
+  EXPECT_EQ(get_x_image_format(24, 0xff, 0xff00, 0xff0000), x_image_format::other);
+  EXPECT_EQ(get_x_image_format(16, 0x7c00, 0x3e0, 0x1f), x_image_format::other);
+}
+
+} // namespace base
+} // namespace traa
@@ -0,0 +1,205 @@
+#include "base/devices/screen/linux/x11/x_render_scaler.h"
+
+#include "base/devices/screen/desktop_frame.h"
+#include "base/devices/screen/linux/x11/x_error_trap.h"
+#include "base/devices/screen/linux/x11/x_shm_segment_pool.h"
+#include "base/logger.h"
+
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace traa {
+namespace base {
+
+#if defined(TRAA_ENABLE_XRENDER)
+
+inline namespace {
+
+// The largest width and height of the convolution kernel. Each scaled pixel
+// costs width * height source pixels on the server, beyond this the kernel
+// skips some of them.
+constexpr int k_max_kernel_size = 16;
+
+// Returns the width of the box averaging `source` pixels into `scaled` ones.
+int box_kernel_size(int source, int scaled) {
+  const int size = static_cast<int>(ceil(static_cast<double>(source) / scaled));
+  return std::max(1, std::min(size, k_max_kernel_size));
+}
+
+// Copies `height` rows of 32-bit pixels in the byte order of `image` to `dst`.
+void copy_image_rows(const XImage *image, int width, int height, uint8_t *dst, int dst_stride) {
+  const uint8_t *src = reinterpret_cast<const uint8_t *>(image->data);
+  for (int y = 0; y < height; y++) {
+    if (image->byte_order == LSBFirst) {
+      memcpy(dst, src, static_cast<size_t>(width) * desktop_frame::k_bytes_per_pixel);
+    } else {
+      for (int x = 0; x < width * desktop_frame::k_bytes_per_pixel; x += 4) {
+        dst[x] = src[x + 3];
+        dst[x + 1] = src[x + 2];
+        dst[x + 2] = src[x + 1];
+        dst[x + 3] = src[x];
+      }
+    }
+    src += image->bytes_per_line;
+    dst += dst_stride;
+  }
+}
+
+} // namespace
+
+x_render_scaler::x_render_scaler(Display *display) : display_(display) {
+  // Xlib caches the version and the formats per display, only the first
+  // scaler of a display costs round trips.
+  int event_base = 0, error_base = 0;
+  int major = 0, minor = 0;
+  if (!XRenderQueryExtension(display_, &event_base, &error_base) ||
+      !XRenderQueryVersion(display_, &major, &minor)) {
+    LOG_INFO("XRender is not available, thumbnails are scaled locally");
+    return;
+  }
+  // Transforms and filters come with 0.6, RepeatPad with 0.10.
+  if (major == 0 && minor < 10) {
+    LOG_INFO("XRender {}.{} is too old, thumbnails are scaled locally", major, minor);
+    return;
+  }
+  argb_format_ = XRenderFindStandardFormat(display_, PictStandardARGB32);
+}
+
+bool x_render_scaler::is_supported() const { return argb_format_ != nullptr; }
+
+bool x_render_scaler::scale(::Window window, const desktop_rect &source_rect,
+                            const desktop_size &scaled_size, uint8_t *dst, int dst_stride) {
+  if (!is_supported() || source_rect.is_empty() || scaled_size.is_empty()) {
+    return false;
+  }
+
+  // Attaching a new segment traps errors itself, and traps do not nest.
+  std::unique_ptr<x_shm_segment> segment;
+  if (XShmQueryExtension(display_)) {
+    segment = x_shm_segment_pool::acquire(display_, static_cast<size_t>(scaled_size.width()) *
+                                                        desktop_frame::k_bytes_per_pixel *
+                                                        scaled_size.height());
+  }
+
+  x_error_trap error_trap(display_);
+
+  XWindowAttributes attributes;
+  if (!XGetWindowAttributes(display_, window, &attributes) || attributes.c_class == InputOnly) {
+    error_trap.get_last_error_and_disable();
+    x_shm_segment_pool::recycle(display_, std::move(segment));
+    return false;
+  }
+  XRenderPictFormat *source_format = XRenderFindVisualFormat(display_, attributes.visual);
+  if (!source_format) {
+    error_trap.get_last_error_and_disable();
+    x_shm_segment_pool::recycle(display_, std::move(segment));
+    return false;
+  }
+
+  XRenderPictureAttributes source_attributes = {};
+  source_attributes.subwindow_mode = IncludeInferiors;
+  source_attributes.repeat = RepeatPad;
+  Picture source = XRenderCreatePicture(display_, window, source_format,
+                                        CPSubwindowMode | CPRepeat, &source_attributes);
+
+  // Maps the pixels of the scaled picture to the pixels of `source_rect`.
+  const double scale_x = static_cast<double>(source_rect.width()) / scaled_size.width();
+  const double scale_y = static_cast<double>(source_rect.height()) / scaled_size.height();
+  XTransform transform = {{
+      {XDoubleToFixed(scale_x), 0, XDoubleToFixed(source_rect.left())},
+      {0, XDoubleToFixed(scale_y), XDoubleToFixed(source_rect.top())},
+      {0, 0, XDoubleToFixed(1)},
+  }};
+  XRenderSetPictureTransform(display_, source, &transform);
+
+  const int kernel_width = box_kernel_size(source_rect.width(), scaled_size.width());
+  const int kernel_height = box_kernel_size(source_rect.height(), scaled_size.height());
+  if (kernel_width == 1 && kernel_height == 1) {
+    XRenderSetPictureFilter(display_, source, FilterBilinear, nullptr, 0);
+  } else {
+    // The width and the height of the kernel, then its weights row by row.
+    std::vector<XFixed> kernel(2 + kernel_width * kernel_height,
+                               XDoubleToFixed(1.0 / (kernel_width * kernel_height)));
+    kernel[0] = XDoubleToFixed(kernel_width);
+    kernel[1] = XDoubleToFixed(kernel_height);
+    XRenderSetPictureFilter(display_, source, FilterConvolution, kernel.data(),
+                            static_cast<int>(kernel.size()));
+  }
+
+  Pixmap pixmap =
+      XCreatePixmap(display_, attributes.root, scaled_size.width(), scaled_size.height(), 32);
+  Picture scaled = XRenderCreatePicture(display_, pixmap, argb_format_, 0, nullptr);
+  XRenderComposite(display_, PictOpSrc, source, None, scaled, 0, 0, 0, 0, 0, 0,
+                   scaled_size.width(), scaled_size.height());
+  XRenderFreePicture(display_, scaled);
+  XRenderFreePicture(display_, source);
+
+  // Fetching the pixels takes a round trip, which also reports the errors of
+  // the requests above, e.g. if `window` was destroyed meanwhile.
+  const bool fetched =
+      get_pixmap_pixels(pixmap, attributes.visual, scaled_size, segment.get(), dst, dst_stride);
+  XFreePixmap(display_, pixmap);
+  if (!fetched) {
+    // The pixmap may not exist, catch the error of freeing it.
+    XSync(display_, False);
+  }
+  const bool succeeded = error_trap.get_last_error_and_disable() == 0 && fetched;
+  x_shm_segment_pool::recycle(display_, std::move(segment));
+  return succeeded;
+}
+
+bool x_render_scaler::get_pixmap_pixels(Pixmap pixmap, Visual *visual, const desktop_size &size,
+                                        x_shm_segment *segment, uint8_t *dst, int dst_stride) {
+  XImage *image = nullptr;
+  if (segment) {
+    image = XShmCreateImage(display_, visual, 32, ZPixmap, nullptr, segment->info(), size.width(),
+                            size.height());
+    // Rows of 32-bit pixels are not padded, so the image fits in the segment.
+    if (image && static_cast<size_t>(image->bytes_per_line) * image->height <= segment->size()) {
+      image->data = segment->data();
+      if (!XShmGetImage(display_, pixmap, image, 0, 0, AllPlanes)) {
+        XDestroyImage(image);
+        image = nullptr;
+      }
+    } else if (image) {
+      XDestroyImage(image);
+      image = nullptr;
+    }
+  }
+  if (!image) {
+    image = XGetImage(display_, pixmap, 0, 0, size.width(), size.height(), AllPlanes, ZPixmap);
+  }
+
+  bool succeeded = false;
+  if (image) {
+    succeeded = image->bits_per_pixel == 32;
+    if (succeeded) {
+      copy_image_rows(image, size.width(), size.height(), dst, dst_stride);
+    }
+    XDestroyImage(image);
+  }
+  return succeeded;
+}
+
+#else
+
+x_render_scaler::x_render_scaler(Display *) {}
+
+bool x_render_scaler::is_supported() const { return false; }
+
+bool x_render_scaler::scale(::Window, const desktop_rect &, const desktop_size &, uint8_t *, int) {
+  return false;
+}
+
+#endif // defined(TRAA_ENABLE_XRENDER)
+
+} // namespace base
+} // namespace traa
@@ -0,0 +1,61 @@
+#ifndef TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_RENDER_SCALER_H_
+#define TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_RENDER_SCALER_H_
+
+#include "base/devices/screen/desktop_geometry.h"
+
+#include <X11/Xlib.h>
+#if defined(TRAA_ENABLE_XRENDER)
+#include <X11/extensions/Xrender.h>
+#endif
+
+#include <stdint.h>
+
+namespace traa {
+namespace base {
+
+class x_shm_segment;
+
+// Scales windows on the X server with XRender, so only the scaled pixels cross
+// the connection. Grabbing a 1920x1080 window for a 320x180 thumbnail moves 36
+// times fewer bytes than grabbing it at full size and scaling it here, which
+// matters most for remote and forwarded displays.
+//
+// The pixels are averaged with a box convolution as large as the scale factor,
+// like libyuv::kFilterBox, so thin lines and text do not alias.
+//
+// Without TRAA_ENABLE_XRENDER the scaler is never supported.
+//
+// Not thread-safe, like `display`.
+class x_render_scaler {
+public:
+  explicit x_render_scaler(Display *display);
+
+  x_render_scaler(const x_render_scaler &) = delete;
+  x_render_scaler &operator=(const x_render_scaler &) = delete;
+
+  // Whether the X server supports XRender 0.10 or later.
+  bool is_supported() const;
+
+  // Scales `source_rect` of `window`, including its children, to `scaled_size`
+  // and stores the pixels in `dst`, laid out like desktop_frame. Pixels outside
+  // of `window` repeat its edges. Returns false on failure, e.g. if `window`
+  // was destroyed.
+  bool scale(::Window window, const desktop_rect &source_rect, const desktop_size &scaled_size,
+             uint8_t *dst, int dst_stride);
+
+private:
+#if defined(TRAA_ENABLE_XRENDER)
+  // Fetches `size` pixels of `pixmap`, 32 bits deep, into `dst`. Through
+  // `segment` if not null, with XGetImage() otherwise.
+  bool get_pixmap_pixels(Pixmap pixmap, Visual *visual, const desktop_size &size,
+                         x_shm_segment *segment, uint8_t *dst, int dst_stride);
+
+  Display *const display_;
+  XRenderPictFormat *argb_format_ = nullptr;
+#endif
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_RENDER_SCALER_H_
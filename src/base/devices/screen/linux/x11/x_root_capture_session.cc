@@ -0,0 +1,313 @@
+#include "base/devices/screen/linux/x11/x_root_capture_session.h"
+
+#include "base/checks.h"
+#include "base/devices/screen/cropped_desktop_frame.h"
+#include "base/devices/screen/linux/x11/x_error_trap.h"
+#include "base/logger.h"
+#include "base/utils/time_utils.h"
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// A grab older than a frame at 60 fps is not reused by another client.
+constexpr int64_t k_max_grab_age_ms = 1000 / 60;
+
+std::mutex &sessions_mutex() {
+  static std::mutex *mutex = new std::mutex();
+  return *mutex;
+}
+
+// The sessions by the shared_x_display they capture from.
+std::map<shared_x_display *, std::weak_ptr<x_root_capture_session>> &sessions() {
+  static auto *sessions =
+      new std::map<shared_x_display *, std::weak_ptr<x_root_capture_session>>();
+  return *sessions;
+}
+
+} // namespace
+
+x_root_capture_session::client::client(std::shared_ptr<x_root_capture_session> session)
+    : session_(std::move(session)) {}
+
+x_root_capture_session::client::~client() {
+  std::lock_guard<std::mutex> lock(session_->mutex_);
+  auto &clients = session_->clients_;
+  clients.erase(std::remove(clients.begin(), clients.end(), this), clients.end());
+}
+
+std::unique_ptr<desktop_frame> x_root_capture_session::client::capture(const desktop_rect &rect) {
+  return session_->capture(this, rect);
+}
+
+// static
+std::unique_ptr<x_root_capture_session::client>
+x_root_capture_session::create_client(const desktop_capture_options &options) {
+  if (!options.x_display_t()) {
+    return nullptr;
+  }
+
+  std::shared_ptr<x_root_capture_session> session;
+  {
+    std::lock_guard<std::mutex> lock(sessions_mutex());
+    for (auto it = sessions().begin(); it != sessions().end();) {
+      it = it->second.expired() ? sessions().erase(it) : std::next(it);
+    }
+
+    std::weak_ptr<x_root_capture_session> &entry = sessions()[options.x_display_t().get()];
+    session = entry.lock();
+    if (!session) {
+      session.reset(new x_root_capture_session(options));
+      entry = session;
+    }
+  }
+
+  std::unique_ptr<client> result(new client(session));
+  std::lock_guard<std::mutex> lock(session->mutex_);
+  session->clients_.push_back(result.get());
+  return result;
+}
+
+x_root_capture_session::x_root_capture_session(const desktop_capture_options &options)
+    : x_display_(options.x_display_t()), atom_cache_(display()),
+      root_window_(DefaultRootWindow(display())) {
+  int randr_error_base = 0;
+  if (XRRQueryExtension(display(), &randr_event_base_, &randr_error_base)) {
+    XRRSelectInput(display(), root_window_, RRScreenChangeNotifyMask);
+    x_display_->add_x_event_handler(randr_event_base_ + RRScreenChangeNotify, this);
+  } else {
+    randr_event_base_ = -1;
+  }
+
+#if defined(TRAA_ENABLE_XDAMAGE)
+  if (!options.use_update_notifications()) {
+    return;
+  }
+
+  if (!XDamageQueryExtension(display(), &damage_event_base_, &damage_error_base_)) {
+    LOG_INFO("X server does not support XDamage.");
+    return;
+  }
+
+  x_error_trap error_trap(display());
+  damage_handle_ = XDamageCreate(display(), root_window_, XDamageReportNonEmpty);
+  XSync(display(), False);
+  if (error_trap.get_last_error_and_disable() != 0) {
+    LOG_WARN("Unable to create damage for the root window, grab the whole area.");
+    damage_handle_ = 0;
+    return;
+  }
+  damage_region_ = XFixesCreateRegion(display(), nullptr, 0);
+  x_display_->add_x_event_handler(damage_event_base_ + XDamageNotify, this);
+#endif
+}
+
+x_root_capture_session::~x_root_capture_session() {
+  if (randr_event_base_ >= 0) {
+    x_display_->remove_x_event_handler(randr_event_base_ + RRScreenChangeNotify, this);
+  }
+#if defined(TRAA_ENABLE_XDAMAGE)
+  if (damage_handle_) {
+    x_display_->remove_x_event_handler(damage_event_base_ + XDamageNotify, this);
+    XDamageDestroy(display(), damage_handle_);
+    XFixesDestroyRegion(display(), damage_region_);
+  }
+#endif
+}
+
+bool x_root_capture_session::on_x_event(const x_event_t &event) {
+  if (randr_event_base_ >= 0 && event.type == randr_event_base_ + RRScreenChangeNotify) {
+    // Keeps the screen size known by Xlib up to date.
+    XRRUpdateConfiguration(const_cast<x_event_t *>(&event));
+    std::lock_guard<std::mutex> lock(mutex_);
+    pixel_buffer_stale_ = true;
+    // The capturers of the monitors handle the event too.
+    return false;
+  }
+
+#if defined(TRAA_ENABLE_XDAMAGE)
+  // The damage is fetched by grab(), the event is only consumed.
+  const XDamageNotifyEvent *damage_event = reinterpret_cast<const XDamageNotifyEvent *>(&event);
+  return damage_event->damage == damage_handle_;
+#else
+  return false;
+#endif
+}
+
+std::unique_ptr<desktop_frame> x_root_capture_session::capture(client *c,
+                                                                const desktop_rect &rect) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!has_capture_thread_) {
+    capture_thread_ = current_thread_ref();
+    has_capture_thread_ = true;
+  }
+  TRAA_DCHECK(is_thread_ref_equal(capture_thread_, current_thread_ref()));
+
+  bool need_grab = grab_id_ == 0 || c->last_grab_id_ == grab_id_ ||
+                   time_millis() - grab_time_ms_ > k_max_grab_age_ms;
+  if (!rect.equals(c->rect_)) {
+    // The new area may not be in the current frame.
+    c->rect_ = rect;
+    c->pending_region_.set_rect(rect);
+    c->pending_region_precomputed_ = false;
+    need_grab = true;
+  }
+  if (need_grab && !grab()) {
+    return nullptr;
+  }
+  c->last_grab_id_ = grab_id_;
+
+  // The frame starts at the origin of the bounds of all the clients.
+  std::unique_ptr<desktop_frame> frame = queue_.current_frame()->share();
+  const desktop_vector origin = frame->top_left();
+  c->pending_region_.intersect_with(rect);
+  c->pending_region_.translate(-origin.x(), -origin.y());
+  frame->mutable_updated_region()->swap(&c->pending_region_);
+  c->pending_region_.clear();
+  desktop_rect crop_rect = rect;
+  crop_rect.translate(-origin.x(), -origin.y());
+  std::unique_ptr<desktop_frame> result = create_cropped_desktop_frame(std::move(frame), crop_rect);
+  if (result) {
+    result->set_updated_region_precomputed(c->pending_region_precomputed_);
+  }
+  c->pending_region_precomputed_ = true;
+  return result;
+}
+
+bool x_root_capture_session::grab() {
+  if (pixel_buffer_stale_) {
+    XWindowAttributes attributes;
+    if (!XGetWindowAttributes(display(), root_window_, &attributes)) {
+      LOG_ERROR("Failed to get the attributes of the root window.");
+      return false;
+    }
+    root_rect_ = desktop_rect::make_wh(attributes.width, attributes.height);
+  }
+
+  // Only the areas of the clients are read, and the buffer only covers their
+  // bounds.
+  desktop_region grab_region;
+  desktop_rect area;
+  for (const client *c : clients_) {
+    grab_region.add_rect(c->rect_);
+    area.union_with(c->rect_);
+  }
+  grab_region.intersect_with(root_rect_);
+  area.intersect_with(root_rect_);
+  if (area.is_empty()) {
+    return false;
+  }
+
+  if (pixel_buffer_stale_ || !area.equals(pixel_buffer_.area())) {
+    if (!pixel_buffer_.init(&atom_cache_, root_window_, 0, area)) {
+      LOG_ERROR("Failed to initialize pixel buffer for the root window.");
+      return false;
+    }
+    pixel_buffer_stale_ = false;
+    reset_frames();
+  }
+
+  desktop_region damage_region;
+#if defined(TRAA_ENABLE_XDAMAGE)
+  if (damage_handle_) {
+    // Atomically fetch and clear the damage region.
+    XDamageSubtract(display(), damage_handle_, None, damage_region_);
+    int rects_num = 0;
+    XRectangle bounds;
+    XRectangle *rects = XFixesFetchRegionAndBounds(display(), damage_region_, &rects_num, &bounds);
+    for (int i = 0; i < rects_num; ++i) {
+      damage_region.add_rect(
+          desktop_rect::make_xywh(rects[i].x, rects[i].y, rects[i].width, rects[i].height));
+    }
+    if (rects) {
+      XFree(rects);
+    }
+    damage_region.intersect_with(grab_region);
+  }
+#endif
+
+  shared_desktop_frame *previous_frame = queue_.current_frame();
+  queue_.move_to_next_frame();
+  shared_desktop_frame *frame = queue_.current_frame();
+  // A frame still held by a consumer is not written to, a new one is allocated
+  // instead.
+  const bool reuse_frame = frame && !frame->is_shared() && frame->size().equals(area.size());
+  if (!reuse_frame) {
+    std::unique_ptr<desktop_frame> new_frame(new basic_desktop_frame(area.size()));
+    new_frame->set_top_left(area.top_left());
+    queue_.replace_current_frame(shared_desktop_frame::wrap(std::move(new_frame)));
+    frame = queue_.current_frame();
+  }
+
+  // The frame is first brought up to date with the previous one. With damage,
+  // only the damaged parts are read then. Without it, all the areas are read
+  // into a reused frame and compared with its content while being copied, so
+  // the updated region holds the actual changes. If the clients moved, all
+  // their areas are read.
+  const bool incremental = previous_frame && previous_frame->size().equals(area.size()) &&
+                           grab_region.equals(grabbed_region_) &&
+                           (has_damage() || reuse_frame);
+  const bool compare = incremental && !has_damage();
+  desktop_region read_region = grab_region;
+  if (incremental) {
+    // A reused frame only lacks the changes of the previous frame.
+    desktop_region copy_region = reuse_frame ? last_updated_region_ : grab_region;
+    if (has_damage()) {
+      read_region = damage_region;
+      copy_region.subtract(read_region);
+    }
+    copy_region.translate(-area.left(), -area.top());
+    for (desktop_region::iterator it(copy_region); !it.is_at_end(); it.advance()) {
+      frame->copy_pixels_from(*previous_frame, it.rect().top_left(), it.rect());
+    }
+  }
+
+  desktop_region updated_region;
+  // Skips the round trip if nothing was damaged.
+  if (!read_region.is_empty()) {
+    pixel_buffer_.synchronize();
+  }
+  for (desktop_region::iterator it(read_region); !it.is_at_end(); it.advance()) {
+    if (!pixel_buffer_.capture_rect(it.rect(), frame, compare ? &updated_region : nullptr)) {
+      // E.g. the root window was resized, initialize the buffer again.
+      LOG_WARN("Failed to capture the root window.");
+      pixel_buffer_stale_ = true;
+      reset_frames();
+      return false;
+    }
+  }
+
+  if (compare) {
+    // The changed blocks are in the coordinates of the frame.
+    updated_region.translate(area.left(), area.top());
+  } else {
+    updated_region.swap(&read_region);
+  }
+
+  grabbed_region_ = grab_region;
+  last_updated_region_ = updated_region;
+  grab_id_++;
+  grab_time_ms_ = time_millis();
+  for (client *c : clients_) {
+    c->pending_region_.add_region(updated_region);
+    c->pending_region_precomputed_ = c->pending_region_precomputed_ && compare;
+  }
+  return true;
+}
+
+void x_root_capture_session::reset_frames() {
+  queue_.reset();
+  grabbed_region_.clear();
+  last_updated_region_.clear();
+}
+
+} // namespace base
+} // namespace traa
@@ -0,0 +1,165 @@
+#ifndef TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_ROOT_CAPTURE_SESSION_H_
+#define TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_ROOT_CAPTURE_SESSION_H_
+
+#include "base/devices/screen/desktop_capture_options.h"
+#include "base/devices/screen/desktop_frame.h"
+#include "base/devices/screen/desktop_geometry.h"
+#include "base/devices/screen/desktop_region.h"
+#include "base/devices/screen/linux/x11/shared_x_display.h"
+#include "base/devices/screen/linux/x11/x_atom_cache.h"
+#include "base/devices/screen/linux/x11/x_server_pixel_buffer.h"
+#include "base/devices/screen/screen_capture_frame_queue.h"
+#include "base/devices/screen/shared_desktop_frame.h"
+#include "base/platform_thread_types.h"
+#include "base/thread_annotations.h"
+
+#include <X11/X.h>
+#include <X11/extensions/Xfixes.h>
+#if defined(TRAA_ENABLE_XDAMAGE)
+#include <X11/extensions/Xdamage.h>
+#endif
+
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace traa {
+namespace base {
+
+// Grabs the root window of an X display once for all the sources captured from
+// it, e.g. several monitors recorded at the same time.
+//
+// Each source is a client of the session. A client which already got the
+// latest grab, or finds it older than a frame, grabs the root window again, so
+// N clients capturing at the same rate cost one grab per tick instead of N. The
+// frames of the clients are cropped views over one refcounted buffer, and their
+// updated regions hold the changes of all the grabs since the previous frame of
+// the client, intersected with its rect.
+//
+// Only the union of the rects of the clients is read, and the pixel buffer
+// and the frames only cover the bounds of that union, e.g. one monitor out of
+// three. If desktop_capture_options::use_update_notifications() is set,
+// XDamage limits each grab to the damaged parts of that union.
+//
+// Without XDamage, the pixels are compared with the previous grab while being
+// copied, so the frames carry precomputed updated regions and
+// desktop_capturer_differ_wrapper does not compare them again.
+//
+// The buffer is sized once per layout of the monitors: RRScreenChangeNotify
+// marks it stale, and the next grab initializes it again.
+//
+// Xlib calls on one display are not serialized, XInitThreads() is not called.
+// So the clients of a session, like all the users of its shared_x_display, must
+// capture on one thread, which is DCHECKed. `mutex_` only guards the state of
+// the session, e.g. against clients destroyed on another thread.
+class x_root_capture_session : public shared_x_display::x_evt_handler {
+public:
+  class client {
+  public:
+    ~client();
+
+    client(const client &) = delete;
+    client &operator=(const client &) = delete;
+
+    // Returns the area `rect` of the root window, in the coordinates of the
+    // root window, or nullptr if the root window can not be read. The updated
+    // region of the frame holds the changes since the previous frame of this
+    // client, the whole frame for the first one or after `rect` changed.
+    std::unique_ptr<desktop_frame> capture(const desktop_rect &rect);
+
+  private:
+    friend class x_root_capture_session;
+
+    explicit client(std::shared_ptr<x_root_capture_session> session);
+
+    const std::shared_ptr<x_root_capture_session> session_;
+
+    // The area of the previous capture(), empty before the first one.
+    desktop_rect rect_;
+    // The changes of the root window since the previous frame of this client.
+    desktop_region pending_region_;
+    // The grab the previous frame of this client was cropped from.
+    uint64_t last_grab_id_ = 0;
+    // Whether all of `pending_region_` comes from comparing the pixels, see
+    // desktop_frame::is_updated_region_precomputed().
+    bool pending_region_precomputed_ = true;
+  };
+
+  // Returns a client of the session of the default root window of the X display
+  // of `options`. All the clients created from the same shared_x_display share
+  // one session, which takes the update notification option of the first one.
+  // Returns nullptr if `options` has no X display.
+  static std::unique_ptr<client> create_client(const desktop_capture_options &options);
+
+  ~x_root_capture_session() override;
+
+  x_root_capture_session(const x_root_capture_session &) = delete;
+  x_root_capture_session &operator=(const x_root_capture_session &) = delete;
+
+private:
+  explicit x_root_capture_session(const desktop_capture_options &options);
+
+  // shared_x_display::x_evt_handler interface.
+  bool on_x_event(const x_event_t &event) override;
+
+  x_display_t *display() { return x_display_->display(); }
+
+  std::unique_ptr<desktop_frame> capture(client *c, const desktop_rect &rect);
+
+  // Grabs the parts of the root window the clients capture into the next frame
+  // of the queue. The frame covers the bounds of those parts, and its
+  // top_left() is the origin of the bounds.
+  bool grab() TRAA_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Drops the frames of the queue, so the next grab reads all the clients' rects.
+  void reset_frames() TRAA_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Whether XDamage tracks the changes of the root window.
+  bool has_damage() const {
+#if defined(TRAA_ENABLE_XDAMAGE)
+    return damage_handle_ != 0;
+#else
+    return false;
+#endif
+  }
+
+  const std::shared_ptr<shared_x_display> x_display_;
+
+  std::mutex mutex_;
+  std::vector<client *> clients_ TRAA_GUARDED_BY(mutex_);
+  // The thread of the first capture, all the others must run on it.
+  bool has_capture_thread_ TRAA_GUARDED_BY(mutex_) = false;
+  platform_thread_ref capture_thread_ TRAA_GUARDED_BY(mutex_);
+
+  x_atom_cache atom_cache_ TRAA_GUARDED_BY(mutex_);
+  const ::Window root_window_;
+  x_server_pixel_buffer pixel_buffer_ TRAA_GUARDED_BY(mutex_);
+  bool pixel_buffer_stale_ TRAA_GUARDED_BY(mutex_) = true;
+  // The size of the root window, updated when the buffer is stale.
+  desktop_rect root_rect_ TRAA_GUARDED_BY(mutex_);
+
+  int randr_event_base_ = -1;
+
+#if defined(TRAA_ENABLE_XDAMAGE)
+  int damage_event_base_ = -1;
+  int damage_error_base_ = -1;
+  Damage damage_handle_ = 0;
+  XserverRegion damage_region_ = 0;
+#endif
+
+  screen_capture_frame_queue<shared_desktop_frame> queue_ TRAA_GUARDED_BY(mutex_);
+  // The union of the rects of the clients when the current frame was grabbed.
+  desktop_region grabbed_region_ TRAA_GUARDED_BY(mutex_);
+  // The region updated by the current frame, which the previous one lacks.
+  desktop_region last_updated_region_ TRAA_GUARDED_BY(mutex_);
+  // Increased by each grab, 0 before the first one.
+  uint64_t grab_id_ TRAA_GUARDED_BY(mutex_) = 0;
+  int64_t grab_time_ms_ TRAA_GUARDED_BY(mutex_) = 0;
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_ROOT_CAPTURE_SESSION_H_
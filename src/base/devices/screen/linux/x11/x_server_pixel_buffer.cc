@@ -13,11 +13,12 @@
 #include <X11/Xutil.h>
 #include <stdint.h>
 #include <string.h>
-#include <sys/ipc.h>
-#include <sys/shm.h>
 
 #include "base/devices/screen/desktop_frame.h"
+#include "base/devices/screen/desktop_region.h"
 #include "base/devices/screen/linux/x11/x_error_trap.h"
+#include "base/devices/screen/linux/x11/x_image_converter.h"
+#include "base/devices/screen/linux/x11/x_shm_segment_pool.h"
 #include "base/devices/screen/linux/x11/x_window_list_utils.h"
 #include "base/devices/screen/linux/x11/x_window_property.h"
 
@@ -62,12 +63,18 @@ bool IsXImageRGBFormat(XImage *image) {
 }
 
 // We expose two forms of blitting to handle variations in the pixel format.
-// In FastBlit(), the operation is effectively a memcpy.
-void FastBlit(XImage *x_image, uint8_t *src_pos, const desktop_rect &rect, desktop_frame *frame) {
-  frame->copy_pixels_from(src_pos, x_image->bytes_per_line,
-                          desktop_rect::make_xywh(rect.left() - frame->top_left().x(),
-                                                  rect.top() - frame->top_left().y(), rect.width(),
-                                                  rect.height()));
+// In FastBlit(), the operation is effectively a memcpy. When `dirty_region` is
+// not null, the copy also compares the pixels with the previous frame content.
+void FastBlit(XImage *x_image, uint8_t *src_pos, const desktop_rect &rect, desktop_frame *frame,
+              desktop_region *dirty_region) {
+  const desktop_rect dest_rect =
+      desktop_rect::make_xywh(rect.left() - frame->top_left().x(),
+                              rect.top() - frame->top_left().y(), rect.width(), rect.height());
+  if (dirty_region) {
+    frame->copy_and_diff_pixels_from(src_pos, x_image->bytes_per_line, dest_rect, dirty_region);
+  } else {
+    frame->copy_pixels_from(src_pos, x_image->bytes_per_line, dest_rect);
+  }
 }
 
 // to get more information about XImage, see
@@ -78,8 +85,22 @@ void SlowBlit(XImage *x_image, uint8_t *src_pos, const desktop_rect &rect, deskt
   int dst_y = rect.top() - frame->top_left().y();
   int width = rect.width(), height = rect.height();
 
+  uint8_t *dst_pos = frame->data() + frame->stride() * dst_y;
+  dst_pos += dst_x * desktop_frame::k_bytes_per_pixel;
+
+  // Common visuals have dedicated, vectorized converters.
+  const x_image_format format = x_image->byte_order == LSBFirst
+                                    ? get_x_image_format(x_image->bits_per_pixel,
+                                                         x_image->red_mask, x_image->green_mask,
+                                                         x_image->blue_mask)
+                                    : x_image_format::other;
+  if (format != x_image_format::other) {
+    convert_x_image_pixels(format, src_pos, src_stride, dst_pos, frame->stride(), width, height);
+    return;
+  }
+
   uint32_t red_mask = x_image->red_mask;
-  uint32_t green_mask = x_image->red_mask;
+  uint32_t green_mask = x_image->green_mask;
   uint32_t blue_mask = x_image->blue_mask;
 
   uint32_t red_shift = MaskToShift(red_mask);
@@ -88,12 +109,8 @@ void SlowBlit(XImage *x_image, uint8_t *src_pos, const desktop_rect &rect, deskt
 
   int bits_per_pixel = x_image->bits_per_pixel;
 
-  uint8_t *dst_pos = frame->data() + frame->stride() * dst_y;
-  dst_pos += dst_x * desktop_frame::k_bytes_per_pixel;
-  // TODO(hclam): Optimize, perhaps using MMX code or by converting to
-  // YUV directly.
-  // TODO(sergeyu): This code doesn't handle XImage byte order properly and
-  // won't work with 24bpp images. Fix it.
+  // TODO(sergeyu): This code doesn't handle XImage byte order properly. Fix
+  // it.
   for (int y = 0; y < height; y++) {
     uint32_t *dst_pos_32 = reinterpret_cast<uint32_t *>(dst_pos);
     uint32_t *src_pos_32 = reinterpret_cast<uint32_t *>(src_pos);
@@ -103,6 +120,9 @@ void SlowBlit(XImage *x_image, uint8_t *src_pos, const desktop_rect &rect, deskt
       uint32_t pixel;
       if (bits_per_pixel == 32) {
         pixel = src_pos_32[x];
+      } else if (bits_per_pixel == 24) {
+        const uint8_t *src_pos_24 = src_pos + x * 3;
+        pixel = src_pos_24[0] | (src_pos_24[1] << 8) | (src_pos_24[2] << 16);
       } else if (bits_per_pixel == 16) {
         pixel = src_pos_16[x];
       } else {
@@ -146,20 +166,18 @@ void x_server_pixel_buffer::release() {
   release_shm_segment();
 
   window_ = 0;
+  area_ = desktop_rect();
+  source_ = 0;
+  source_offset_ = 0;
 }
 
 void x_server_pixel_buffer::release_shm_segment() {
-  if (!shm_segment_info_)
-    return;
-  if (shm_segment_info_->shmaddr != nullptr)
-    shmdt(shm_segment_info_->shmaddr);
-  if (shm_segment_info_->shmid != -1)
-    shmctl(shm_segment_info_->shmid, IPC_RMID, 0);
-  delete shm_segment_info_;
-  shm_segment_info_ = nullptr;
+  // The segment stays attached for the next buffer of the display.
+  x_shm_segment_pool::recycle(display_, std::move(shm_segment_));
 }
 
-bool x_server_pixel_buffer::init(x_atom_cache *cache, ::Window window) {
+bool x_server_pixel_buffer::init(x_atom_cache *cache, ::Window window, Pixmap source,
+                                 const desktop_rect &area) {
   release();
   display_ = cache->display();
 
@@ -179,7 +197,17 @@ bool x_server_pixel_buffer::init(x_atom_cache *cache, ::Window window) {
     }
   }
 
+  area_ = desktop_rect::make_size(window_rect_.size());
+  if (!area.is_empty()) {
+    area_.intersect_with(area);
+    if (area_.is_empty()) {
+      return false;
+    }
+  }
+
   window_ = window;
+  source_ = source ? source : window;
+  source_offset_ = source ? attributes.border_width : 0;
   init_shm(attributes);
 
   return true;
@@ -196,48 +224,28 @@ void x_server_pixel_buffer::init_shm(const XWindowAttributes &attributes) {
     return;
   }
 
-  bool using_shm = false;
-  shm_segment_info_ = new XShmSegmentInfo;
-  shm_segment_info_->shmid = -1;
-  shm_segment_info_->shmaddr = nullptr;
-  shm_segment_info_->readOnly = False;
-  x_shm_image_ = XShmCreateImage(display_, default_visual, default_depth, ZPixmap, 0,
-                                 shm_segment_info_, window_rect_.width(), window_rect_.height());
+  // The size of the segment depends on the stride of the image, so the image
+  // is created first and pointed at the segment afterwards.
+  x_shm_image_ = XShmCreateImage(display_, default_visual, default_depth, ZPixmap, 0, nullptr,
+                                 area_.width(), area_.height());
   if (x_shm_image_) {
-    shm_segment_info_->shmid =
-        shmget(IPC_PRIVATE, x_shm_image_->bytes_per_line * x_shm_image_->height, IPC_CREAT | 0600);
-    if (shm_segment_info_->shmid != -1) {
-      void *shmat_result = shmat(shm_segment_info_->shmid, 0, 0);
-      if (shmat_result != reinterpret_cast<void *>(-1)) {
-        shm_segment_info_->shmaddr = reinterpret_cast<char *>(shmat_result);
-        x_shm_image_->data = shm_segment_info_->shmaddr;
-
-        x_error_trap error_trap(display_);
-        using_shm = XShmAttach(display_, shm_segment_info_);
-        XSync(display_, False);
-        if (error_trap.get_last_error_and_disable() != 0)
-          using_shm = false;
-        if (using_shm) {
-          LOG_DEBUG("Using X shared memory segment {}", shm_segment_info_->shmid);
-        }
-      }
-    } else {
-      LOG_WARN("Failed to get shared memory segment. Performance may be degraded.");
-    }
+    shm_segment_ = x_shm_segment_pool::acquire(
+        display_, static_cast<size_t>(x_shm_image_->bytes_per_line) * x_shm_image_->height);
   }
-
-  if (!using_shm) {
+  if (!shm_segment_) {
     LOG_WARN("Not using shared memory. Performance may be degraded.");
-    release_shm_segment();
+    if (x_shm_image_) {
+      XDestroyImage(x_shm_image_);
+      x_shm_image_ = nullptr;
+    }
     return;
   }
+  x_shm_image_->data = shm_segment_->data();
+  x_shm_image_->obdata = reinterpret_cast<char *>(shm_segment_->info());
 
   if (have_pixmaps)
     have_pixmaps = init_pixmaps(default_depth);
 
-  shmctl(shm_segment_info_->shmid, IPC_RMID, 0);
-  shm_segment_info_->shmid = -1;
-
   LOG_DEBUG("Using X shared memory extension v{}.{} with{} pixmaps.", major, minor,
             have_pixmaps ? "" : "out");
 }
@@ -248,8 +256,8 @@ bool x_server_pixel_buffer::init_pixmaps(int depth) {
 
   {
     x_error_trap error_trap(display_);
-    shm_pixmap_ = XShmCreatePixmap(display_, window_, shm_segment_info_->shmaddr, shm_segment_info_,
-                                   window_rect_.width(), window_rect_.height(), depth);
+    shm_pixmap_ = XShmCreatePixmap(display_, window_, shm_segment_->data(), shm_segment_->info(),
+                                   area_.width(), area_.height(), depth);
     XSync(display_, False);
     if (error_trap.get_last_error_and_disable() != 0) {
       // `shm_pixmap_` is not not valid because the request was not processed
@@ -290,34 +298,40 @@ bool x_server_pixel_buffer::is_window_valid() const {
 }
 
 void x_server_pixel_buffer::synchronize() {
-  if (shm_segment_info_ && !shm_pixmap_) {
+  if (shm_segment_ && !shm_pixmap_) {
     // XShmGetImage can fail if the display is being reconfigured.
     x_error_trap error_trap(display_);
     // XShmGetImage fails if the window is partially out of screen.
-    xshm_get_image_succeeded_ = XShmGetImage(display_, window_, x_shm_image_, 0, 0, AllPlanes);
+    xshm_get_image_succeeded_ =
+        XShmGetImage(display_, source_, x_shm_image_, area_.left() + source_offset_,
+                     area_.top() + source_offset_, AllPlanes);
   }
 }
 
-bool x_server_pixel_buffer::capture_rect(const desktop_rect &rect, desktop_frame *frame) {
+bool x_server_pixel_buffer::capture_rect(const desktop_rect &rect, desktop_frame *frame,
+                                         desktop_region *dirty_region) {
   XImage *image;
   uint8_t *data;
 
-  if (shm_segment_info_ && (shm_pixmap_ || xshm_get_image_succeeded_)) {
+  if (shm_segment_ && (shm_pixmap_ || xshm_get_image_succeeded_)) {
     if (shm_pixmap_) {
-      XCopyArea(display_, window_, shm_pixmap_, shm_gc_, rect.left(), rect.top(), rect.width(),
-                rect.height(), rect.left(), rect.top());
+      XCopyArea(display_, source_, shm_pixmap_, shm_gc_, rect.left() + source_offset_,
+                rect.top() + source_offset_, rect.width(), rect.height(),
+                rect.left() - area_.left(), rect.top() - area_.top());
       XSync(display_, False);
     }
 
     image = x_shm_image_;
-    data = reinterpret_cast<uint8_t *>(image->data) + rect.top() * image->bytes_per_line +
-           rect.left() * image->bits_per_pixel / 8;
+    data = reinterpret_cast<uint8_t *>(image->data) +
+           (rect.top() - area_.top()) * image->bytes_per_line +
+           (rect.left() - area_.left()) * image->bits_per_pixel / 8;
 
   } else {
     if (x_image_)
       XDestroyImage(x_image_);
-    x_image_ = XGetImage(display_, window_, rect.left(), rect.top(), rect.width(), rect.height(),
-                         AllPlanes, ZPixmap);
+    x_image_ = XGetImage(display_, source_, rect.left() + source_offset_,
+                         rect.top() + source_offset_, rect.width(), rect.height(), AllPlanes,
+                         ZPixmap);
     if (!x_image_)
       return false;
 
@@ -326,9 +340,14 @@ bool x_server_pixel_buffer::capture_rect(const desktop_rect &rect, desktop_frame
   }
 
   if (IsXImageRGBFormat(image)) {
-    FastBlit(image, data, rect, frame);
+    FastBlit(image, data, rect, frame, dirty_region);
   } else {
     SlowBlit(image, data, rect, frame);
+    if (dirty_region) {
+      dirty_region->add_rect(desktop_rect::make_xywh(rect.left() - frame->top_left().x(),
+                                                     rect.top() - frame->top_left().y(),
+                                                     rect.width(), rect.height()));
+    }
   }
 
   if (!icc_profile_.empty())
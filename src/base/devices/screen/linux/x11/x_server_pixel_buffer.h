@@ -23,7 +23,9 @@ namespace traa {
 namespace base {
 
 class desktop_frame;
+class desktop_region;
 class x_atom_cache;
+class x_shm_segment;
 
 // A class to allow the X server's pixel buffer to be accessed as efficiently
 // as possible.
@@ -39,7 +41,17 @@ public:
 
   // Allocate (or reallocate) the pixel buffer for `window`. Returns false in
   // case of an error (e.g. window doesn't exist).
-  bool init(x_atom_cache *cache, Window window);
+  //
+  // If `source` is set, the pixels are read from it instead of from `window`.
+  // It is meant for the pixmap XCompositeNameWindowPixmap() names for a
+  // redirected `window`, which holds the content of the window even while other
+  // windows cover it, and includes its border. The buffer does not free it.
+  //
+  // If `area` is not empty, only that part of `window`, in the coordinates of
+  // `window`, is read, e.g. one monitor of the root window. The shared memory
+  // is sized to it, so synchronize() does not read the rest of the window.
+  bool init(x_atom_cache *cache, Window window, Pixmap source = 0,
+            const desktop_rect &area = desktop_rect());
 
   bool is_initialized() { return window_ != 0; }
 
@@ -49,6 +61,10 @@ public:
   // Returns the rectangle of the window the buffer was initialized for.
   const desktop_rect &window_rect() { return window_rect_; }
 
+  // Returns the part of the window the buffer reads, in the coordinates of the
+  // window.
+  const desktop_rect &area() { return area_; }
+
   // Returns true if the window can be found.
   bool is_window_valid() const;
 
@@ -62,8 +78,14 @@ public:
   // Capture the specified rectangle and stores it in the `frame`. In the case
   // where the full-screen data is captured by synchronize(), this simply
   // returns the pointer without doing any more work. The caller must ensure
-  // that `rect` is not larger than window_size().
-  bool capture_rect(const desktop_rect &rect, desktop_frame *frame);
+  // that `rect` is inside area().
+  //
+  // If `dirty_region` is not null, the captured pixels are compared with the
+  // previous content of `frame` while being copied, and the blocks which
+  // changed are added to `dirty_region` in `frame` coordinates. Pixel formats
+  // which need a conversion report the entire `rect` as changed.
+  bool capture_rect(const desktop_rect &rect, desktop_frame *frame,
+                    desktop_region *dirty_region = nullptr);
 
 private:
   void release_shm_segment();
@@ -74,8 +96,13 @@ private:
   Display *display_ = nullptr;
   Window window_ = 0;
   desktop_rect window_rect_;
+  desktop_rect area_;
+  // The drawable the pixels are read from, and the position of the content of
+  // `window_` in it.
+  Drawable source_ = 0;
+  int source_offset_ = 0;
   XImage *x_image_ = nullptr;
-  XShmSegmentInfo *shm_segment_info_ = nullptr;
+  std::unique_ptr<x_shm_segment> shm_segment_;
   XImage *x_shm_image_ = nullptr;
   Pixmap shm_pixmap_ = 0;
   GC shm_gc_ = nullptr;
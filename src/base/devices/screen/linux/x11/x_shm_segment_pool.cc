@@ -0,0 +1,327 @@
+#include "base/devices/screen/linux/x11/x_shm_segment_pool.h"
+
+#include "base/devices/screen/linux/x11/x_error_trap.h"
+#include "base/logger.h"
+
+#include <X11/Xlibint.h>
+// Xlibint.h defines min() and max() macros, which break the C++ headers.
+#undef min
+#undef max
+
+#if defined(TRAA_ENABLE_XCB_SHM)
+#include <X11/Xlib-xcb.h>
+#include <xcb/shm.h>
+#include <xcb/xcb.h>
+#endif // TRAA_ENABLE_XCB_SHM
+
+#include <stdlib.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/shm.h>
+#include <unistd.h>
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// The smallest segment allocated, smaller windows share it.
+constexpr size_t k_min_segment_size = 64 * 1024;
+
+// The segments kept for a display.
+struct display_pool {
+  uint64_t id = 0;
+  // Whether the server takes memfds, known after the first attempt.
+  bool memfd_checked = false;
+  bool use_memfd = false;
+  // The released segments, the most recently released last.
+  std::deque<std::unique_ptr<x_shm_segment>> free_segments;
+  size_t free_bytes = 0;
+};
+
+std::mutex &pools_mutex() {
+  static std::mutex *mutex = new std::mutex();
+  return *mutex;
+}
+
+std::map<Display *, display_pool> &pools() {
+  static std::map<Display *, display_pool> *pools = new std::map<Display *, display_pool>();
+  return *pools;
+}
+
+uint64_t g_next_pool_id = 1;
+
+// The free_bytes of all pools.
+size_t g_total_free_bytes = 0;
+
+// Called by XCloseDisplay(). The server detaches the segments of a closed
+// connection itself, so they are only unmapped here.
+int on_display_closed(Display *display, XExtCodes *) {
+  std::deque<std::unique_ptr<x_shm_segment>> segments;
+  {
+    std::lock_guard<std::mutex> lock(pools_mutex());
+    auto it = pools().find(display);
+    if (it == pools().end()) {
+      return 0;
+    }
+    segments.swap(it->second.free_segments);
+    g_total_free_bytes -= it->second.free_bytes;
+    pools().erase(it);
+  }
+  return 0;
+}
+
+} // namespace
+
+x_shm_segment::~x_shm_segment() {
+  if (!info_.shmaddr) {
+    return;
+  }
+  if (is_memfd_) {
+    munmap(info_.shmaddr, size_);
+  } else {
+    shmdt(info_.shmaddr);
+  }
+}
+
+// static
+size_t x_shm_segment_pool::bucket_size(size_t size) {
+  if (size <= k_min_segment_size) {
+    return k_min_segment_size;
+  }
+
+  // Eight buckets between two powers of two, so a segment is at most 25%
+  // larger than asked for.
+  size_t power = k_min_segment_size;
+  while (power < size) {
+    power <<= 1;
+  }
+  const size_t step = power / 8;
+  return (size + step - 1) / step * step;
+}
+
+// static
+size_t x_shm_segment_pool::count_to_evict(const std::vector<size_t> &sizes,
+                                          size_t other_free_bytes) {
+  size_t bytes = 0;
+  for (size_t size : sizes) {
+    bytes += size;
+  }
+
+  size_t count = 0;
+  while (count < sizes.size() &&
+         (sizes.size() - count > k_max_free_segments || bytes > k_max_free_bytes ||
+          other_free_bytes + bytes > k_max_total_free_bytes)) {
+    bytes -= sizes[count];
+    count++;
+  }
+  return count;
+}
+
+// static
+std::unique_ptr<x_shm_segment> x_shm_segment_pool::acquire(Display *display, size_t size) {
+  const size_t bucket = bucket_size(size);
+
+  uint64_t pool_id = 0;
+#if defined(TRAA_ENABLE_XCB_SHM)
+  bool try_memfd = false;
+#endif // TRAA_ENABLE_XCB_SHM
+  {
+    std::lock_guard<std::mutex> lock(pools_mutex());
+    auto it = pools().find(display);
+    if (it == pools().end()) {
+      // Free the segments when the display is closed, as the Display may be
+      // allocated again at the same address.
+      XExtCodes *codes = XAddExtension(display);
+      if (!codes) {
+        return nullptr;
+      }
+      XESetCloseDisplay(display, codes->extension, &on_display_closed);
+
+      it = pools().emplace(display, display_pool()).first;
+      it->second.id = g_next_pool_id++;
+    }
+
+    display_pool &pool = it->second;
+    pool_id = pool.id;
+#if defined(TRAA_ENABLE_XCB_SHM)
+    try_memfd = !pool.memfd_checked || pool.use_memfd;
+#endif // TRAA_ENABLE_XCB_SHM
+
+    // Take the smallest free segment large enough, unless it is more than a
+    // power of two larger, which would waste memory for a small window.
+    auto best = pool.free_segments.end();
+    for (auto segment = pool.free_segments.begin(); segment != pool.free_segments.end();
+         ++segment) {
+      const size_t segment_size = (*segment)->size();
+      if (segment_size >= size && segment_size <= bucket * 2 &&
+          (best == pool.free_segments.end() || segment_size < (*best)->size())) {
+        best = segment;
+      }
+    }
+    if (best != pool.free_segments.end()) {
+      std::unique_ptr<x_shm_segment> segment = std::move(*best);
+      pool.free_segments.erase(best);
+      pool.free_bytes -= segment->size();
+      g_total_free_bytes -= segment->size();
+      return segment;
+    }
+  }
+
+  // Attaching takes a round trip, the pool is not locked meanwhile.
+  std::unique_ptr<x_shm_segment> segment(new x_shm_segment());
+  segment->size_ = bucket;
+  segment->pool_id_ = pool_id;
+  segment->info_.shmid = -1;
+  segment->info_.readOnly = False;
+
+  bool attached = false;
+#if defined(TRAA_ENABLE_XCB_SHM)
+  if (try_memfd) {
+    attached = attach_memfd(display, segment.get());
+
+    std::lock_guard<std::mutex> lock(pools_mutex());
+    auto it = pools().find(display);
+    if (it != pools().end() && it->second.id == pool_id) {
+      it->second.memfd_checked = true;
+      it->second.use_memfd = attached;
+    }
+  }
+#endif // TRAA_ENABLE_XCB_SHM
+  if (!attached) {
+    attached = attach_sysv(display, segment.get());
+  }
+  return attached ? std::move(segment) : nullptr;
+}
+
+// static
+void x_shm_segment_pool::recycle(Display *display, std::unique_ptr<x_shm_segment> segment) {
+  if (!segment) {
+    return;
+  }
+
+  std::vector<std::unique_ptr<x_shm_segment>> evicted;
+  {
+    std::lock_guard<std::mutex> lock(pools_mutex());
+    auto it = pools().find(display);
+    if (it == pools().end() || it->second.id != segment->pool_id_) {
+      // The display was closed, the server detached the segment already.
+      return;
+    }
+
+    display_pool &pool = it->second;
+    pool.free_bytes += segment->size();
+    g_total_free_bytes += segment->size();
+    pool.free_segments.push_back(std::move(segment));
+
+    // Only the segments of `display` are detached, the other displays may be
+    // in use by other threads. The total stays within the limit all the same,
+    // as it only grows here.
+    std::vector<size_t> sizes;
+    sizes.reserve(pool.free_segments.size());
+    for (const std::unique_ptr<x_shm_segment> &free_segment : pool.free_segments) {
+      sizes.push_back(free_segment->size());
+    }
+    size_t count = count_to_evict(sizes, g_total_free_bytes - pool.free_bytes);
+    for (; count > 0; count--) {
+      pool.free_bytes -= pool.free_segments.front()->size();
+      g_total_free_bytes -= pool.free_segments.front()->size();
+      evicted.push_back(std::move(pool.free_segments.front()));
+      pool.free_segments.pop_front();
+    }
+  }
+
+  for (std::unique_ptr<x_shm_segment> &old_segment : evicted) {
+    XShmDetach(display, old_segment->info());
+  }
+}
+
+// static
+bool x_shm_segment_pool::attach_sysv(Display *display, x_shm_segment *segment) {
+  XShmSegmentInfo *info = segment->info();
+  info->shmid = shmget(IPC_PRIVATE, segment->size(), IPC_CREAT | 0600);
+  if (info->shmid == -1) {
+    LOG_WARN("Failed to get shared memory segment. Performance may be degraded.");
+    return false;
+  }
+
+  bool attached = false;
+  void *shmat_result = shmat(info->shmid, 0, 0);
+  if (shmat_result != reinterpret_cast<void *>(-1)) {
+    info->shmaddr = reinterpret_cast<char *>(shmat_result);
+
+    x_error_trap error_trap(display);
+    attached = XShmAttach(display, info);
+    XSync(display, False);
+    if (error_trap.get_last_error_and_disable() != 0) {
+      attached = false;
+    }
+  }
+
+  // The segment lives on until it is detached by both this process and the X
+  // server.
+  shmctl(info->shmid, IPC_RMID, 0);
+  info->shmid = -1;
+  if (!attached && info->shmaddr) {
+    shmdt(info->shmaddr);
+    info->shmaddr = nullptr;
+  }
+  return attached;
+}
+
+#if defined(TRAA_ENABLE_XCB_SHM)
+// static
+bool x_shm_segment_pool::attach_memfd(Display *display, x_shm_segment *segment) {
+  xcb_connection_t *connection = XGetXCBConnection(display);
+
+  // ShmAttachFd needs MIT-SHM 1.2, and a local connection to pass the fd.
+  xcb_generic_error_t *error = nullptr;
+  xcb_shm_query_version_reply_t *version =
+      xcb_shm_query_version_reply(connection, xcb_shm_query_version(connection), &error);
+  const bool has_attach_fd =
+      version && (version->major_version > 1 ||
+                  (version->major_version == 1 && version->minor_version >= 2));
+  free(version);
+  free(error);
+  if (!has_attach_fd) {
+    return false;
+  }
+
+  int fd = memfd_create("traa_x_shm", MFD_CLOEXEC);
+  if (fd == -1) {
+    return false;
+  }
+  void *data = MAP_FAILED;
+  if (ftruncate(fd, static_cast<off_t>(segment->size())) == 0) {
+    data = mmap(nullptr, segment->size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if (data == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+
+  // XCB closes `fd` once it is sent.
+  const uint32_t shmseg = xcb_generate_id(connection);
+  error = xcb_request_check(connection, xcb_shm_attach_fd_checked(connection, shmseg, fd, 0));
+  if (error) {
+    free(error);
+    munmap(data, segment->size());
+    return false;
+  }
+
+  segment->is_memfd_ = true;
+  segment->info_.shmseg = shmseg;
+  segment->info_.shmaddr = static_cast<char *>(data);
+  LOG_DEBUG("Using X shared memory from a memfd, segment {}", shmseg);
+  return true;
+}
+#endif // TRAA_ENABLE_XCB_SHM
+
+} // namespace base
+} // namespace traa
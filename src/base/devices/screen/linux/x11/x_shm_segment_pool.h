@@ -0,0 +1,90 @@
+#ifndef TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_SHM_SEGMENT_POOL_H_
+#define TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_SHM_SEGMENT_POOL_H_
+
+#include <X11/Xlib.h>
+#include <X11/extensions/XShm.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <vector>
+
+namespace traa {
+namespace base {
+
+// A shared memory segment attached to an X display with MIT-SHM. Backed by a
+// memfd passed with ShmAttachFd where the server supports it, so the segments
+// do not count against kernel.shmmax and kernel.shmmni, and by a SysV segment
+// otherwise.
+//
+// Destroying a segment only unmaps it, x_shm_segment_pool detaches it.
+class x_shm_segment {
+public:
+  ~x_shm_segment();
+
+  x_shm_segment(const x_shm_segment &) = delete;
+  x_shm_segment &operator=(const x_shm_segment &) = delete;
+
+  // The segment to pass to the XShm functions, e.g. XShmCreateImage().
+  XShmSegmentInfo *info() { return &info_; }
+  char *data() const { return info_.shmaddr; }
+  size_t size() const { return size_; }
+
+private:
+  friend class x_shm_segment_pool;
+
+  x_shm_segment() = default;
+
+  XShmSegmentInfo info_ = {};
+  size_t size_ = 0;
+  bool is_memfd_ = false;
+  // The id of the pool the segment was attached by.
+  uint64_t pool_id_ = 0;
+};
+
+// Keeps the segments of each X display attached once they are released, so
+// grabbing many windows one after another does not create, attach and destroy
+// a segment for each of them. Segments are allocated in size buckets, so
+// windows of similar sizes share them. The segments of a display are freed
+// when the display is closed. Displays that stay open, like those of the
+// capture threads, share a limit on the segments kept for all of them.
+//
+// Thread-safe. A display must only be used by one thread at a time, as usual.
+class x_shm_segment_pool {
+public:
+  // The most released segments kept attached to a display, and their largest
+  // total size.
+  static constexpr size_t k_max_free_segments = 8;
+  static constexpr size_t k_max_free_bytes = 64 * 1024 * 1024;
+  // The largest total size of the released segments kept for all displays.
+  static constexpr size_t k_max_total_free_bytes = 128 * 1024 * 1024;
+
+  // Returns a segment of at least `size` bytes attached to `display`, or
+  // nullptr if MIT-SHM can not be used.
+  static std::unique_ptr<x_shm_segment> acquire(Display *display, size_t size);
+
+  // Gives `segment` of `display` back to the pool. It may be handed out again
+  // by acquire(), or detached if the pool of `display` is full.
+  static void recycle(Display *display, std::unique_ptr<x_shm_segment> segment);
+
+  // Returns the size of the segment acquire() allocates for `size` bytes.
+  static size_t bucket_size(size_t size);
+
+  // Returns how many of the released segments of a display, of `sizes` bytes
+  // from the least to the most recently released, are detached to stay within
+  // the limits while the other displays keep `other_free_bytes` bytes.
+  static size_t count_to_evict(const std::vector<size_t> &sizes, size_t other_free_bytes);
+
+private:
+  // Create a segment of segment->size() bytes and attach it to `display`.
+  static bool attach_sysv(Display *display, x_shm_segment *segment);
+#if defined(TRAA_ENABLE_XCB_SHM)
+  static bool attach_memfd(Display *display, x_shm_segment *segment);
+#endif // TRAA_ENABLE_XCB_SHM
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_LINUX_X11_X_SHM_SEGMENT_POOL_H_
@@ -0,0 +1,68 @@
+// gtest comes before the X headers, which define None.
+#include <gtest/gtest.h>
+
+#include "base/devices/screen/linux/x11/x_shm_segment_pool.h"
+
+#include <stddef.h>
+
+#include <vector>
+
+namespace traa {
+namespace base {
+
+TEST(x_shm_segment_pool_test, bucket_size_has_a_minimum) {
+  const size_t minimum = x_shm_segment_pool::bucket_size(1);
+  EXPECT_GT(minimum, 0u);
+  EXPECT_EQ(minimum, x_shm_segment_pool::bucket_size(0));
+  EXPECT_EQ(minimum, x_shm_segment_pool::bucket_size(minimum));
+  EXPECT_LT(minimum, x_shm_segment_pool::bucket_size(minimum + 1));
+}
+
+TEST(x_shm_segment_pool_test, bucket_size_fits_with_little_waste) {
+  const size_t minimum = x_shm_segment_pool::bucket_size(1);
+  for (size_t size = minimum; size < 64 * 1024 * 1024; size = size * 9 / 7 + 4093) {
+    const size_t bucket = x_shm_segment_pool::bucket_size(size);
+    EXPECT_GE(bucket, size);
+    EXPECT_LE(bucket, size + size / 4);
+    // The bucket of a bucket size is itself, so recycled segments match.
+    EXPECT_EQ(bucket, x_shm_segment_pool::bucket_size(bucket));
+  }
+}
+
+TEST(x_shm_segment_pool_test, similar_sizes_share_a_bucket) {
+  // Two 1920x1080 windows whose heights differ by a few rows.
+  EXPECT_EQ(x_shm_segment_pool::bucket_size(1920 * 4 * 1080),
+            x_shm_segment_pool::bucket_size(1920 * 4 * 1076));
+}
+
+TEST(x_shm_segment_pool_test, keeps_segments_within_the_display_limits) {
+  const size_t mb = 1024 * 1024;
+  EXPECT_EQ(0u, x_shm_segment_pool::count_to_evict({}, 0));
+  EXPECT_EQ(0u, x_shm_segment_pool::count_to_evict({8 * mb, 8 * mb}, 0));
+
+  // Too many segments, the least recently released go first.
+  std::vector<size_t> sizes(x_shm_segment_pool::k_max_free_segments + 2, mb);
+  EXPECT_EQ(2u, x_shm_segment_pool::count_to_evict(sizes, 0));
+
+  // Too many bytes.
+  EXPECT_EQ(1u, x_shm_segment_pool::count_to_evict(
+                    {x_shm_segment_pool::k_max_free_bytes, mb}, 0));
+  EXPECT_EQ(1u, x_shm_segment_pool::count_to_evict(
+                    {x_shm_segment_pool::k_max_free_bytes + mb}, 0));
+}
+
+TEST(x_shm_segment_pool_test, keeps_segments_within_the_total_limit) {
+  const size_t mb = 1024 * 1024;
+  const size_t others = x_shm_segment_pool::k_max_total_free_bytes - 20 * mb;
+  EXPECT_EQ(0u, x_shm_segment_pool::count_to_evict({10 * mb, 10 * mb}, others));
+  EXPECT_EQ(1u, x_shm_segment_pool::count_to_evict({10 * mb, 10 * mb, mb}, others));
+  EXPECT_EQ(2u, x_shm_segment_pool::count_to_evict({30 * mb, 20 * mb, 10 * mb}, others + mb));
+
+  // A display whose segments alone are within its limit keeps none when the
+  // other displays take the whole total.
+  EXPECT_EQ(2u, x_shm_segment_pool::count_to_evict(
+                    {mb, mb}, x_shm_segment_pool::k_max_total_free_bytes));
+}
+
+} // namespace base
+} // namespace traa
@@ -2,10 +2,17 @@
 
 #include "base/arch.h"
 #include "base/devices/screen/desktop_frame.h"
+#include "base/devices/screen/linux/x11/shared_x_display.h"
 #include "base/devices/screen/linux/x11/x_error_trap.h"
+#include "base/devices/screen/linux/x11/x_image_converter.h"
+#include "base/devices/screen/linux/x11/x_render_scaler.h"
 #include "base/devices/screen/linux/x11/x_server_pixel_buffer.h"
 #include "base/devices/screen/linux/x11/x_window_property.h"
+#include "base/devices/screen/linux/x11/xcb_window_query.h"
+#include "base/devices/screen/parallel_scale.h"
 #include "base/devices/screen/utils.h"
+#include "base/platform_thread.h"
+#include "base/system/cpu_info.h"
 
 #include "base/logger.h"
 
@@ -13,17 +20,31 @@
 
 #include <X11/Xatom.h>
 #include <X11/extensions/Xcomposite.h>
+#include <X11/extensions/XShm.h>
 #include <X11/extensions/Xrandr.h>
 #include <X11/extensions/composite.h>
+#if defined(TRAA_ENABLE_XRENDER)
+#include <X11/extensions/Xrender.h>
+#endif
 
 #include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include <errno.h>
 #include <fcntl.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <poll.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/socket.h>
 
 #define TRAA_DUMP_IMAGES 0
 
@@ -44,86 +65,26 @@ private:
   void *const data_;
 };
 
-// Iterates through `window` hierarchy to find first visible window, i.e. one
-// that has WM_STATE property set to NormalState.
-// See http://tronche.com/gui/x/icccm/sec-4.html#s-4.1.3.1 .
-::Window get_application_window(x_atom_cache *cache, ::Window window) {
-  int32_t state = x_window_list_utils::get_window_state(cache, window);
-  if (state == NormalState) {
-    // Window has WM_STATE==NormalState. Return it.
-    return window;
-  } else if (state == IconicState) {
-    // Window is in minimized. Skip it.
-    return 0;
-  }
-
-  // If the window is in WithdrawnState then look at all of its children.
-  ::Window root, parent;
-  ::Window *children;
-  unsigned int num_children;
-  if (!XQueryTree(cache->display(), window, &root, &parent, &children, &num_children)) {
-    LOG_ERROR("failed to query for child windows although window does not have a valid WM_STATE.");
-    return 0;
-  }
-  ::Window app_window = 0;
-  for (unsigned int i = 0; i < num_children; ++i) {
-    app_window = get_application_window(cache, children[i]);
-    if (app_window)
-      break;
-  }
-
-  if (children)
-    XFree(children);
-  return app_window;
-}
-
-// Returns true if the `window` is a desktop element.
-bool is_desktop_element(x_atom_cache *cache, ::Window window) {
-  if (window == 0)
-    return false;
-
-  // First look for _NET_WM_WINDOW_TYPE. The standard
-  // (http://standards.freedesktop.org/wm-spec/latest/ar01s05.html#id2760306)
-  // says this hint *should* be present on all windows, and we use the existence
-  // of _NET_WM_WINDOW_TYPE_NORMAL in the property to indicate a window is not
-  // a desktop element (that is, only "normal" windows should be shareable).
-  x_window_property<uint32_t> window_type(cache->display(), window, cache->window_type());
-  if (window_type.is_valid() && window_type.size() > 0) {
-    uint32_t *end = window_type.data() + window_type.size();
-    bool is_normal = (end != std::find(window_type.data(), end, cache->window_type_normal()));
-    return !is_normal;
-  }
-
-  // Fall back on using the hint.
-  XClassHint class_hint;
-  Status status = XGetClassHint(cache->display(), window, &class_hint);
-  if (status == 0) {
-    // No hints, assume this is a normal application window.
-    return false;
+// Redirects `window` to off-screen storage while it is alive. A redirection
+// otherwise lasts as long as the connection of the client, which is the whole
+// process for the enumeration connection.
+class scoped_composite_redirect {
+public:
+  scoped_composite_redirect(Display *display, ::Window window)
+      : display_(display), window_(window) {
+    XCompositeRedirectWindow(display_, window_, CompositeRedirectAutomatic);
   }
-
-  defer_x_free free_res_name(class_hint.res_name);
-  defer_x_free free_res_class(class_hint.res_class);
-  return strcmp("gnome-panel", class_hint.res_name) == 0 ||
-         strcmp("desktop_window", class_hint.res_name) == 0;
-}
-
-bool is_window_visible(Display *display, ::Window window) {
-  x_error_trap error_trap(display);
-  XWindowAttributes attrs;
-  if (!XGetWindowAttributes(display, window, &attrs) ||
-      error_trap.get_last_error_and_disable() != 0) {
-    LOG_ERROR("failed to get window attributes for window {}", window);
-    return false;
+  ~scoped_composite_redirect() {
+    // The window may be gone already.
+    x_error_trap error_trap(display_);
+    XCompositeUnredirectWindow(display_, window_, CompositeRedirectAutomatic);
+    XSync(display_, False);
   }
 
-  return attrs.map_state == IsViewable;
-}
-
-bool is_window_minimized(x_atom_cache *cache, ::Window window) {
-  int32_t state = x_window_list_utils::get_window_state(cache, window);
-  return state == IconicState;
-}
+private:
+  Display *const display_;
+  const ::Window window_;
+};
 
 bool is_window_fullscreen(x_atom_cache *cache, ::Window window) {
   //   x_window_property<Atom> window_state(cache->display(), window, cache->wm_state());
@@ -176,13 +137,28 @@ bool get_window_image_data(x_atom_cache *cache, ::Window window, const desktop_r
   }
 
   // use libyuv to scale the image
-  libyuv::ARGBScale(reinterpret_cast<uint8_t *>(image->data), image->bytes_per_line, image->width,
-                    image->height, *data, scaled_size.width * k_bytes_per_pixel, scaled_size.width,
-                    scaled_size.height, libyuv::kFilterBox);
+  parallel_scale_argb(reinterpret_cast<uint8_t *>(image->data), image->bytes_per_line,
+                      image->width, image->height, *data, scaled_size.width * k_bytes_per_pixel,
+                      scaled_size.width, scaled_size.height, libyuv::kFilterBox);
 
   XDestroyImage(image);
 #else
-  XCompositeRedirectWindow(cache->display(), window, CompositeRedirectAutomatic);
+  scoped_composite_redirect redirect(cache->display(), window);
+
+  // Scale on the server where possible, so only the thumbnail is transferred.
+  x_render_scaler scaler(cache->display());
+  if (scaler.is_supported()) {
+    scaled_size = calc_scaled_size(window_rect.size(), target_size).to_traa_size();
+    *data = new uint8_t[scaled_size.width * scaled_size.height * desktop_frame::k_bytes_per_pixel];
+    if (scaler.scale(window, desktop_rect::make_size(window_rect.size()),
+                     desktop_size(scaled_size.width, scaled_size.height), *data,
+                     scaled_size.width * desktop_frame::k_bytes_per_pixel)) {
+      return true;
+    }
+    LOG_WARN("failed to scale window {} with XRender, fall back to a full grab", window);
+    delete[] *data;
+    *data = nullptr;
+  }
 
   x_server_pixel_buffer pixel_buffer;
   if (!pixel_buffer.init(cache, window)) {
@@ -205,39 +181,83 @@ bool get_window_image_data(x_atom_cache *cache, ::Window window, const desktop_r
   }
 
   // use libyuv to scale the image
-  libyuv::ARGBScale(frame.data(), frame.stride(), frame.size().width(), frame.size().height(),
-                    *data, scaled_size.width * desktop_frame::k_bytes_per_pixel, scaled_size.width,
-                    scaled_size.height, libyuv::kFilterBox);
+  parallel_scale_argb(frame.data(), frame.stride(), frame.size().width(), frame.size().height(),
+                      *data, scaled_size.width * desktop_frame::k_bytes_per_pixel,
+                      scaled_size.width, scaled_size.height, libyuv::kFilterBox);
 #endif // USE_XIMAGE_DIRECTLY
 
   return true;
 }
 
-pid_t get_pid_by_window(Display *display, ::Window window) {
-  Atom pid_atom = XInternAtom(display, "_NET_WM_PID", True);
-  if (pid_atom == None) {
-    return -1;
-  }
+// The maximum number of X connections grabbing thumbnails at the same time.
+constexpr int k_max_thumbnail_connections = 4;
 
-  Atom actual_type;
-  int actual_format;
-  unsigned long nitems, bytes_after;
-  unsigned char *prop = nullptr;
+// A window whose thumbnail is grabbed by get_window_thumbnails().
+struct window_thumbnail_task {
+  ::Window window = 0;
+  desktop_rect rect;
+  uint8_t *data = nullptr;
+  traa_size size;
+  bool succeeded = false;
+};
 
-  x_error_trap error_trap(display);
-  if ((XGetWindowProperty(display, window, pid_atom, 0, 1, False, XA_CARDINAL, &actual_type,
-                          &actual_format, &nitems, &bytes_after, &prop) != Success) ||
-      error_trap.get_last_error_and_disable() != 0) {
-    return -1;
+// Returns the number of worker connections get_window_thumbnails() uses for
+// `task_count` thumbnails, besides the connection of the calling thread.
+int thumbnail_worker_count(size_t task_count) {
+  const int cores = static_cast<int>(cpu_info::detect_number_of_cores());
+  const int connections =
+      std::min({cores, k_max_thumbnail_connections, static_cast<int>(task_count)});
+  return std::max(connections - 1, 0);
+}
+
+// Initializes the extensions get_window_image_data() uses on `display`. Xlib
+// does not guard its per display extension records unless XInitThreads() was
+// called first, so this runs on the thread which owns the enumeration before
+// any worker uses `display`.
+void init_thumbnail_extensions(Display *display) {
+  int event_base, error_base;
+  XCompositeQueryExtension(display, &event_base, &error_base);
+  XShmQueryExtension(display);
+#if defined(TRAA_ENABLE_XRENDER)
+  // x_render_scaler also reads the version and the formats, which Xlib caches
+  // on first use.
+  int major = 0, minor = 0;
+  if (XRenderQueryExtension(display, &event_base, &error_base) &&
+      XRenderQueryVersion(display, &major, &minor)) {
+    XRenderQueryFormats(display);
   }
+#endif
+}
 
-  if (nitems == 0) {
-    return -1;
+// Grabs the thumbnails of `tasks`. The X server handles the requests of one
+// connection one after another, so the tasks are fanned out across worker
+// threads which each own one of `worker_caches`, connections to the display of
+// `cache`, while the calling thread works on `cache` itself.
+void get_window_thumbnails(x_atom_cache *cache, const std::vector<x_atom_cache *> &worker_caches,
+                           const traa_size &thumbnail_size,
+                           std::vector<window_thumbnail_task> &tasks) {
+  init_thumbnail_extensions(cache->display());
+
+  std::atomic<size_t> next_task(0);
+  auto run_tasks = [&](x_atom_cache *worker_cache) {
+    for (size_t i = next_task++; i < tasks.size(); i = next_task++) {
+      window_thumbnail_task &task = tasks[i];
+      task.succeeded = get_window_image_data(worker_cache, task.window, task.rect,
+                                             thumbnail_size, &task.data, task.size);
+    }
+  };
+
+  std::vector<platform_thread> workers;
+  for (size_t i = 0; i < worker_caches.size(); i++) {
+    x_atom_cache *worker_cache = worker_caches[i];
+    workers.push_back(platform_thread::spawn_joinable(
+        [&run_tasks, worker_cache]() { run_tasks(worker_cache); },
+        "traa_thumbnail_" + std::to_string(i)));
   }
+  run_tasks(cache);
 
-  pid_t pid = *(pid_t *)prop;
-  XFree(prop);
-  return pid;
+  // Join the workers, the enumeration owns their connections again.
+  workers.clear();
 }
 
 std::string get_process_path(pid_t pid) {
@@ -252,101 +272,713 @@ std::string get_process_path(pid_t pid) {
   return std::string(exe_path);
 }
 
-bool get_window_icon(Display *display, ::Window window, std::vector<uint8_t> &icon_data, int &width,
-                     int &height) {
-  Atom icon_atom = XInternAtom(display, "_NET_WM_ICON", True);
+// The location of one icon in the _NET_WM_ICON property of a window.
+struct net_wm_icon_entry {
+  int width;
+  int height;
+  // The offset of the first pixel in the property, in CARDINALs.
+  long offset;
+};
+
+// Icons larger than this are considered corrupted.
+constexpr unsigned long k_max_icon_side = 4096;
+
+// Reads the width and height of each icon in the _NET_WM_ICON property of
+// `window`, without fetching any pixels. Each header costs a round trip, but
+// fetching all the icons would cost megabytes for apps which ship 512x512
+// icons.
+bool get_window_icon_entries(Display *display, ::Window window, Atom icon_atom,
+                             std::vector<net_wm_icon_entry> &entries) {
+  // https://specifications.freedesktop.org/wm-spec/1.3/ar01s05.html#id-1.6.13
+  //
+  // _NET_WM_ICON CARDINAL[][2+n]/32
+  // This is an array of possible icons for the client. This specification does not stipulate what
+  // size these icons should be, but individual desktop environments or toolkits may do so. The
+  // Window Manager MAY scale any of these icons to an appropriate size.
+  //
+  // This is an array of 32bit packed CARDINAL ARGB with high byte being A, low
+  // byte being B. The first two cardinals are width, height. Data is in rows,
+  // left to right and top to bottom.
+  long offset = 0;
+  // The length of the property in CARDINALs, known after the first request.
+  long length = -1;
+  while (length < 0 || offset + 2 <= length) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, bytes_after;
+    unsigned char *prop = nullptr;
+
+    x_error_trap error_trap(display);
+    if ((XGetWindowProperty(display, window, icon_atom, offset, 2, False, AnyPropertyType,
+                            &actual_type, &actual_format, &nitems, &bytes_after,
+                            &prop) != Success) ||
+        error_trap.get_last_error_and_disable() != 0) {
+      return false;
+    }
+    defer_x_free free_prop(prop);
+
+    // Note that the icon data is stored as an array of 32-bit values, so the actual format should
+    // be 32 bits.
+    if (actual_format != 32 || nitems < 2) {
+      break;
+    }
+    length = offset + static_cast<long>(nitems + bytes_after / 4);
+
+    // Note that the prop data is stored as an array of longs(which in a 64-bit application will be
+    // 64-bit values that are padded in the upper 4 bytes), and the first two elements are width
+    // and height.
+    const unsigned long *data = reinterpret_cast<const unsigned long *>(prop);
+    const unsigned long width = data[0];
+    const unsigned long height = data[1];
+    if (width == 0 || height == 0 || width > k_max_icon_side || height > k_max_icon_side ||
+        static_cast<unsigned long>(length - offset - 2) < width * height) {
+      LOG_ERROR("invalid icon size {}x{} for window {}", width, height, window);
+      break;
+    }
+
+    entries.push_back({static_cast<int>(width), static_cast<int>(height), offset + 2});
+    offset += 2 + static_cast<long>(width * height);
+  }
+
+  return !entries.empty();
+}
+
+// Returns the smallest icon which covers `icon_size`, so it only needs to be
+// scaled down, or the largest icon if none does.
+const net_wm_icon_entry &select_window_icon(const std::vector<net_wm_icon_entry> &entries,
+                                            const traa_size &icon_size) {
+  const net_wm_icon_entry *best = nullptr;
+  const net_wm_icon_entry *largest = &entries.front();
+  for (const net_wm_icon_entry &entry : entries) {
+    const int64_t area = static_cast<int64_t>(entry.width) * entry.height;
+    if (area > static_cast<int64_t>(largest->width) * largest->height) {
+      largest = &entry;
+    }
+    if (entry.width >= icon_size.width && entry.height >= icon_size.height &&
+        (!best || area < static_cast<int64_t>(best->width) * best->height)) {
+      best = &entry;
+    }
+  }
+  return best ? *best : *largest;
+}
+
+// Gets the icon of `window` best suited to be scaled to `icon_size`, as
+// desktop_frame pixels.
+bool get_window_icon(x_atom_cache *cache, ::Window window, const traa_size &icon_size,
+                     std::vector<uint32_t> &icon_data, int &width, int &height) {
+  Display *display = cache->display();
+  Atom icon_atom = cache->net_wm_icon();
   if (icon_atom == None) {
     return false;
   }
 
+  std::vector<net_wm_icon_entry> entries;
+  if (!get_window_icon_entries(display, window, icon_atom, entries)) {
+    LOG_ERROR("no icon data for window {}", window);
+    return false;
+  }
+
+  // Fetch only the pixels of the selected icon.
+  const net_wm_icon_entry &entry = select_window_icon(entries, icon_size);
+  const long pixel_count = static_cast<long>(entry.width) * entry.height;
+
   Atom actual_type;
   int actual_format;
   unsigned long nitems, bytes_after;
   unsigned char *prop = nullptr;
 
   x_error_trap error_trap(display);
-  if ((XGetWindowProperty(display, window, icon_atom, 0, (~0L), False, AnyPropertyType,
-                          &actual_type, &actual_format, &nitems, &bytes_after, &prop) != Success) ||
+  if ((XGetWindowProperty(display, window, icon_atom, entry.offset, pixel_count, False,
+                          AnyPropertyType, &actual_type, &actual_format, &nitems, &bytes_after,
+                          &prop) != Success) ||
       error_trap.get_last_error_and_disable() != 0) {
     return false;
   }
+  defer_x_free free_prop(prop);
 
-  if (nitems == 0) {
-    LOG_ERROR("no icon data for window {}", window);
+  // The property may have changed since its headers were read.
+  if (actual_format != 32 || nitems != static_cast<unsigned long>(pixel_count)) {
+    LOG_ERROR("icon of window {} changed while reading it", window);
     return false;
   }
 
-  // https://www.x.org/archive/X11R7.5/doc/man/man3/XGetWindowProperty.3.html
-  // actual_format : If the returned format is 8, the returned data is represented as a char array.
-  // If the returned format is 16, the returned data is represented as a short array and should be
-  // cast to that type to obtain the elements. If the returned format is 32, the returned data is
-  // represented as a long array and should be cast to that type to obtain the elements.
-  //
-  // nitems: Returns the actual number of 8-bit, 16-bit, or 32-bit items stored in the prop_return
-  // data.
-  //
-  // prop: Returns the data in the specified format. If the returned format is 8, the returned data
-  // is represented as a char array. If the returned format is 16, the returned data is represented
-  // as a array of short int type and should be cast to that type to obtain the elements. If the
-  // returned format is 32, the property data will be stored as an array of longs (which in a 64-bit
-  // application will be 64-bit values that are padded in the upper 4 bytes).
+  width = entry.width;
+  height = entry.height;
+  icon_data.resize(pixel_count);
+  convert_x_cardinal_pixels(reinterpret_cast<const unsigned long *>(prop), icon_data.data(),
+                            static_cast<int>(pixel_count));
+  return true;
+}
 
-  // https://specifications.freedesktop.org/wm-spec/1.3/ar01s05.html#id-1.6.13
-  //
-  // _NET_WM_ICON CARDINAL[][2+n]/32
-  // This is an array of possible icons for the client. This specification does not stipulate what
-  // size these icons should be, but individual desktop environments or toolkits may do so. The
-  // Window Manager MAY scale any of these icons to an appropriate size.
-  //
-  // This is an array of 32bit packed CARDINAL ARGB with high byte being A, low
-  // byte being B. The first two cardinals are width, height. Data is in rows,
-  // left to right and top to bottom.
+// The icon of a window, and the scaled copy of it handed out by the latest
+// enumeration. A window without an icon has no pixels.
+struct window_icon {
+  // The icon_version of the window the icon was read at.
+  uint64_t version = 0;
+  std::vector<uint32_t> data;
+  int width = 0;
+  int height = 0;
+  traa_size requested_size;
+  traa_size scaled_size;
+  std::vector<uint8_t> scaled_data;
+};
 
-  // Note that the icon data is stored as an array of 32-bit values, so the actual format should be
-  // 32 bits.
-  if (actual_format != 32) {
-    LOG_ERROR("unexpected icon format: {}", actual_format);
-    XFree(prop);
-    return false;
+using window_icon_map_t = std::map<::Window, window_icon>;
+
+std::mutex &window_icon_cache_mutex() {
+  static std::mutex *mutex = new std::mutex();
+  return *mutex;
+}
+
+// The icons of the windows of the latest enumeration. An icon is read again
+// only if the window list model saw _NET_WM_ICON change since, and scaled again
+// only if its pixels did change.
+window_icon_map_t &window_icon_cache() {
+  static window_icon_map_t *cache = new window_icon_map_t();
+  return *cache;
+}
+
+// Scales `icon` to `icon_size`, or takes the scaled copy of `previous` if it
+// has the same pixels.
+void scale_window_icon(window_icon &icon, const traa_size &icon_size, window_icon *previous) {
+  icon.requested_size = icon_size;
+  if (previous && previous->requested_size.width == icon_size.width &&
+      previous->requested_size.height == icon_size.height && previous->width == icon.width &&
+      previous->height == icon.height && previous->data == icon.data) {
+    icon.scaled_size = previous->scaled_size;
+    icon.scaled_data = std::move(previous->scaled_data);
+    return;
   }
 
-  // Note that the prop data is stored as an array of longs(which in a 64-bit application will be
-  // 64-bit values that are padded in the upper 4 bytes), and the first two elements are width and
-  // height. So we just cast the prop to unsigned long and get the width and height(no matter
-  // sizeof(unsigned long) is 4 or 8).
-  unsigned long *data = reinterpret_cast<unsigned long *>(prop);
-  width = static_cast<int>(data[0]);
-  height = static_cast<int>(data[1]);
-
-  // Note that the prop data is stored as an array of longs(which in a 64-bit application will be
-  // 64-bit values that are padded in the upper 4 bytes), which means we need to implement two
-  // versions of the copy function, fast and slow. The fast version is used when the architecture is
-  // in 32-bit(directly copy the whole memory block), and the slow version is used when the
-  // architecture is in 64-bit(copy the memory block element by element).
-
-#if defined(TRAA_ARCH_32_BITS)
-  icon_data.assign(prop + 2 * sizeof(unsigned long), prop + nitems * sizeof(unsigned long));
-#elif defined(TRAA_ARCH_64_BITS)
-  // TODO(@sylar): this can be optimized by using some SIMD instructions.
-  icon_data.resize(width * height * desktop_frame::k_bytes_per_pixel);
-  for (int y = 0; y < height; y++) {
-    for (int x = 0; x < width; x++) {
-      unsigned long pixel = data[2 + y * width + x];
-      icon_data[(y * width + x) * desktop_frame::k_bytes_per_pixel + 3] =
-          (pixel >> (24)) & 0xff; // B
-      icon_data[(y * width + x) * desktop_frame::k_bytes_per_pixel + 2] =
-          (pixel >> (16)) & 0xff; // G
-      icon_data[(y * width + x) * desktop_frame::k_bytes_per_pixel + 1] =
-          (pixel >> (8)) & 0xff;                                                        // R
-      icon_data[(y * width + x) * desktop_frame::k_bytes_per_pixel + 0] = pixel & 0xff; // A
+  icon.scaled_size =
+      calc_scaled_size(desktop_size(icon.width, icon.height), icon_size).to_traa_size();
+  icon.scaled_data.resize(icon.scaled_size.width * icon.scaled_size.height *
+                          desktop_frame::k_bytes_per_pixel);
+  libyuv::ARGBScale(reinterpret_cast<const uint8_t *>(icon.data.data()),
+                    icon.width * desktop_frame::k_bytes_per_pixel, icon.width, icon.height,
+                    icon.scaled_data.data(),
+                    icon.scaled_size.width * desktop_frame::k_bytes_per_pixel,
+                    icon.scaled_size.width, icon.scaled_size.height, libyuv::kFilterBox);
+}
+
+// The next icon version handed out by the window list models. Only used with
+// the enumeration connection locked.
+uint64_t g_next_icon_version = 1;
+
+// The top-level windows of the screen and what enum_windows() lists of them,
+// kept up to date from X events instead of queried on every enumeration.
+//
+// The root window reports top-level windows being created, destroyed,
+// reparented, mapped, restacked and reconfigured, and changes of
+// _NET_CLIENT_LIST. The application windows report changes of the properties
+// enum_windows() reads and of their geometry. An event only marks the window
+// dirty, and snapshot() queries the dirty windows again, so listing a desktop
+// which did not change costs no round trip. Changes of _NET_WM_ICON only bump
+// the icon version of the window, the icon is read by enum_windows() itself.
+//
+// Must be used with the enumeration connection locked.
+class x_window_list_model : public shared_x_display::x_evt_handler {
+public:
+  // What enum_windows() needs to know about a top-level window.
+  struct window_entry {
+    ::Window top_level = 0;
+    // The window in NormalState under `top_level`, 0 if none.
+    ::Window app_window = 0;
+    // Whether `app_window` is a viewable window other than the desktop.
+    bool listable = false;
+    bool is_minimized = false;
+    bool is_maximized = false;
+    desktop_rect rect;
+    bool has_title = false;
+    std::string title;
+    std::string process_path;
+    // Changes whenever the icon of `app_window` may have changed, or
+    // `app_window` itself. Unique across the models of all the connections.
+    uint64_t icon_version = 0;
+  };
+
+  x_window_list_model(std::shared_ptr<shared_x_display> x_display, x_atom_cache *cache)
+      : x_display_(std::move(x_display)), cache_(cache) {
+    for (int type : k_event_types) {
+      x_display_->add_x_event_handler(type, this);
     }
   }
-#endif
 
-  XFree(prop);
-  return true;
+  ~x_window_list_model() override {
+    for (int type : k_event_types) {
+      x_display_->remove_x_event_handler(type, this);
+    }
+  }
+
+  x_window_list_model(const x_window_list_model &) = delete;
+  x_window_list_model &operator=(const x_window_list_model &) = delete;
+
+  // Starts watching the root window and lists its children. Returns false if
+  // the root window can not be watched.
+  bool init() {
+    Display *display = cache_->display();
+    root_ = DefaultRootWindow(display);
+
+    // Resolve the atoms now rather than while dispatching events.
+    watched_atoms_ = {XA_WM_NAME,
+                      XA_WM_CLASS,
+                      cache_->wm_state(),
+                      cache_->window_type(),
+                      cache_->net_wm_name(),
+                      cache_->net_wm_state(),
+                      cache_->net_wm_pid()};
+    client_list_atom_ = cache_->net_client_list();
+    icon_atom_ = cache_->net_wm_icon();
+
+    // Select the events before listing the windows, so no change is missed.
+    {
+      x_error_trap error_trap(display);
+      XSelectInput(display, root_, SubstructureNotifyMask | PropertyChangeMask);
+      XSync(display, False);
+      if (error_trap.get_last_error_and_disable() != 0) {
+        LOG_ERROR("failed to select the events of the root window");
+        return false;
+      }
+    }
+
+    ::Window root;
+    ::Window parent;
+    ::Window *children;
+    unsigned int num_children;
+    if (!XQueryTree(display, root_, &root, &parent, &children, &num_children)) {
+      LOG_ERROR("failed to query for child windows");
+      return false;
+    }
+    for (unsigned int i = 0; i < num_children; ++i) {
+      add_top_level(children[i]);
+    }
+    if (children) {
+      XFree(children);
+    }
+    return true;
+  }
+
+  // Processes the pending events, queries the dirty windows again and copies
+  // the listable windows to `windows` in stacking order, bottom first.
+  void snapshot(std::vector<window_entry> *windows) {
+    x_display_->process_pending_x_events();
+    refresh_dirty_windows();
+
+    windows->clear();
+    for (::Window window : stacking_order_) {
+      const tracked_window &tracked = windows_[window];
+      if (tracked.entry.listable) {
+        windows->push_back(tracked.entry);
+      }
+    }
+  }
+
+private:
+  static constexpr int k_event_types[] = {CreateNotify,    DestroyNotify, ReparentNotify,
+                                          MapNotify,       UnmapNotify,   ConfigureNotify,
+                                          CirculateNotify, PropertyNotify};
+
+  struct tracked_window {
+    window_entry entry;
+    bool dirty = true;
+  };
+
+  // shared_x_display::x_evt_handler interface.
+  bool on_x_event(const x_event_t &event) override {
+    switch (event.type) {
+    case CreateNotify:
+      if (event.xcreatewindow.parent == root_) {
+        add_top_level(event.xcreatewindow.window);
+      }
+      return true;
+    case DestroyNotify:
+      if (event.xdestroywindow.event == root_) {
+        remove_top_level(event.xdestroywindow.window);
+      } else {
+        mark_app_window_dirty(event.xdestroywindow.window);
+      }
+      return true;
+    case ReparentNotify:
+      if (event.xreparent.event != root_) {
+        mark_app_window_dirty(event.xreparent.window);
+      } else if (event.xreparent.parent == root_) {
+        add_top_level(event.xreparent.window);
+      } else {
+        remove_top_level(event.xreparent.window);
+      }
+      return true;
+    case MapNotify:
+      mark_dirty(event.xmap.event, event.xmap.window);
+      return true;
+    case UnmapNotify:
+      mark_dirty(event.xunmap.event, event.xunmap.window);
+      return true;
+    case ConfigureNotify:
+      if (event.xconfigure.event == root_) {
+        restack(event.xconfigure.window, event.xconfigure.above);
+      }
+      mark_dirty(event.xconfigure.event, event.xconfigure.window);
+      return true;
+    case CirculateNotify:
+      if (event.xcirculate.event == root_) {
+        restack(event.xcirculate.window,
+                event.xcirculate.place == PlaceOnTop ? stacking_top() : None);
+      }
+      return true;
+    case PropertyNotify:
+      on_property_changed(event.xproperty.window, event.xproperty.atom);
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  void on_property_changed(::Window window, Atom atom) {
+    if (window == root_) {
+      // A window became managed or unmanaged, the windows which had no
+      // application window may have one now.
+      if (atom == client_list_atom_) {
+        for (auto &window_and_tracked : windows_) {
+          if (!window_and_tracked.second.entry.app_window) {
+            window_and_tracked.second.dirty = true;
+          }
+        }
+      }
+      return;
+    }
+
+    if (atom != None && atom == icon_atom_) {
+      auto it = app_windows_.find(window);
+      if (it != app_windows_.end()) {
+        windows_[it->second].entry.icon_version = g_next_icon_version++;
+      }
+    } else if (std::find(watched_atoms_.begin(), watched_atoms_.end(), atom) !=
+               watched_atoms_.end()) {
+      mark_app_window_dirty(window);
+    }
+  }
+
+  // Marks the top-level `window` dirty if `event_window` is the root window,
+  // otherwise the top-level window of the application window `window`.
+  void mark_dirty(::Window event_window, ::Window window) {
+    if (event_window != root_) {
+      mark_app_window_dirty(window);
+      return;
+    }
+    auto it = windows_.find(window);
+    if (it != windows_.end()) {
+      it->second.dirty = true;
+    }
+  }
+
+  void mark_app_window_dirty(::Window app_window) {
+    auto it = app_windows_.find(app_window);
+    if (it != app_windows_.end()) {
+      windows_[it->second].dirty = true;
+    }
+  }
+
+  void add_top_level(::Window window) {
+    if (windows_.count(window)) {
+      return;
+    }
+    windows_[window].entry.top_level = window;
+    stacking_order_.push_back(window);
+  }
+
+  void remove_top_level(::Window window) {
+    auto it = windows_.find(window);
+    if (it == windows_.end()) {
+      return;
+    }
+    if (it->second.entry.app_window) {
+      app_windows_.erase(it->second.entry.app_window);
+    }
+    windows_.erase(it);
+    stacking_order_.erase(std::remove(stacking_order_.begin(), stacking_order_.end(), window),
+                          stacking_order_.end());
+  }
+
+  ::Window stacking_top() const { return stacking_order_.empty() ? None : stacking_order_.back(); }
+
+  // Moves `window` right above its sibling `above`, or to the bottom if
+  // `above` is None.
+  void restack(::Window window, ::Window above) {
+    auto it = std::find(stacking_order_.begin(), stacking_order_.end(), window);
+    if (it == stacking_order_.end() || window == above) {
+      return;
+    }
+    stacking_order_.erase(it);
+
+    if (above == None) {
+      stacking_order_.insert(stacking_order_.begin(), window);
+      return;
+    }
+    auto sibling = std::find(stacking_order_.begin(), stacking_order_.end(), above);
+    stacking_order_.insert(sibling == stacking_order_.end() ? sibling : sibling + 1, window);
+  }
+
+  // Queries the dirty windows again. Each step sends the requests of all the
+  // dirty windows before reading any reply.
+  void refresh_dirty_windows() {
+    std::vector<tracked_window *> dirty_windows;
+    std::vector<::Window> top_levels;
+    for (auto &window_and_tracked : windows_) {
+      if (window_and_tracked.second.dirty) {
+        dirty_windows.push_back(&window_and_tracked.second);
+        top_levels.push_back(window_and_tracked.first);
+      }
+    }
+    if (dirty_windows.empty()) {
+      return;
+    }
+
+    xcb_window_query query(cache_);
+    std::vector<int32_t> states;
+    const std::vector<::Window> app_windows = query.find_application_windows(top_levels, &states);
+
+    std::vector<::Window> new_app_windows;
+    for (size_t i = 0; i < dirty_windows.size(); i++) {
+      window_entry &entry = dirty_windows[i]->entry;
+      entry.is_minimized = states[i] == IconicState;
+      entry.is_maximized = is_window_fullscreen(cache_, entry.top_level);
+
+      if (app_windows[i] == entry.app_window) {
+        continue;
+      }
+      if (entry.app_window) {
+        app_windows_.erase(entry.app_window);
+      }
+      entry.app_window = app_windows[i];
+      entry.icon_version = g_next_icon_version++;
+      if (entry.app_window) {
+        app_windows_[entry.app_window] = entry.top_level;
+        new_app_windows.push_back(entry.app_window);
+      }
+    }
+
+    // The events are selected before the properties are read, so no change is
+    // missed. A window destroyed in the meantime reports DestroyNotify later.
+    query.select_input(new_app_windows,
+                       XCB_EVENT_MASK_PROPERTY_CHANGE | XCB_EVENT_MASK_STRUCTURE_NOTIFY);
+
+    std::vector<window_entry *> queried_entries;
+    std::vector<::Window> queried_windows;
+    for (tracked_window *tracked : dirty_windows) {
+      tracked->dirty = false;
+      tracked->entry.listable = false;
+      if (tracked->entry.app_window) {
+        queried_entries.push_back(&tracked->entry);
+        queried_windows.push_back(tracked->entry.app_window);
+      }
+    }
+
+    const std::vector<xcb_window_query::window_info> infos = query.query_windows(queried_windows);
+    for (size_t i = 0; i < infos.size(); i++) {
+      const xcb_window_query::window_info &info = infos[i];
+      window_entry &entry = *queried_entries[i];
+      if (!info.valid || info.is_desktop_element || !info.is_viewable) {
+        continue;
+      }
+
+      entry.rect = info.rect;
+      entry.has_title = info.has_title;
+      entry.title = info.title;
+      entry.process_path = info.pid != -1 ? get_process_path(info.pid) : std::string();
+      entry.listable = true;
+    }
+  }
+
+  const std::shared_ptr<shared_x_display> x_display_;
+  x_atom_cache *const cache_;
+  ::Window root_ = 0;
+  std::vector<Atom> watched_atoms_;
+  Atom client_list_atom_ = None;
+  Atom icon_atom_ = None;
+
+  std::unordered_map<::Window, tracked_window> windows_;
+  // The application windows and their top-level windows.
+  std::unordered_map<::Window, ::Window> app_windows_;
+  // The top-level windows, bottom first.
+  std::vector<::Window> stacking_order_;
+};
+
+// Returns true if the socket of `display` is still connected to the X server.
+// Does not block and does not touch the Xlib queue.
+bool is_x_connection_alive(Display *display) {
+  char byte;
+  ssize_t result = recv(ConnectionNumber(display), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+  if (result > 0) {
+    return true;
+  }
+  if (result == 0) {
+    return false;
+  }
+  return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+}
+
+// The X connection and atoms shared by all enumerations. Never destroyed, as
+// the enumeration may run while the process exits.
+struct enumeration_connection {
+  std::mutex mutex;
+  std::shared_ptr<shared_x_display> x_display;
+  std::unique_ptr<x_atom_cache> atom_cache;
+  std::unique_ptr<x_window_list_model> window_list_model;
+  bool event_pump_started = false;
+  // The connections of the thumbnail workers and their atoms. They are kept
+  // open, so the enumerations do not pay for the connection setup, and the XShm
+  // segments pooled for them stay attached.
+  std::vector<std::shared_ptr<shared_x_display>> thumbnail_displays;
+  std::vector<std::unique_ptr<x_atom_cache>> thumbnail_atom_caches;
+  // Connections closed by the X server. They are kept open, XCloseDisplay()
+  // on a dead socket ends in the fatal IO error handler of Xlib.
+  std::vector<std::shared_ptr<shared_x_display>> lost_displays;
+};
+
+enumeration_connection &get_enumeration_connection() {
+  static enumeration_connection *connection = new enumeration_connection();
+  return *connection;
 }
 
+// How long the event pump waits for events before checking whether the
+// connection was replaced.
+constexpr int k_event_pump_timeout_ms = 1000;
+
+// Dispatches the events of the enumeration connection to the window list model
+// as they arrive. Without it the X server would queue the events of all the
+// watched windows until the next enumeration.
+void pump_enumeration_events() {
+  enumeration_connection &connection = get_enumeration_connection();
+  // The file descriptor of the connection found lost. The file descriptors of
+  // lost connections are never closed, so a new connection gets another one.
+  int lost_fd = -1;
+  while (true) {
+    int fd = -1;
+    {
+      std::lock_guard<std::mutex> lock(connection.mutex);
+      if (connection.x_display) {
+        fd = ConnectionNumber(connection.x_display->display());
+      }
+    }
+
+    if (fd < 0 || fd == lost_fd) {
+      // Wait for the next enumeration to reconnect, without holding the lock
+      // it needs and without polling the hung up socket.
+      poll(nullptr, 0, k_event_pump_timeout_ms);
+      continue;
+    }
+
+    struct pollfd poll_fd = {fd, POLLIN, 0};
+    if (poll(&poll_fd, 1, k_event_pump_timeout_ms) <= 0) {
+      continue;
+    }
+
+    std::lock_guard<std::mutex> lock(connection.mutex);
+    if (!connection.x_display || ConnectionNumber(connection.x_display->display()) != fd) {
+      // The connection was replaced meanwhile.
+      continue;
+    }
+    if (!is_x_connection_alive(connection.x_display->display())) {
+      lost_fd = fd;
+      continue;
+    }
+    connection.x_display->process_pending_x_events();
+  }
+}
+
+// Holds the shared enumeration connection for the current thread, connecting
+// or reconnecting to the X server as needed. Enumerations are serialized, one
+// Xlib connection must not be used by several threads at once.
+class enumeration_display {
+public:
+  enumeration_display()
+      : connection_(get_enumeration_connection()), lock_(connection_.mutex) {
+    if (connection_.x_display && !is_x_connection_alive(connection_.x_display->display())) {
+      LOG_INFO("lost the connection to the X server, reconnecting");
+      connection_.window_list_model.reset();
+      connection_.atom_cache.reset();
+      connection_.lost_displays.push_back(std::move(connection_.x_display));
+    }
+
+    if (!connection_.x_display) {
+      connection_.x_display = shared_x_display::create_default();
+      if (connection_.x_display) {
+        connection_.atom_cache.reset(new x_atom_cache(connection_.x_display->display()));
+      }
+    }
+  }
+
+  enumeration_display(const enumeration_display &) = delete;
+  enumeration_display &operator=(const enumeration_display &) = delete;
+
+  // Returns nullptr if the X server can not be reached.
+  Display *display() {
+    return connection_.x_display ? connection_.x_display->display() : nullptr;
+  }
+  x_atom_cache *atom_cache() { return connection_.atom_cache.get(); }
+
+  // Returns the window list model of the connection, creating it if needed.
+  // Returns nullptr if the windows can not be watched.
+  x_window_list_model *window_list_model() {
+    if (!connection_.window_list_model && connection_.x_display) {
+      std::unique_ptr<x_window_list_model> model(
+          new x_window_list_model(connection_.x_display, connection_.atom_cache.get()));
+      if (!model->init()) {
+        return nullptr;
+      }
+      connection_.window_list_model = std::move(model);
+
+      if (!connection_.event_pump_started) {
+        connection_.event_pump_started = true;
+        platform_thread::spawn_detached(&pump_enumeration_events, "x_window_list");
+      }
+    }
+    return connection_.window_list_model.get();
+  }
+
+  // Returns the atom caches of up to `count` more connections to the X server,
+  // for the thumbnail workers. The connections are reused across enumerations,
+  // and the lost ones are replaced.
+  std::vector<x_atom_cache *> thumbnail_atom_caches(int count) {
+    std::vector<std::shared_ptr<shared_x_display>> &displays = connection_.thumbnail_displays;
+    std::vector<std::unique_ptr<x_atom_cache>> &atom_caches = connection_.thumbnail_atom_caches;
+    for (size_t i = 0; i < displays.size();) {
+      if (is_x_connection_alive(displays[i]->display())) {
+        i++;
+        continue;
+      }
+      LOG_INFO("lost a thumbnail connection to the X server");
+      atom_caches.erase(atom_caches.begin() + i);
+      connection_.lost_displays.push_back(std::move(displays[i]));
+      displays.erase(displays.begin() + i);
+    }
+
+    if (connection_.x_display) {
+      const std::string display_name = DisplayString(display());
+      while (static_cast<int>(displays.size()) < count) {
+        std::shared_ptr<shared_x_display> x_display = shared_x_display::create(display_name);
+        if (!x_display) {
+          LOG_ERROR("failed to open display for thumbnails");
+          break;
+        }
+        init_thumbnail_extensions(x_display->display());
+        atom_caches.emplace_back(new x_atom_cache(x_display->display(), *atom_cache()));
+        displays.push_back(std::move(x_display));
+      }
+    }
+
+    std::vector<x_atom_cache *> result;
+    for (size_t i = 0; i < atom_caches.size() && static_cast<int>(i) < count; i++) {
+      result.push_back(atom_caches[i].get());
+    }
+    return result;
+  }
+
+private:
+  enumeration_connection &connection_;
+  std::lock_guard<std::mutex> lock_;
+};
+
 } // namespace x11
 
 // generatd by copilot
@@ -479,144 +1111,166 @@ int x_window_list_utils::enum_windows(const traa_size icon_size, const traa_size
                                       const unsigned int external_flags,
                                       std::vector<traa_screen_source_info> &infos) {
 
-  Display *display = XOpenDisplay(NULL);
-  if (!display) {
+  enumeration_display connection;
+  if (!connection.display()) {
     LOG_ERROR("failed to open display");
     return traa_error::TRAA_ERROR_UNKNOWN;
   }
 
-  ::Window root = DefaultRootWindow(display);
-  if (!root) {
-    LOG_ERROR("failed to get root window");
-    XCloseDisplay(display);
+  x_window_list_model *model = connection.window_list_model();
+  if (!model) {
+    LOG_ERROR("failed to watch the windows");
     return traa_error::TRAA_ERROR_UNKNOWN;
   }
 
-  x_atom_cache atom_cache(display);
+  x_atom_cache &atom_cache = *connection.atom_cache();
 
-  ::Window parent;
-  ::Window *children;
-  unsigned int num_children;
-  if (!XQueryTree(display, root, &root, &parent, &children, &num_children)) {
-    LOG_ERROR("failed to query for child windows");
-    XCloseDisplay(display);
-    return traa_error::TRAA_ERROR_UNKNOWN;
-  }
+  std::vector<x_window_list_model::window_entry> windows;
+  model->snapshot(&windows);
+
+  // The windows to list in stacking order, and their thumbnails to grab.
+  std::vector<traa_screen_source_info> window_infos;
+  std::vector<window_thumbnail_task> thumbnail_tasks;
+  std::vector<uint64_t> icon_versions;
+
+  for (const x_window_list_model::window_entry &window : windows) {
+    if ((!window.has_title || window.title.empty()) &&
+        !(external_flags & TRAA_SCREEN_SOURCE_FLAG_NOT_IGNORE_UNTITLED)) {
+      continue;
+    }
+
+    if ((external_flags & TRAA_SCREEN_SOURCE_FLAG_IGNORE_NOPROCESS_PATH) &&
+        window.process_path.empty()) {
+      continue;
+    }
 
-  for (unsigned int i = 0; i < num_children; ++i) {
     traa_screen_source_info window_info;
-    window_info.id = static_cast<int64_t>(reinterpret_cast<std::uintptr_t>(children[i]));
+    window_info.id = static_cast<int64_t>(reinterpret_cast<std::uintptr_t>(window.top_level));
     window_info.is_window = true;
-    window_info.is_minimized = is_window_minimized(&atom_cache, children[i]);
-    window_info.is_maximized = is_window_fullscreen(&atom_cache, children[i]);
-
-    ::Window app_window = get_application_window(&atom_cache, children[i]);
-    if (app_window && !is_desktop_element(&atom_cache, app_window)) {
-      if (!is_window_visible(display, app_window)) {
-        continue;
-      }
+    window_info.is_minimized = window.is_minimized;
+    window_info.is_maximized = window.is_maximized;
+    window_info.rect = window.rect.to_traa_rect();
 
-      desktop_rect rect;
-      XWindowAttributes attrs;
-      if (!get_window_rect(display, app_window, &rect, &attrs)) {
-        LOG_ERROR("failed to get window rect for window {}", app_window);
-        continue;
-      }
+    if (!window.title.empty()) {
+      strncpy(const_cast<char *>(window_info.title), window.title.c_str(),
+              std::min(sizeof(window_info.title) - 1, window.title.size()));
+    }
 
-      window_info.rect = rect.to_traa_rect();
+    if (!window.process_path.empty()) {
+      strncpy(const_cast<char *>(window_info.process_path), window.process_path.c_str(),
+              std::min(sizeof(window_info.process_path) - 1, window.process_path.size()));
+    }
 
-      std::string str_title;
-      if ((!get_window_title(display, app_window, &str_title) || str_title.empty()) &&
-          !(external_flags & TRAA_SCREEN_SOURCE_FLAG_NOT_IGNORE_UNTITLED)) {
-        continue;
-      }
+    window_thumbnail_task thumbnail_task;
+    thumbnail_task.window = window.app_window;
+    thumbnail_task.rect = window.rect;
+    window_infos.push_back(window_info);
+    thumbnail_tasks.push_back(thumbnail_task);
+    icon_versions.push_back(window.icon_version);
+  }
 
-      if (!str_title.empty()) {
-        strncpy(const_cast<char *>(window_info.title), str_title.c_str(),
-                std::min(sizeof(window_info.title) - 1, str_title.size()));
-      }
+  // only get thumbnail for the window when thumbnail_size is set.
+  const bool has_thumbnail = thumbnail_size.width > 0 && thumbnail_size.height > 0;
+  if (has_thumbnail) {
+    get_window_thumbnails(&atom_cache,
+                          connection.thumbnail_atom_caches(
+                              thumbnail_worker_count(thumbnail_tasks.size())),
+                          thumbnail_size, thumbnail_tasks);
+  }
 
-      // get process path
-      bool has_process_path = false;
-      pid_t pid = get_pid_by_window(display, app_window);
-      if (pid != -1) {
-        std::string process_path = get_process_path(pid);
-        if (!process_path.empty()) {
-          has_process_path = true;
-          strncpy(const_cast<char *>(window_info.process_path), process_path.c_str(),
-                  std::min(sizeof(window_info.process_path) - 1, process_path.size()));
-        }
-      }
+  // The icons of the previous enumeration, and of this one, which replace them
+  // in the cache when done.
+  window_icon_map_t previous_icons;
+  window_icon_map_t icons;
+  {
+    std::lock_guard<std::mutex> lock(window_icon_cache_mutex());
+    previous_icons.swap(window_icon_cache());
+  }
 
-      if ((external_flags & TRAA_SCREEN_SOURCE_FLAG_IGNORE_NOPROCESS_PATH) && !has_process_path) {
-        continue;
-      }
+  for (size_t i = 0; i < window_infos.size(); ++i) {
+    traa_screen_source_info &window_info = window_infos[i];
+    const ::Window app_window = thumbnail_tasks[i].window;
 
-      // only get thumbnail for the window when thumbnail_size is set.
-      if (thumbnail_size.width > 0 && thumbnail_size.height > 0 &&
-          !get_window_image_data(&atom_cache, app_window, rect, thumbnail_size,
-                                 const_cast<uint8_t **>(&window_info.thumbnail_data),
-                                 window_info.thumbnail_size)) {
+    if (has_thumbnail) {
+      if (!thumbnail_tasks[i].succeeded) {
         LOG_ERROR("get thumbnail data failed");
         continue;
       }
+      window_info.thumbnail_data = thumbnail_tasks[i].data;
+      window_info.thumbnail_size = thumbnail_tasks[i].size;
+    }
 
 #if TRAA_DUMP_IMAGES
-      // create a file to save the thumbnail
-      if (window_info.thumbnail_data) {
-        save_pixel_to_ppm(
-            (std::string("thumbnail_") + std::to_string(window_info.id) + ".ppm").c_str(),
-            window_info.thumbnail_data, window_info.thumbnail_size.width,
-            window_info.thumbnail_size.height);
-      }
+    // create a file to save the thumbnail
+    if (window_info.thumbnail_data) {
+      save_pixel_to_ppm(
+          (std::string("thumbnail_") + std::to_string(window_info.id) + ".ppm").c_str(),
+          window_info.thumbnail_data, window_info.thumbnail_size.width,
+          window_info.thumbnail_size.height);
+    }
 #endif // TRAA_DUMP_IMAGES
 
-      // only get icon for the window when icon_size is set.
-      if (icon_size.width > 0 && icon_size.height > 0) {
-        std::vector<uint8_t> icon_data;
-        int icon_width, icon_height;
-        if (get_window_icon(display, app_window, icon_data, icon_width, icon_height)) {
+    // only get icon for the window when icon_size is set.
+    if (icon_size.width > 0 && icon_size.height > 0) {
+      auto previous_icon = previous_icons.find(app_window);
+      window_icon icon;
+      if (previous_icon != previous_icons.end() &&
+          previous_icon->second.version == icon_versions[i] &&
+          previous_icon->second.requested_size.width == icon_size.width &&
+          previous_icon->second.requested_size.height == icon_size.height) {
+        // _NET_WM_ICON did not change since it was read.
+        icon = std::move(previous_icon->second);
+      } else {
+        icon.version = icon_versions[i];
+        if (get_window_icon(&atom_cache, app_window, icon_size, icon.data, icon.width,
+                            icon.height)) {
 #if TRAA_DUMP_IMAGES
           // create a file to save the origin icon
           save_pixel_to_ppm(
               (std::string("origin_icon_") + std::to_string(window_info.id) + ".ppm").c_str(),
-              icon_data.data(), icon_width, icon_height);
+              reinterpret_cast<const uint8_t *>(icon.data.data()), icon.width, icon.height);
 #endif // TRAA_DUMP_IMAGES
 
-          traa_size scaled_icon_size =
-              calc_scaled_size(desktop_size(icon_width, icon_height), icon_size).to_traa_size();
-          window_info.icon_data = new uint8_t[scaled_icon_size.width * scaled_icon_size.height *
-                                              desktop_frame::k_bytes_per_pixel];
-          if (!window_info.icon_data) {
-            LOG_ERROR("failed to allocate memory for icon data");
-            continue;
-          }
-
-          libyuv::ARGBScale(icon_data.data(), icon_width * desktop_frame::k_bytes_per_pixel,
-                            icon_width, icon_height, const_cast<uint8_t *>(window_info.icon_data),
-                            scaled_icon_size.width * desktop_frame::k_bytes_per_pixel,
-                            scaled_icon_size.width, scaled_icon_size.height, libyuv::kFilterBox);
-
-          window_info.icon_size = scaled_icon_size;
+          scale_window_icon(icon, icon_size,
+                            previous_icon != previous_icons.end() ? &previous_icon->second
+                                                                  : nullptr);
+        } else {
+          // Remember that the window has no icon, so it is not read again.
+          icon.data.clear();
+          icon.requested_size = icon_size;
         }
+      }
 
-#if TRAA_DUMP_IMAGES
-        // create a file to save the icon
-        if (window_info.icon_data) {
-          save_pixel_to_ppm(
-              (std::string("icon_") + std::to_string(window_info.id) + ".ppm").c_str(),
-              window_info.icon_data, window_info.icon_size.width, window_info.icon_size.height);
+      if (!icon.scaled_data.empty()) {
+        window_info.icon_data = new uint8_t[icon.scaled_data.size()];
+        if (!window_info.icon_data) {
+          LOG_ERROR("failed to allocate memory for icon data");
+          continue;
         }
-#endif // TRAA_DUMP_IMAGES
+
+        memcpy(const_cast<uint8_t *>(window_info.icon_data), icon.scaled_data.data(),
+               icon.scaled_data.size());
+        window_info.icon_size = icon.scaled_size;
       }
+      icons[app_window] = std::move(icon);
 
-      infos.push_back(window_info);
+#if TRAA_DUMP_IMAGES
+      // create a file to save the icon
+      if (window_info.icon_data) {
+        save_pixel_to_ppm(
+            (std::string("icon_") + std::to_string(window_info.id) + ".ppm").c_str(),
+            window_info.icon_data, window_info.icon_size.width, window_info.icon_size.height);
+      }
+#endif // TRAA_DUMP_IMAGES
     }
-  }
 
-  XFree(children);
+    infos.push_back(window_info);
+  }
 
-  XCloseDisplay(display);
+  {
+    std::lock_guard<std::mutex> lock(window_icon_cache_mutex());
+    window_icon_cache().swap(icons);
+  }
 
   return traa_error::TRAA_ERROR_NONE;
 }
@@ -625,7 +1279,8 @@ int x_window_list_utils::enum_screens(const traa_size thumbnail_size,
                                       const unsigned int external_flags,
                                       std::vector<traa_screen_source_info> &infos) {
   // connect to the X server
-  Display *display = XOpenDisplay(NULL);
+  enumeration_display connection;
+  Display *display = connection.display();
   if (!display) {
     LOG_ERROR("failed to open display");
     return traa_error::TRAA_ERROR_UNKNOWN;
@@ -635,17 +1290,19 @@ int x_window_list_utils::enum_screens(const traa_size thumbnail_size,
   int event_base, error_base;
   if (!XRRQueryExtension(display, &event_base, &error_base)) {
     LOG_ERROR("Xrandr extension is not available");
-    XCloseDisplay(display);
     return traa_error::TRAA_ERROR_UNKNOWN;
   }
 
-  x_atom_cache atom_cache(display);
+  x_atom_cache &atom_cache = *connection.atom_cache();
 
   // get the root window
   ::Window root = XDefaultRootWindow(display);
 
+  // Scale the monitors on the server where possible, otherwise grab the whole
+  // root window once and scale the monitors here.
+  x_render_scaler scaler(display);
   x_server_pixel_buffer pixel_buffer;
-  if (thumbnail_size.width > 0 && thumbnail_size.height > 0) {
+  if (thumbnail_size.width > 0 && thumbnail_size.height > 0 && !scaler.is_supported()) {
     // must init the pixel buffer before calling XRRGetMonitors, ohterwise init will raise an
     // BadMatch error.I don't know why, just do it.
 
@@ -676,7 +1333,6 @@ int x_window_list_utils::enum_screens(const traa_size thumbnail_size,
   XRRMonitorInfo *monitors = XRRGetMonitors(display, root, True, &monitor_count);
   if (!monitors) {
     LOG_ERROR("failed to get monitors");
-    XCloseDisplay(display);
     return traa_error::TRAA_ERROR_UNKNOWN;
   }
 
@@ -712,20 +1368,30 @@ int x_window_list_utils::enum_screens(const traa_size thumbnail_size,
         continue;
       }
 
-      basic_desktop_frame frame(screen_rect.size());
-      frame.set_top_left(screen_rect.top_left());
+      if (scaler.is_supported()) {
+        if (!scaler.scale(root, screen_rect, desktop_size(scaled_size.width, scaled_size.height),
+                          const_cast<uint8_t *>(screen_info.thumbnail_data),
+                          scaled_size.width * desktop_frame::k_bytes_per_pixel)) {
+          LOG_ERROR("failed to scale screen {}", screen_info.id);
+          continue;
+        }
+      } else {
+        basic_desktop_frame frame(screen_rect.size());
+        frame.set_top_left(screen_rect.top_left());
+
+        if (!pixel_buffer.capture_rect(screen_rect, &frame)) {
+          LOG_ERROR("failed to capture rect for screen {}", root);
+          continue;
+        }
 
-      if (!pixel_buffer.capture_rect(screen_rect, &frame)) {
-        LOG_ERROR("failed to capture rect for screen {}", root);
-        continue;
+        // use libyuv to scale the image
+        parallel_scale_argb(frame.data(), frame.stride(), frame.size().width(),
+                            frame.size().height(),
+                            const_cast<uint8_t *>(screen_info.thumbnail_data),
+                            scaled_size.width * desktop_frame::k_bytes_per_pixel,
+                            scaled_size.width, scaled_size.height, libyuv::kFilterBox);
       }
 
-      // use libyuv to scale the image
-      libyuv::ARGBScale(frame.data(), frame.stride(), frame.size().width(), frame.size().height(),
-                        const_cast<uint8_t *>(screen_info.thumbnail_data),
-                        scaled_size.width * desktop_frame::k_bytes_per_pixel, scaled_size.width,
-                        scaled_size.height, libyuv::kFilterBox);
-
       screen_info.thumbnail_size = scaled_size;
     }
 
@@ -743,7 +1409,6 @@ int x_window_list_utils::enum_screens(const traa_size thumbnail_size,
   }
 
   XRRFreeMonitors(monitors);
-  XCloseDisplay(display);
 
   return traa_error::TRAA_ERROR_NONE;
 }
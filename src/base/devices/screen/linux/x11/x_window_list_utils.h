@@ -38,6 +38,14 @@ public:
   static bool get_window_rect(::Display *display, ::Window window, desktop_rect *rect,
                               XWindowAttributes *attributes /* = nullptr */);
 
+  // enum_windows() and enum_screens() share one X connection and atom cache
+  // for the lifetime of the process, and reconnect if the X server closed it.
+  // They are thread-safe, concurrent calls are serialized on that connection.
+  // Window thumbnails are grabbed on additional short-lived connections.
+  //
+  // enum_windows() lists the windows from a model kept up to date by X events
+  // on a background thread, so only the windows which changed since the
+  // previous enumeration are queried again.
   static int enum_windows(const traa_size icon_size, const traa_size thumbnail_size,
                           const unsigned int external_flags,
                           std::vector<traa_screen_source_info> &infos);
@@ -0,0 +1,345 @@
+#include "base/devices/screen/linux/x11/xcb_window_query.h"
+
+#include "base/logger.h"
+
+#include <X11/Xlib-xcb.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <memory>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// The longest WM_NAME read, in 32-bit units. Titles are cut to far less than
+// this by the window list.
+constexpr uint32_t k_max_title_length = 256;
+
+// The most _NET_WM_WINDOW_TYPE atoms read.
+constexpr uint32_t k_max_window_types = 32;
+
+// The longest WM_CLASS read, in 32-bit units.
+constexpr uint32_t k_max_class_length = 64;
+
+// Marks an application window which is not known until more of the hierarchy
+// is read.
+constexpr ::Window k_pending_window = ~static_cast<::Window>(0);
+
+struct free_deleter {
+  void operator()(void *data) const { free(data); }
+};
+
+template <typename reply_type> using reply_ptr = std::unique_ptr<reply_type, free_deleter>;
+
+// Takes the ownership of `reply`, and frees the error it came with, if any.
+template <typename reply_type>
+reply_ptr<reply_type> take_reply(reply_type *reply, xcb_generic_error_t **error) {
+  free(*error);
+  *error = nullptr;
+  return reply_ptr<reply_type>(reply);
+}
+
+xcb_get_property_cookie_t get_property(xcb_connection_t *connection, ::Window window, Atom property,
+                                       Atom type, uint32_t length) {
+  return xcb_get_property(connection, 0, static_cast<xcb_window_t>(window),
+                          static_cast<xcb_atom_t>(property), static_cast<xcb_atom_t>(type), 0,
+                          length);
+}
+
+// Returns the 32-bit items of the property of `reply`, nullptr if there are
+// none or the property has another format.
+const uint32_t *get_property_items(const xcb_get_property_reply_t *reply, uint32_t *count) {
+  *count = 0;
+  if (!reply || reply->format != 32 || reply->value_len == 0) {
+    return nullptr;
+  }
+  *count = reply->value_len;
+  return static_cast<const uint32_t *>(
+      xcb_get_property_value(const_cast<xcb_get_property_reply_t *>(reply)));
+}
+
+// A window of the hierarchies walked by find_application_windows().
+struct hierarchy_node {
+  ::Window window = 0;
+  // The index of the window the walk started from.
+  size_t origin = 0;
+  bool state_known = false;
+  int32_t state = WithdrawnState;
+  std::vector<size_t> children;
+};
+
+// Returns the first window in NormalState of the hierarchy of `index` in
+// depth-first order, 0 if none, or k_pending_window if that depends on windows
+// whose state is not known yet.
+::Window resolve_application_window(const std::vector<hierarchy_node> &nodes, size_t index) {
+  const hierarchy_node &node = nodes[index];
+  if (!node.state_known) {
+    return k_pending_window;
+  }
+  if (node.state == NormalState) {
+    return node.window;
+  }
+  if (node.state == IconicState) {
+    return 0;
+  }
+  for (size_t child : node.children) {
+    ::Window app_window = resolve_application_window(nodes, child);
+    if (app_window != 0) {
+      return app_window;
+    }
+  }
+  return 0;
+}
+
+// Converts the text property of `reply` to UTF-8 the way XGetWMName() and
+// Xutf8TextPropertyToTextList() do.
+bool convert_text_property(Display *display, xcb_get_property_reply_t *reply, std::string *text) {
+  if (!reply || reply->type == XCB_NONE || reply->value_len == 0) {
+    return false;
+  }
+
+  XTextProperty property;
+  property.value = static_cast<unsigned char *>(xcb_get_property_value(reply));
+  property.encoding = reply->type;
+  property.format = reply->format;
+  property.nitems = reply->value_len;
+
+  char **list = nullptr;
+  int count = 0;
+  bool result = false;
+  int status = Xutf8TextPropertyToTextList(display, &property, &list, &count);
+  if (status >= Success && count && *list) {
+    *text = *list;
+    result = true;
+  }
+  if (list) {
+    XFreeStringList(list);
+  }
+  return result;
+}
+
+// Returns true if the _NET_WM_WINDOW_TYPE or the WM_CLASS of a window tell it
+// is a part of the desktop rather than an application window.
+bool is_desktop_element(x_atom_cache *cache, const xcb_get_property_reply_t *window_type,
+                        xcb_get_property_reply_t *wm_class) {
+  // First look for _NET_WM_WINDOW_TYPE. The standard
+  // (http://standards.freedesktop.org/wm-spec/latest/ar01s05.html#id2760306)
+  // says this hint *should* be present on all windows, and we use the existence
+  // of _NET_WM_WINDOW_TYPE_NORMAL in the property to indicate a window is not
+  // a desktop element (that is, only "normal" windows should be shareable).
+  uint32_t count = 0;
+  const uint32_t *types = get_property_items(window_type, &count);
+  if (types) {
+    const uint32_t normal = static_cast<uint32_t>(cache->window_type_normal());
+    return std::find(types, types + count, normal) == types + count;
+  }
+
+  // Fall back on the class hint, "res_name\0res_class\0".
+  if (!wm_class || wm_class->format != 8 || wm_class->value_len == 0) {
+    return false;
+  }
+  const char *value = static_cast<const char *>(xcb_get_property_value(wm_class));
+  const std::string res_name(value, strnlen(value, wm_class->value_len));
+  return res_name == "gnome-panel" || res_name == "desktop_window";
+}
+
+} // namespace
+
+xcb_window_query::xcb_window_query(x_atom_cache *cache)
+    : cache_(cache), connection_(XGetXCBConnection(cache->display())),
+      root_(DefaultRootWindow(cache->display())) {}
+
+std::vector<::Window>
+xcb_window_query::find_application_windows(const std::vector<::Window> &windows,
+                                           std::vector<int32_t> *states) {
+  const Atom wm_state = cache_->wm_state();
+
+  std::vector<hierarchy_node> nodes(windows.size());
+  std::vector<size_t> level(windows.size());
+  for (size_t i = 0; i < windows.size(); i++) {
+    nodes[i].window = windows[i];
+    nodes[i].origin = i;
+    level[i] = i;
+  }
+
+  std::vector<::Window> app_windows(windows.size(), k_pending_window);
+  std::vector<xcb_get_property_cookie_t> state_cookies(level.size());
+  std::vector<xcb_query_tree_cookie_t> tree_cookies(level.size());
+  while (!level.empty()) {
+    // The children are asked for along with the state, the windows which turn
+    // out to be in WithdrawnState would cost another round trip otherwise.
+    state_cookies.resize(level.size());
+    tree_cookies.resize(level.size());
+    for (size_t i = 0; i < level.size(); i++) {
+      const ::Window window = nodes[level[i]].window;
+      if (wm_state != None) {
+        state_cookies[i] =
+            get_property(connection_, window, wm_state, XCB_GET_PROPERTY_TYPE_ANY, 1);
+      }
+      tree_cookies[i] = xcb_query_tree(connection_, static_cast<xcb_window_t>(window));
+    }
+
+    std::vector<size_t> next_level;
+    for (size_t i = 0; i < level.size(); i++) {
+      hierarchy_node &node = nodes[level[i]];
+      xcb_generic_error_t *error = nullptr;
+
+      node.state_known = true;
+      if (wm_state != None) {
+        auto reply =
+            take_reply(xcb_get_property_reply(connection_, state_cookies[i], &error), &error);
+        uint32_t count = 0;
+        const uint32_t *state = get_property_items(reply.get(), &count);
+        node.state = state ? static_cast<int32_t>(state[0]) : WithdrawnState;
+      }
+
+      auto tree = take_reply(xcb_query_tree_reply(connection_, tree_cookies[i], &error), &error);
+      if (!tree || node.state == NormalState || node.state == IconicState) {
+        continue;
+      }
+      // Appending the children may move `node`.
+      const size_t parent = level[i];
+      const xcb_window_t *children = xcb_query_tree_children(tree.get());
+      const int num_children = xcb_query_tree_children_length(tree.get());
+      for (int j = 0; j < num_children; j++) {
+        hierarchy_node child;
+        child.window = children[j];
+        child.origin = nodes[parent].origin;
+        nodes[parent].children.push_back(nodes.size());
+        next_level.push_back(nodes.size());
+        nodes.push_back(child);
+      }
+    }
+
+    // Stop walking the hierarchies whose application window is known.
+    level.clear();
+    for (size_t index : next_level) {
+      const size_t origin = nodes[index].origin;
+      if (app_windows[origin] == k_pending_window) {
+        app_windows[origin] = resolve_application_window(nodes, origin);
+      }
+      if (app_windows[origin] == k_pending_window) {
+        level.push_back(index);
+      }
+    }
+  }
+
+  states->resize(windows.size());
+  for (size_t i = 0; i < windows.size(); i++) {
+    (*states)[i] = nodes[i].state;
+    app_windows[i] = resolve_application_window(nodes, i);
+  }
+  return app_windows;
+}
+
+bool xcb_window_query::select_input(const std::vector<::Window> &windows, uint32_t event_mask) {
+  std::vector<xcb_void_cookie_t> cookies(windows.size());
+  for (size_t i = 0; i < windows.size(); i++) {
+    cookies[i] = xcb_change_window_attributes_checked(
+        connection_, static_cast<xcb_window_t>(windows[i]), XCB_CW_EVENT_MASK, &event_mask);
+  }
+
+  bool result = true;
+  for (xcb_void_cookie_t cookie : cookies) {
+    xcb_generic_error_t *error = xcb_request_check(connection_, cookie);
+    if (error) {
+      free(error);
+      result = false;
+    }
+  }
+  return result;
+}
+
+std::vector<xcb_window_query::window_info>
+xcb_window_query::query_windows(const std::vector<::Window> &windows) {
+  struct window_cookies {
+    xcb_get_window_attributes_cookie_t attributes;
+    xcb_get_geometry_cookie_t geometry;
+    xcb_translate_coordinates_cookie_t origin;
+    xcb_get_property_cookie_t window_type;
+    xcb_get_property_cookie_t wm_class;
+    xcb_get_property_cookie_t wm_name;
+    xcb_get_property_cookie_t pid;
+  };
+
+  const Atom window_type_atom = cache_->window_type();
+  const Atom pid_atom = cache_->net_wm_pid();
+
+  std::vector<window_cookies> cookies(windows.size());
+  for (size_t i = 0; i < windows.size(); i++) {
+    const xcb_window_t window = static_cast<xcb_window_t>(windows[i]);
+    window_cookies &window_cookie = cookies[i];
+    window_cookie.attributes = xcb_get_window_attributes(connection_, window);
+    window_cookie.geometry = xcb_get_geometry(connection_, window);
+    window_cookie.origin =
+        xcb_translate_coordinates(connection_, window, static_cast<xcb_window_t>(root_), 0, 0);
+    if (window_type_atom != None) {
+      window_cookie.window_type = get_property(connection_, window, window_type_atom,
+                                               XCB_GET_PROPERTY_TYPE_ANY, k_max_window_types);
+    }
+    window_cookie.wm_class =
+        get_property(connection_, window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, k_max_class_length);
+    window_cookie.wm_name = get_property(connection_, window, XCB_ATOM_WM_NAME,
+                                         XCB_GET_PROPERTY_TYPE_ANY, k_max_title_length);
+    if (pid_atom != None) {
+      window_cookie.pid = get_property(connection_, window, pid_atom, XCB_ATOM_CARDINAL, 1);
+    }
+  }
+
+  // All the replies are read, even for windows which turn out to be gone, so
+  // none of them is left in the XCB queue.
+  std::vector<window_info> infos(windows.size());
+  for (size_t i = 0; i < windows.size(); i++) {
+    window_cookies &window_cookie = cookies[i];
+    window_info &info = infos[i];
+    xcb_generic_error_t *error = nullptr;
+
+    auto attributes = take_reply(
+        xcb_get_window_attributes_reply(connection_, window_cookie.attributes, &error), &error);
+    auto geometry =
+        take_reply(xcb_get_geometry_reply(connection_, window_cookie.geometry, &error), &error);
+    auto origin = take_reply(
+        xcb_translate_coordinates_reply(connection_, window_cookie.origin, &error), &error);
+    reply_ptr<xcb_get_property_reply_t> window_type;
+    if (window_type_atom != None) {
+      window_type = take_reply(
+          xcb_get_property_reply(connection_, window_cookie.window_type, &error), &error);
+    }
+    auto wm_class =
+        take_reply(xcb_get_property_reply(connection_, window_cookie.wm_class, &error), &error);
+    auto wm_name =
+        take_reply(xcb_get_property_reply(connection_, window_cookie.wm_name, &error), &error);
+    reply_ptr<xcb_get_property_reply_t> pid;
+    if (pid_atom != None) {
+      pid = take_reply(xcb_get_property_reply(connection_, window_cookie.pid, &error), &error);
+    }
+
+    if (!attributes || !geometry || !origin) {
+      LOG_ERROR("failed to get window attributes for window {}", windows[i]);
+      continue;
+    }
+
+    info.valid = true;
+    info.is_viewable = attributes->map_state == XCB_MAP_STATE_VIEWABLE;
+    info.is_desktop_element = is_desktop_element(cache_, window_type.get(), wm_class.get());
+    info.rect =
+        desktop_rect::make_xywh(origin->dst_x, origin->dst_y, geometry->width, geometry->height);
+    info.has_title = convert_text_property(cache_->display(), wm_name.get(), &info.title);
+
+    uint32_t count = 0;
+    const uint32_t *pid_value = get_property_items(pid.get(), &count);
+    if (pid_value) {
+      info.pid = static_cast<pid_t>(pid_value[0]);
+    }
+  }
+  return infos;
+}
+
+} // namespace base
+} // namespace traa
@@ -0,0 +1,74 @@
+#ifndef TRAA_BASE_DEVICES_SCREEN_LINUX_X11_XCB_WINDOW_QUERY_H_
+#define TRAA_BASE_DEVICES_SCREEN_LINUX_X11_XCB_WINDOW_QUERY_H_
+
+#include "base/devices/screen/desktop_geometry.h"
+#include "base/devices/screen/linux/x11/x_atom_cache.h"
+
+#include <X11/X.h>
+#include <xcb/xcb.h>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+namespace traa {
+namespace base {
+
+// Reads what the window list needs to know about many windows at once.
+//
+// Xlib waits for the reply of each property or geometry request before sending
+// the next one, so listing n windows costs several round trips per window. This
+// class sends the requests of all the windows over the XCB connection under the
+// Xlib display first, then collects the replies, so each step costs about one
+// round trip whatever the number of windows.
+//
+// Errors come back with the replies, they do not reach the Xlib error handler
+// and no x_error_trap is needed. Not thread-safe, like the display of `cache`.
+class xcb_window_query {
+public:
+  // What the window list needs to know about an application window.
+  struct window_info {
+    // False if the window does not exist anymore.
+    bool valid = false;
+    bool is_viewable = false;
+    bool is_desktop_element = false;
+    // The rectangle of the window in the coordinates of the root window.
+    desktop_rect rect;
+    // Whether the WM_NAME of the window could be converted to UTF-8.
+    bool has_title = false;
+    std::string title;
+    // _NET_WM_PID, -1 if not set.
+    pid_t pid = -1;
+  };
+
+  explicit xcb_window_query(x_atom_cache *cache);
+
+  xcb_window_query(const xcb_window_query &) = delete;
+  xcb_window_query &operator=(const xcb_window_query &) = delete;
+
+  // Returns the application window of each of `windows`, i.e. the first window
+  // of its hierarchy with WM_STATE set to NormalState, or 0 if none. Stores the
+  // WM_STATE of each of `windows` in `states`, WithdrawnState if missing. Costs
+  // one round trip per level of the deepest hierarchy.
+  std::vector<::Window> find_application_windows(const std::vector<::Window> &windows,
+                                                 std::vector<int32_t> *states);
+
+  // Selects the events of `event_mask` on each of `windows`. Returns false if
+  // any of them failed, e.g. because the window was destroyed.
+  bool select_input(const std::vector<::Window> &windows, uint32_t event_mask);
+
+  // Returns the information of each of `windows`.
+  std::vector<window_info> query_windows(const std::vector<::Window> &windows);
+
+private:
+  x_atom_cache *const cache_;
+  xcb_connection_t *const connection_;
+  const ::Window root_;
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_LINUX_X11_XCB_WINDOW_QUERY_H_
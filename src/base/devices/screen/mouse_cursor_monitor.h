@@ -0,0 +1,64 @@
+/*
+ *  Copyright (c) 2013 The WebRTC project authors. All Rights Reserved.
+ *
+ *  Use of this source code is governed by a BSD-style license
+ *  that can be found in the LICENSE file in the root of the source
+ *  tree. An additional intellectual property rights grant can be found
+ *  in the file PATENTS.  All contributing project authors may
+ *  be found in the AUTHORS file in the root of the source tree.
+ */
+
+#ifndef TRAA_BASE_DEVICES_SCREEN_MOUSE_CURSOR_MONITOR_H_
+#define TRAA_BASE_DEVICES_SCREEN_MOUSE_CURSOR_MONITOR_H_
+
+#include "base/devices/screen/desktop_geometry.h"
+
+namespace traa {
+namespace base {
+
+class mouse_cursor;
+
+// Captures mouse shape and position.
+class mouse_cursor_monitor {
+public:
+  enum class mode {
+    // Capture only shape of the mouse cursor, but not position.
+    shape_only,
+
+    // Capture both, mouse cursor shape and position.
+    shape_and_position,
+  };
+
+  // Callback interface used to pass current mouse cursor position and shape.
+  class callback {
+  public:
+    // Called in response to capture() when the cursor shape has changed. Must
+    // take ownership of `cursor`.
+    virtual void on_mouse_cursor(mouse_cursor *cursor) = 0;
+
+    // Called in response to capture(). `position` indicates cursor position
+    // relative to the top-left corner of the whole desktop.
+    virtual void on_mouse_cursor_position(const desktop_vector &position) {}
+
+  protected:
+    virtual ~callback() {}
+  };
+
+  virtual ~mouse_cursor_monitor() {}
+
+  // Initializes the monitor with the `callback`, which must remain valid until
+  // the monitor is destroyed.
+  virtual void init(callback *callback, mode mode) = 0;
+
+  // Captures current cursor shape and position (depending on the `mode` passed
+  // to init()). Calls callback::on_mouse_cursor() if the cursor shape has
+  // changed since the last call (or when capture() is called for the first
+  // time) and then callback::on_mouse_cursor_position() if mode is set to
+  // shape_and_position.
+  virtual void capture() = 0;
+};
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_MOUSE_CURSOR_MONITOR_H_
@@ -0,0 +1,168 @@
+#include "base/devices/screen/parallel_scale.h"
+
+#include "base/platform_thread.h"
+#include "base/system/cpu_info.h"
+
+#include <libyuv/scale_argb.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+// Upper bound of the worker threads, scaling is memory bound beyond it.
+constexpr int k_max_workers = 7;
+
+// Images with fewer destination pixels than this are scaled serially, the
+// thread handoff would cost more than it saves.
+constexpr int64_t k_min_parallel_pixels = 320 * 240;
+
+// The minimum number of destination rows per band.
+constexpr int k_min_band_rows = 16;
+
+// A pool of detached worker threads which run the bands of one scale call at a
+// time. It is never destroyed, so it outlives any caller during shutdown.
+class band_worker_pool {
+public:
+  static band_worker_pool &instance() {
+    static band_worker_pool *pool = new band_worker_pool();
+    return *pool;
+  }
+
+  // The number of threads which run bands, including the calling thread.
+  int concurrency() const { return workers_ + 1; }
+
+  // Runs `task` for each band in [0, `band_count`), and returns true after
+  // all of them finished. The calling thread runs bands as well. Returns false
+  // without running any band if the pool is busy with another call, so
+  // concurrent callers do not queue behind each other.
+  bool try_run(int band_count, const std::function<void(int)> &task) {
+    std::unique_lock<std::mutex> run_lock(run_mutex_, std::try_to_lock);
+    if (!run_lock.owns_lock()) {
+      return false;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_ = &task;
+      band_count_ = band_count;
+      next_band_ = 0;
+      finished_bands_ = 0;
+      generation_++;
+    }
+    work_cv_.notify_all();
+
+    run_bands();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [this]() { return finished_bands_ == band_count_; });
+    task_ = nullptr;
+    return true;
+  }
+
+private:
+  band_worker_pool() {
+    const int cores = static_cast<int>(cpu_info::detect_number_of_cores());
+    workers_ = std::min(std::max(cores - 1, 0), k_max_workers);
+    for (int i = 0; i < workers_; i++) {
+      platform_thread::spawn_detached([this]() { worker_loop(); },
+                                      "traa_scale_" + std::to_string(i));
+    }
+  }
+
+  void worker_loop() {
+    uint64_t seen_generation = 0;
+    while (true) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        work_cv_.wait(lock, [&]() { return generation_ != seen_generation; });
+        seen_generation = generation_;
+      }
+      run_bands();
+    }
+  }
+
+  // Takes bands until all of them are taken.
+  void run_bands() {
+    while (true) {
+      const std::function<void(int)> *task;
+      int band;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!task_ || next_band_ >= band_count_) {
+          return;
+        }
+        task = task_;
+        band = next_band_++;
+      }
+      (*task)(band);
+      bool all_finished;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        all_finished = ++finished_bands_ == band_count_;
+      }
+      if (all_finished) {
+        done_cv_.notify_one();
+      }
+    }
+  }
+
+  int workers_ = 0;
+  // Held by the try_run() call which owns the pool.
+  std::mutex run_mutex_;
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  const std::function<void(int)> *task_ = nullptr;
+  int band_count_ = 0;
+  int next_band_ = 0;
+  int finished_bands_ = 0;
+  uint64_t generation_ = 0;
+};
+
+} // namespace
+
+int parallel_scale_argb(const uint8_t *src_argb, int src_stride_argb, int src_width,
+                        int src_height, uint8_t *dst_argb, int dst_stride_argb, int dst_width,
+                        int dst_height, libyuv::FilterMode filtering) {
+  int band_count = 1;
+  if (dst_width > 0 && dst_height > 0 &&
+      static_cast<int64_t>(dst_width) * dst_height >= k_min_parallel_pixels) {
+    band_count = std::min(band_worker_pool::instance().concurrency(),
+                          dst_height / k_min_band_rows);
+  }
+  if (band_count <= 1) {
+    return libyuv::ARGBScale(src_argb, src_stride_argb, src_width, src_height, dst_argb,
+                             dst_stride_argb, dst_width, dst_height, filtering);
+  }
+
+  int results[k_max_workers + 1] = {};
+  const bool ran = band_worker_pool::instance().try_run(band_count, [&](int band) {
+    const int top = dst_height * band / band_count;
+    const int bottom = dst_height * (band + 1) / band_count;
+    results[band] = libyuv::ARGBScaleClip(src_argb, src_stride_argb, src_width, src_height,
+                                          dst_argb, dst_stride_argb, dst_width, dst_height, 0,
+                                          top, dst_width, bottom - top, filtering);
+  });
+  if (!ran) {
+    // Another call owns the pool, scale on this thread instead of waiting.
+    return libyuv::ARGBScale(src_argb, src_stride_argb, src_width, src_height, dst_argb,
+                             dst_stride_argb, dst_width, dst_height, filtering);
+  }
+  for (int i = 0; i < band_count; i++) {
+    if (results[i] != 0) {
+      return results[i];
+    }
+  }
+  return 0;
+}
+
+} // namespace base
+} // namespace traa
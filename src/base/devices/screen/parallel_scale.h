@@ -0,0 +1,25 @@
+#ifndef TRAA_BASE_DEVICES_SCREEN_PARALLEL_SCALE_H_
+#define TRAA_BASE_DEVICES_SCREEN_PARALLEL_SCALE_H_
+
+#include <stdint.h>
+
+#include <libyuv/scale.h>
+
+namespace traa {
+namespace base {
+
+// Same as libyuv::ARGBScale, but splits the destination into horizontal bands
+// which are scaled on a shared pool of worker threads and the calling thread.
+// Each band is scaled with libyuv::ARGBScaleClip over the whole source, so
+// libyuv reads the source rows the band's filter footprint overlaps, and the
+// output is bit-exact with ARGBScale. Small images, and images scaled while the
+// pool is busy with another call, are scaled on the calling thread only.
+// Returns 0 on success, as ARGBScale does.
+int parallel_scale_argb(const uint8_t *src_argb, int src_stride_argb, int src_width,
+                        int src_height, uint8_t *dst_argb, int dst_stride_argb, int dst_width,
+                        int dst_height, libyuv::FilterMode filtering);
+
+} // namespace base
+} // namespace traa
+
+#endif // TRAA_BASE_DEVICES_SCREEN_PARALLEL_SCALE_H_
@@ -0,0 +1,75 @@
+#include "base/devices/screen/parallel_scale.h"
+
+#include <libyuv/scale_argb.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace traa {
+namespace base {
+
+inline namespace {
+
+std::vector<uint8_t> random_image(int width, int height) {
+  std::vector<uint8_t> image(width * height * 4);
+  for (uint8_t &byte : image) {
+    byte = static_cast<uint8_t>(rand());
+  }
+  return image;
+}
+
+// Verifies parallel_scale_argb() produces the same pixels as ARGBScale.
+void test_bit_exact(int src_width, int src_height, int dst_width, int dst_height,
+                    libyuv::FilterMode filtering) {
+  const std::vector<uint8_t> src = random_image(src_width, src_height);
+  std::vector<uint8_t> expected(dst_width * dst_height * 4);
+  std::vector<uint8_t> actual(dst_width * dst_height * 4);
+  ASSERT_EQ(libyuv::ARGBScale(src.data(), src_width * 4, src_width, src_height, expected.data(),
+                              dst_width * 4, dst_width, dst_height, filtering),
+            0);
+  ASSERT_EQ(parallel_scale_argb(src.data(), src_width * 4, src_width, src_height, actual.data(),
+                                dst_width * 4, dst_width, dst_height, filtering),
+            0);
+  EXPECT_EQ(memcmp(expected.data(), actual.data(), expected.size()), 0)
+      << src_width << "x" << src_height << " to " << dst_width << "x" << dst_height
+      << ", filter " << filtering;
+}
+
+} // namespace
+
+TEST(parallel_scale_test, bit_exact_with_serial_scale) {
+  for (libyuv::FilterMode filtering :
+       {libyuv::kFilterNone, libyuv::kFilterBilinear, libyuv::kFilterBox}) {
+    test_bit_exact(3840, 2160, 1920, 1080, filtering);
+    test_bit_exact(2560, 1440, 1000, 563, filtering);
+    test_bit_exact(640, 480, 1280, 960, filtering);
+    test_bit_exact(1366, 768, 683, 384, filtering);
+  }
+}
+
+TEST(parallel_scale_test, small_images) {
+  test_bit_exact(64, 48, 16, 12, libyuv::kFilterBox);
+  test_bit_exact(4000, 3000, 400, 20, libyuv::kFilterBox);
+}
+
+TEST(parallel_scale_test, concurrent_callers) {
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([]() {
+      for (int j = 0; j < 5; j++) {
+        test_bit_exact(1920, 1080, 960, 540, libyuv::kFilterBox);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+} // namespace base
+} // namespace traa
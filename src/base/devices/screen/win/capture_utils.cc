@@ -3,6 +3,7 @@
 #include "base/devices/screen/desktop_frame.h"
 #include "base/devices/screen/desktop_geometry.h"
 #include "base/devices/screen/enumerator.h"
+#include "base/devices/screen/parallel_scale.h"
 #include "base/devices/screen/utils.h"
 #include "base/devices/screen/win/scoped_gdi_object.h"
 #include "base/logger.h"
@@ -364,11 +365,11 @@ bool get_window_image_by_gdi(HWND window, const traa_size &target_size, uint8_t
                    window_size.width() * window_size.height() * desktop_frame::k_bytes_per_pixel);
         } else {
           // use libyuv to scale the image
-          libyuv::ARGBScale(bitmap_data, window_size.width() * desktop_frame::k_bytes_per_pixel,
-                            window_size.width(), window_size.height(), *data,
-                            scaled_desktop_size.width() * desktop_frame::k_bytes_per_pixel,
-                            scaled_desktop_size.width(), scaled_desktop_size.height(),
-                            libyuv::kFilterBox);
+          parallel_scale_argb(bitmap_data, window_size.width() * desktop_frame::k_bytes_per_pixel,
+                              window_size.width(), window_size.height(), *data,
+                              scaled_desktop_size.width() * desktop_frame::k_bytes_per_pixel,
+                              scaled_desktop_size.width(), scaled_desktop_size.height(),
+                              libyuv::kFilterBox);
         }
       }
     }